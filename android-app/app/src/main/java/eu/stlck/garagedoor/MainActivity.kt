@@ -7,13 +7,20 @@
 
 package eu.stlck.garagedoor
 
+import android.Manifest
 import android.bluetooth.*
 import android.bluetooth.le.*
 import android.content.Context
 import android.content.Intent
+import android.content.pm.PackageManager
 import android.os.Bundle
+import android.os.Handler
+import android.os.Looper
+import android.os.SystemClock
 import com.google.android.material.snackbar.Snackbar
 import androidx.appcompat.app.AppCompatActivity
+import androidx.core.app.ActivityCompat
+import androidx.core.content.ContextCompat
 import android.util.Log
 
 import kotlinx.android.synthetic.main.activity_main.*
@@ -28,6 +35,14 @@ import org.apache.commons.codec.binary.Base64
 
 const val TAG = "GD_MAIN"
 
+// maximum advertising time per press
+const val ADV_TIMEOUT_MS = 3000
+
+// first octet of the HMAC input of acknowledgements sent by the receiver
+const val ACK_MARKER: Byte = 0xac.toByte()
+
+const val REQUEST_LOCATION_PERMISSION = 1
+
 class Identity(val uuid: UUID, val key: ByteArray)
 
 class MainActivity : AppCompatActivity() {
@@ -39,6 +54,8 @@ class MainActivity : AppCompatActivity() {
 
     private var id: Identity? = null
 
+    private val handler = Handler(Looper.getMainLooper())
+
     class MissingIdentityException : Exception()
 
     private fun loadIdentity(): Identity {
@@ -87,6 +104,52 @@ class MainActivity : AppCompatActivity() {
         sud.show(supportFragmentManager, "SetupDialogFragment")
     }
 
+    // expected acknowledgement service data: seq_no (3 octets) and the first four octets of
+    // HMAC-SHA256(key, ACK_MARKER || seq_no)
+    private fun ackData(key: ByteArray, counter: ByteArray): ByteArray {
+        val keyspec = SecretKeySpec(key, "HmacSHA256")
+        val mac = Mac.getInstance("HmacSHA256")
+        mac.init(keyspec)
+        val seqNo = counter.sliceArray(1..3)
+        val digest = mac.doFinal(byteArrayOf(ACK_MARKER) + seqNo)
+        return seqNo + digest.sliceArray(0..3)
+    }
+
+    // keep track of the average advertising time per press
+    private fun recordAdvTime(advTime: Long, acknowledged: Boolean) {
+        val sharedPref = getPreferences(Context.MODE_PRIVATE)
+        val presses = sharedPref.getLong("stat_presses", 0) + 1
+        val totalTime = sharedPref.getLong("stat_adv_time_ms", 0) + advTime
+        with(sharedPref.edit()) {
+            putLong("stat_presses", presses)
+            putLong("stat_adv_time_ms", totalTime)
+            commit()
+        }
+        Log.d(TAG, "advertised for %d ms (acknowledged: %b), average: %d ms per press".format(
+            advTime, acknowledged, totalTime / presses))
+    }
+
+    // BLE scan results (the acknowledgement) are only delivered with the location permission,
+    // which must be granted at runtime since Android 6
+    private fun hasLocationPermission(): Boolean {
+        return ContextCompat.checkSelfPermission(this, Manifest.permission.ACCESS_FINE_LOCATION) ==
+                PackageManager.PERMISSION_GRANTED
+    }
+
+    private fun requestLocationPermission() {
+        ActivityCompat.requestPermissions(this,
+            arrayOf(Manifest.permission.ACCESS_FINE_LOCATION), REQUEST_LOCATION_PERMISSION)
+    }
+
+    override fun onRequestPermissionsResult(requestCode: Int, permissions: Array<out String>,
+                                            grantResults: IntArray) {
+        super.onRequestPermissionsResult(requestCode, permissions, grantResults)
+        if (requestCode == REQUEST_LOCATION_PERMISSION &&
+            (grantResults.isEmpty() || grantResults[0] != PackageManager.PERMISSION_GRANTED)) {
+            Log.w(TAG, "location permission denied, acknowledgements cannot be received")
+        }
+    }
+
     private fun bleAdv(id: Identity) {
         if (!bluetoothAdapter!!.isEnabled) {
             val btenaEvent = Intent(BluetoothAdapter.ACTION_REQUEST_ENABLE)
@@ -113,7 +176,7 @@ class MainActivity : AppCompatActivity() {
         val advSettings = AdvertiseSettings.Builder()
             .setAdvertiseMode(AdvertiseSettings.ADVERTISE_MODE_LOW_LATENCY)
             .setTxPowerLevel(AdvertiseSettings.ADVERTISE_TX_POWER_HIGH)
-            .setTimeout(3000)
+            .setTimeout(ADV_TIMEOUT_MS)
             .setConnectable(false)
             .build()
         val advcb = object : AdvertiseCallback() {
@@ -138,6 +201,52 @@ class MainActivity : AppCompatActivity() {
                 message)
             .build()
         advertiser?.startAdvertising(advSettings, data, advcb)
+        val advStart = SystemClock.elapsedRealtime()
+
+        // scan for the acknowledgement of the receiver and stop advertising as soon as it is seen.
+        // Without the location permission, the scan yields no results, so the full advertising
+        // time is used.
+        val scanner = if (hasLocationPermission()) {
+            bluetoothAdapter?.bluetoothLeScanner
+        } else {
+            Log.w(TAG, "no location permission, not scanning for the acknowledgement")
+            requestLocationPermission()
+            null
+        }
+        val expectedAck = ackData(id.key, counter)
+        var finished = false
+        lateinit var scancb: ScanCallback
+        val finish = { acknowledged: Boolean ->
+            if (!finished) {
+                finished = true
+                if (acknowledged) {
+                    advertiser?.stopAdvertising(advcb)
+                }
+                scanner?.stopScan(scancb)
+                recordAdvTime(SystemClock.elapsedRealtime() - advStart, acknowledged)
+            }
+        }
+        scancb = object : ScanCallback() {
+            override fun onScanResult(callbackType: Int, result: ScanResult?) {
+                val ack = result?.scanRecord?.getServiceData(ParcelUuid(id.uuid))
+                if (ack != null && ack.contentEquals(expectedAck)) {
+                    Log.d(TAG, "acknowledgement received")
+                    finish(true)
+                }
+            }
+
+            override fun onScanFailed(errorCode: Int) {
+                Log.e(TAG, "could not start scanning: $errorCode")
+            }
+        }
+        val filter = ScanFilter.Builder()
+            .setServiceData(ParcelUuid(id.uuid), expectedAck)
+            .build()
+        val scanSettings = ScanSettings.Builder()
+            .setScanMode(ScanSettings.SCAN_MODE_LOW_LATENCY)
+            .build()
+        scanner?.startScan(listOf(filter), scanSettings, scancb)
+        handler.postDelayed({ finish(false) }, ADV_TIMEOUT_MS.toLong())
 
         // increment sequence number. The case where seq_no becomes > 0xffff_ffff is not handled
         with(sharedPref.edit()) {
@@ -157,6 +266,9 @@ class MainActivity : AppCompatActivity() {
         } catch (e: MissingIdentityException) {
             doSetupDialog()
         }
+        if (!hasLocationPermission()) {
+            requestLocationPermission()
+        }
 
         this.adv_button.setOnClickListener { view ->
 
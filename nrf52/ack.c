@@ -0,0 +1,164 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Acknowledgement beacon
+ */
+
+#include <ack.h>
+#include <systime.h>
+
+#include <app_error.h>
+#include <app_util.h>
+#include <app_util_platform.h>
+#include <ble.h>
+#include <nrf_sdh_ble.h>
+#include <nrf_log.h>
+#include <string.h>
+
+#define GD_ACK_BLE_OBSERVER_PRIO 3
+
+static uint8_t gd_ack_adv_handle = BLE_GAP_ADV_SET_HANDLE_NOT_SET;
+static uint8_t gd_ack_adv_buffer[2 + sizeof(gd_ad_ack_data_t)];
+static volatile bool gd_ack_running;
+static volatile bool gd_ack_beacon_running;
+static uint64_t gd_ack_start;
+static gd_ack_stats_t gd_ack_stats;
+
+static const ble_gap_adv_params_t gd_ack_adv_params = {
+    .properties = {.type = BLE_GAP_ADV_TYPE_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED},
+    .p_peer_addr = NULL,
+    .interval = MSEC_TO_UNITS(GD_ACK_INTERVAL_MS, UNIT_0_625_MS),
+    .duration = MSEC_TO_UNITS(GD_ACK_DURATION_MS, UNIT_10_MS),
+    .max_adv_evts = 0,
+    .filter_policy = BLE_GAP_ADV_FP_ANY,
+    .primary_phy = BLE_GAP_PHY_1MBPS};
+
+/* account for the advertising time of the acknowledgement just ended */
+static void gd_ack_ended(uint8_t adv_events) {
+    bool was_running;
+    uint32_t duration = 0;
+    CRITICAL_REGION_ENTER();
+    was_running = gd_ack_running;
+    if (was_running) {
+        gd_ack_running = false;
+        duration = GD_TIME_TICKS_TO_MS(gd_time_ticks() - gd_ack_start);
+        gd_ack_stats.adv_events += adv_events;
+        gd_ack_stats.adv_time_ms += duration;
+    }
+    CRITICAL_REGION_EXIT();
+    if (!was_running) {
+        return;
+    }
+    NRF_LOG_DEBUG("acknowledgement ended: %u ms, %u adv. events (avg. per ack: %u ms)",
+                  duration, adv_events,
+                  gd_ack_stats.adv_time_ms / gd_ack_stats.acks);
+}
+
+/* account for the advertising events of the beacon just ended */
+static void gd_ack_beacon_ended(uint8_t adv_events) {
+    CRITICAL_REGION_ENTER();
+    if (gd_ack_beacon_running) {
+        gd_ack_beacon_running = false;
+        gd_ack_stats.beacon_events += adv_events;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+static void gd_ack_ble_evt_handler(ble_evt_t const *p_ble_evt, void *p_context) {
+    if (p_ble_evt->header.evt_id == BLE_GAP_EVT_ADV_SET_TERMINATED) {
+        const ble_gap_evt_adv_set_terminated_t *t =
+            &p_ble_evt->evt.gap_evt.params.adv_set_terminated;
+        if (t->adv_handle == gd_ack_adv_handle) {
+            if (gd_ack_beacon_running) {
+                gd_ack_beacon_ended(t->num_completed_adv_events);
+            } else {
+                gd_ack_ended(t->num_completed_adv_events);
+            }
+        }
+    }
+}
+
+NRF_SDH_BLE_OBSERVER(gd_ack_ble_observer, GD_ACK_BLE_OBSERVER_PRIO, gd_ack_ble_evt_handler, NULL);
+
+void gd_ack_init(void) {
+    memset(&gd_ack_stats, 0, sizeof(gd_ack_stats));
+    gd_ack_running = false;
+    gd_ack_beacon_running = false;
+}
+
+void gd_ack_send(const ble_uuid128_t *uuid,
+                 const uint8_t key[GD_TX_KEY_SIZE],
+                 const gd_message_t *msg) {
+    gd_ad_ack_data_t *ack = (gd_ad_ack_data_t *)&gd_ack_adv_buffer[2];
+    if (gd_ack_running &&
+        memcmp(&ack->uuid, uuid, sizeof(ble_uuid128_t)) == 0 &&
+        memcmp(ack->seq_no, msg->seq_no, sizeof(ack->seq_no)) == 0) {
+        return; /* already acknowledging this message */
+    }
+    if (gd_ack_adv_handle != BLE_GAP_ADV_SET_HANDLE_NOT_SET) {
+        /* the buffer may be reused only while not advertising */
+        uint32_t err_code = sd_ble_gap_adv_stop(gd_ack_adv_handle);
+        if (err_code != NRF_ERROR_INVALID_STATE) {
+            APP_ERROR_CHECK(err_code);
+        }
+        gd_ack_ended(0);
+        gd_ack_beacon_ended(0);
+    }
+
+    gd_ack_adv_buffer[0] = 1 + sizeof(gd_ad_ack_data_t);
+    gd_ack_adv_buffer[1] = AD_TYPE_SERVICE_DATA128;
+    ack->uuid = *uuid;
+    memcpy(ack->seq_no, msg->seq_no, sizeof(ack->seq_no));
+    gd_ack_calc_digest(key, ack->seq_no, ack->digest);
+
+    ble_gap_adv_data_t adv_data = {
+        .adv_data = {
+            .p_data = gd_ack_adv_buffer,
+            .len = sizeof(gd_ack_adv_buffer)},
+        .scan_rsp_data = {
+            .p_data = NULL,
+            .len = 0}};
+    APP_ERROR_CHECK(sd_ble_gap_adv_set_configure(&gd_ack_adv_handle,
+                                                 &adv_data,
+                                                 &gd_ack_adv_params));
+    gd_ack_start = gd_time_ticks();
+    gd_ack_running = true;
+    gd_ack_stats.acks++;
+    APP_ERROR_CHECK(sd_ble_gap_adv_start(gd_ack_adv_handle, BLE_CONN_CFG_TAG_DEFAULT));
+}
+
+bool gd_ack_beacon(const uint8_t *data, uint8_t len, uint32_t interval_ms, uint8_t adv_events) {
+    if (gd_ack_running || gd_ack_beacon_running) {
+        return false;
+    }
+    const ble_gap_adv_params_t params = {
+        .properties = {.type = BLE_GAP_ADV_TYPE_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED},
+        .p_peer_addr = NULL,
+        .interval = MSEC_TO_UNITS(interval_ms, UNIT_0_625_MS),
+        .duration = 0,
+        .max_adv_evts = adv_events,
+        .filter_policy = BLE_GAP_ADV_FP_ANY,
+        .primary_phy = BLE_GAP_PHY_1MBPS};
+    ble_gap_adv_data_t adv_data = {
+        .adv_data = {
+            .p_data = (uint8_t *)data,
+            .len = len},
+        .scan_rsp_data = {
+            .p_data = NULL,
+            .len = 0}};
+    APP_ERROR_CHECK(sd_ble_gap_adv_set_configure(&gd_ack_adv_handle, &adv_data, &params));
+    gd_ack_beacon_running = true;
+    gd_ack_stats.beacons++;
+    APP_ERROR_CHECK(sd_ble_gap_adv_start(gd_ack_adv_handle, BLE_CONN_CFG_TAG_DEFAULT));
+    return true;
+}
+
+void gd_ack_get_stats(gd_ack_stats_t *stats) {
+    CRITICAL_REGION_ENTER();
+    *stats = gd_ack_stats;
+    CRITICAL_REGION_EXIT();
+}
@@ -13,6 +13,9 @@
  * P0.19    Relay (pin 29)
  * P0.20    Button (pin 30)
  *
+ * P0.11    Relay 2 (output channel 1, extension board)
+ * P0.12    Relay 3 (output channel 2, extension board)
+ *
  * P0.22    on module RGB LED red (unused)
  * P0.23    on module RGB LED blue (unused)
  * P0.24    on module RGB LED green (unused)
@@ -22,8 +25,18 @@
 #ifndef __GD_CONFIG_H__
 #define __GD_CONFIG_H__
 
+#include <nrf_gpio.h> /* NRF_GPIO_PIN_MAP */
+
 #define GD_PINNO_LED    NRF_GPIO_PIN_MAP(0, 16)
 #define GD_PINNO_RELAY  NRF_GPIO_PIN_MAP(0, 19)
 #define GD_PINNO_BUTTON NRF_GPIO_PIN_MAP(0, 20)
 
+/* relay output channels; channel 0 is GD_PINNO_RELAY */
+#define GD_RELAY_CHANNELS 3
+#define GD_PINNO_RELAYS {GD_PINNO_RELAY,            \
+                         NRF_GPIO_PIN_MAP(0, 11),   \
+                         NRF_GPIO_PIN_MAP(0, 12)}
+/* optional pulse width (us) and minimum gap (ms) per channel, e.g.
+ * #define GD_RELAY_TIMING {{1000000, 1000}, {500000, 1000}, {500000, 1000}} */
+
 #endif
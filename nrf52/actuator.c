@@ -0,0 +1,271 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Actuation queues between command reception and the relay outputs
+ */
+
+#include <actuator.h>
+#include <hal.h>
+#include <metrics.h>
+#include <ramfunc.h>
+#include <relay.h>
+#include <systime.h>
+#include <trace.h>
+
+#include <app_util.h>
+#include <nrf_log.h>
+#include <string.h>
+
+typedef struct {
+    uint8_t cmd;
+    uint32_t outputs; /* bit n: output channel n */
+    bool coalesce;    /* merge presses within GD_ACT_COALESCE_MS */
+} gd_act_cmd_t;
+
+GD_RAMDATA static const gd_act_cmd_t gd_act_cmd_table[] = {
+    {.cmd = GD_CMD_TRIGGER, .outputs = 1 << 0, .coalesce = true},
+#if GD_RELAY_CHANNELS > 1
+    {.cmd = GD_CMD_TRIGGER_1, .outputs = 1 << 1, .coalesce = true},
+#endif
+#if GD_RELAY_CHANNELS > 2
+    {.cmd = GD_CMD_TRIGGER_2, .outputs = 1 << 2, .coalesce = true},
+#endif
+};
+
+/* pulse timing of the output channels, GD_ACT_PULSE_US and
+ * GD_ACT_MIN_GAP_MS for all of them unless GD_RELAY_TIMING is defined */
+#ifdef GD_RELAY_TIMING
+typedef struct {
+    uint32_t pulse_us;
+    uint32_t min_gap_ms;
+} gd_act_timing_t;
+
+GD_RAMDATA static const gd_act_timing_t gd_act_timing[GD_RELAY_CHANNELS] = GD_RELAY_TIMING;
+
+#define GD_ACT_CH_PULSE_US(ch)   (gd_act_timing[ch].pulse_us)
+#define GD_ACT_CH_MIN_GAP_MS(ch) (gd_act_timing[ch].min_gap_ms)
+#else
+#define GD_ACT_CH_PULSE_US(ch)   GD_ACT_PULSE_US
+#define GD_ACT_CH_MIN_GAP_MS(ch) GD_ACT_MIN_GAP_MS
+#endif
+
+typedef struct {
+    const gd_act_cmd_t *cmd;
+    uint32_t queued_ms;
+    uint32_t t_rx; /* trace origin */
+} gd_act_item_t;
+
+typedef enum {
+    GD_ACT_IDLE,
+    GD_ACT_PULSE, /* relay pulse generated by the driver */
+    GD_ACT_GAP,   /* relay off, waiting for the minimum gap or a retry */
+} gd_act_state_t;
+
+typedef struct {
+    gd_act_state_t state;
+    gd_act_item_t queue[GD_ACT_QUEUE_SIZE];
+    unsigned head;
+    unsigned count;
+} gd_act_output_t;
+
+/* one timer per output */
+static gd_hal_timer_t gd_act_timer[GD_RELAY_CHANNELS];
+
+static const gd_relay_driver_t *gd_act_relay;
+static void (*gd_act_state_handler)(bool active);
+static gd_act_output_t gd_act_output[GD_RELAY_CHANNELS];
+static unsigned gd_act_pulsing; /* number of outputs in GD_ACT_PULSE */
+static uint32_t gd_act_active_start; /* counter at the first pulse start */
+static uint32_t gd_act_last_accept_ms[ARRAY_SIZE(gd_act_cmd_table)];
+static bool gd_act_accepted[ARRAY_SIZE(gd_act_cmd_table)];
+static gd_act_stats_t gd_act_stats;
+
+/* unknown commands trigger output 0 like any command did before there was
+ * a command table */
+GD_RAMFUNC static const gd_act_cmd_t *gd_act_lookup(uint8_t cmd) {
+    for (size_t i = 0; i < ARRAY_SIZE(gd_act_cmd_table); i++) {
+        if (gd_act_cmd_table[i].cmd == cmd) {
+            return &gd_act_cmd_table[i];
+        }
+    }
+    return &gd_act_cmd_table[0];
+}
+
+GD_RAMFUNC static bool gd_act_is_queued(const gd_act_cmd_t *cmd) {
+    for (unsigned ch = 0; ch < GD_RELAY_CHANNELS; ch++) {
+        gd_act_output_t *out = &gd_act_output[ch];
+        for (unsigned i = 0; i < out->count; i++) {
+            if (out->queue[(out->head + i) % GD_ACT_QUEUE_SIZE].cmd == cmd) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+GD_RAMFUNC static void gd_act_start_timer(unsigned ch, uint32_t ms) {
+    gd_hal_timer_start(gd_act_timer[ch], ms, (void *)(uintptr_t)ch);
+}
+
+/* start the next pulse of an output if idle; must be called within a
+ * critical region. If the relay is busy, the item stays queued and the start
+ * is retried after GD_ACT_BUSY_RETRY_MS. Returns false in that case (to be
+ * logged by the caller after leaving the critical region). */
+GD_RAMFUNC static bool gd_act_process(unsigned ch) {
+    gd_act_output_t *out = &gd_act_output[ch];
+    if (out->state != GD_ACT_IDLE || out->count == 0) {
+        return true;
+    }
+    if (!gd_act_relay->pulse(ch, GD_ACT_CH_PULSE_US(ch))) {
+        gd_act_stats.busy++;
+        out->state = GD_ACT_GAP;
+        gd_act_start_timer(ch, GD_ACT_BUSY_RETRY_MS);
+        return false;
+    }
+    gd_act_item_t *item = &out->queue[out->head];
+    out->head = (out->head + 1) % GD_ACT_QUEUE_SIZE;
+    out->count--;
+
+    uint32_t delay = gd_time_ms() - item->queued_ms;
+    gd_metric_observe(GD_METRIC_ACT_DELAY_MS, delay);
+    if (delay > gd_act_stats.max_delay_ms) {
+        gd_act_stats.max_delay_ms = delay;
+    }
+    gd_act_stats.executed++;
+    gd_metric_inc(GD_METRIC_ACTUATIONS);
+    gd_act_stats.pulse_us += GD_ACT_CH_PULSE_US(ch);
+    gd_trace_mark(GD_TRACE_ACTUATE, item->t_rx);
+    out->state = GD_ACT_PULSE;
+    if (gd_act_pulsing++ == 0) {
+        gd_act_active_start = gd_hal_counter();
+        gd_act_state_handler(true);
+    }
+    /* the driver ends the pulse; the timer only tracks the state */
+    gd_act_start_timer(ch, CEIL_DIV(GD_ACT_CH_PULSE_US(ch), 1000));
+    return true;
+}
+
+GD_RAMFUNC static void gd_act_timer_handler(void *context) {
+    unsigned ch = (unsigned)(uintptr_t)context;
+    gd_act_output_t *out = &gd_act_output[ch];
+    bool started = true;
+    GD_HAL_CRITICAL_ENTER();
+    switch (out->state) {
+        case GD_ACT_PULSE:
+            out->state = GD_ACT_GAP;
+            if (--gd_act_pulsing == 0) {
+                uint32_t ticks = (gd_hal_counter() - gd_act_active_start) & GD_HAL_COUNTER_MASK;
+                gd_act_stats.active_us += GD_TIME_TICKS_TO_US(ticks);
+                gd_act_state_handler(false);
+            }
+            gd_act_start_timer(ch, GD_ACT_CH_MIN_GAP_MS(ch));
+            break;
+        case GD_ACT_GAP:
+            out->state = GD_ACT_IDLE;
+            started = gd_act_process(ch);
+            break;
+        default:
+            break;
+    }
+    GD_HAL_CRITICAL_EXIT();
+    if (!started) {
+        NRF_LOG_WARNING("relay %u busy, retrying", ch);
+    }
+}
+
+void gd_act_init(const gd_relay_driver_t *relay, void (*state_handler)(bool active)) {
+    gd_act_relay = relay;
+    gd_act_state_handler = state_handler;
+    memset(gd_act_output, 0, sizeof(gd_act_output));
+    gd_act_pulsing = 0;
+    memset(gd_act_accepted, 0, sizeof(gd_act_accepted));
+    memset(&gd_act_stats, 0, sizeof(gd_act_stats));
+    for (unsigned ch = 0; ch < GD_RELAY_CHANNELS; ch++) {
+        gd_hal_timer_create(&gd_act_timer[ch], false, gd_act_timer_handler);
+    }
+}
+
+uint32_t gd_act_get_outputs(uint8_t cmd) {
+    const gd_act_cmd_t *c = gd_act_lookup(cmd);
+    return c != NULL ? c->outputs : 0;
+}
+
+GD_RAMFUNC void gd_act_submit(uint8_t cmd, uint32_t t_rx) {
+    const gd_act_cmd_t *c = gd_act_lookup(cmd);
+    size_t ndx = c - gd_act_cmd_table;
+    uint32_t now = gd_time_ms();
+    bool coalesced = false;
+    uint32_t full = 0; /* outputs with a full queue */
+    uint32_t busy = 0; /* outputs with a busy relay */
+
+    GD_HAL_CRITICAL_ENTER();
+    if (c->cmd != cmd) {
+        gd_act_stats.unknown++;
+    }
+    if (c->coalesce &&
+        (gd_act_is_queued(c) ||
+         (gd_act_accepted[ndx] &&
+          now - gd_act_last_accept_ms[ndx] < GD_ACT_COALESCE_MS))) {
+        coalesced = true;
+        gd_act_stats.coalesced++;
+    } else {
+        gd_act_accepted[ndx] = true;
+        gd_act_last_accept_ms[ndx] = now;
+        for (unsigned ch = 0; ch < GD_RELAY_CHANNELS; ch++) {
+            gd_act_output_t *out = &gd_act_output[ch];
+            if ((c->outputs & (1UL << ch)) == 0) {
+                continue;
+            }
+            if (out->count >= GD_ACT_QUEUE_SIZE) {
+                full |= 1UL << ch;
+                gd_act_stats.dropped++;
+                continue;
+            }
+            gd_act_item_t *item = &out->queue[(out->head + out->count) % GD_ACT_QUEUE_SIZE];
+            item->cmd = c;
+            item->queued_ms = now;
+            item->t_rx = t_rx;
+            out->count++;
+            gd_act_stats.queued++;
+            if (!gd_act_process(ch)) {
+                busy |= 1UL << ch;
+            }
+        }
+    }
+    GD_HAL_CRITICAL_EXIT();
+
+    if (c->cmd != cmd) {
+        NRF_LOG_INFO("unknown command %02x, executed as %02x", cmd, c->cmd);
+    }
+    if (coalesced) {
+        NRF_LOG_DEBUG("command %02x coalesced", cmd);
+    }
+    for (unsigned ch = 0; ch < GD_RELAY_CHANNELS; ch++) {
+        if (full & (1UL << ch)) {
+            NRF_LOG_WARNING("actuation queue %u full", ch);
+        }
+        if (busy & (1UL << ch)) {
+            NRF_LOG_WARNING("relay %u busy, retrying", ch);
+        }
+    }
+}
+
+bool gd_act_is_active(void) {
+    bool r = false;
+    GD_HAL_CRITICAL_ENTER();
+    for (unsigned ch = 0; ch < GD_RELAY_CHANNELS; ch++) {
+        r = r || gd_act_output[ch].state == GD_ACT_PULSE || gd_act_relay->is_on(ch);
+    }
+    GD_HAL_CRITICAL_EXIT();
+    return r;
+}
+
+void gd_act_get_stats(gd_act_stats_t *stats) {
+    GD_HAL_CRITICAL_ENTER();
+    *stats = gd_act_stats;
+    GD_HAL_CRITICAL_EXIT();
+}
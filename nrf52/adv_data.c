@@ -0,0 +1,39 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Advertising Data (AD) parsing
+ */
+
+#include <adv_data.h>
+#include <ramfunc.h>
+
+#include <app_util.h>
+
+STATIC_ASSERT(sizeof(gd_message_t) == 8);
+STATIC_ASSERT(sizeof(gd_ad_service_data_t) == 24);
+STATIC_ASSERT(sizeof(gd_ad_ack_data_t) != sizeof(gd_ad_service_data_t));
+
+GD_RAMFUNC bool gd_ad_iter_next(gd_ad_iter_t *it, gd_ad_struct_t *ads) {
+    if (it->ndx >= it->len) {
+        return false;
+    }
+    size_t l = it->data[it->ndx];
+    if (l == 0) { /* early termination of the significant part */
+        it->ndx = it->len;
+        return false;
+    }
+    if (it->ndx + 1 + l > it->len) { /* length l too large */
+        it->malformed = true;
+        it->ndx = it->len;
+        return false;
+    }
+    ads->type = it->data[it->ndx + 1];
+    ads->len = l - 1;
+    ads->payload = &it->data[it->ndx + 2];
+    it->ndx += 1 + l;
+    return true;
+}
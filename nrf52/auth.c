@@ -0,0 +1,79 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Message authentication
+ */
+
+#include <auth.h>
+#include <prof.h>
+#include <rxm_key.h>
+
+#include <mbedtls/md.h>
+#include <app_error.h>
+#include <string.h>
+
+void gd_calculate_tx_key(const ble_uuid128_t *tx_uuid, uint8_t key[GD_TX_KEY_SIZE]) {
+    GD_PROF_SCOPE(GD_PROF_TX_KEY);
+    /* convert UUID into big endian representation */
+    uint8_t uuid_be[16];
+    for (int i = 0; i < 16; i++) {
+        uuid_be[15 - i] = tx_uuid->uuid128[i];
+    }
+    APP_ERROR_CHECK_BOOL(0 == mbedtls_md_hmac(
+                                  mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                                  gd_rxm_key, GD_RXM_KEY_SIZE,
+                                  uuid_be, 16,
+                                  key));
+}
+
+bool gd_msg_check_digest(const uint8_t key[GD_TX_KEY_SIZE], const gd_message_t *msg) {
+    GD_PROF_SCOPE(GD_PROF_DIGEST);
+    uint8_t digest[32];
+
+    APP_ERROR_CHECK_BOOL(0 == mbedtls_md_hmac(
+                                  mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                                  key, GD_TX_KEY_SIZE,
+                                  (uint8_t *)msg, 4,
+                                  digest));
+    return memcmp(digest, msg->digest, 4) == 0;
+}
+
+void gd_ack_calc_digest(const uint8_t key[GD_TX_KEY_SIZE],
+                        const uint8_t seq_no[3],
+                        uint8_t digest[4]) {
+    uint8_t input[4] = {GD_ACK_MARKER, seq_no[0], seq_no[1], seq_no[2]};
+    uint8_t hmac[32];
+
+    APP_ERROR_CHECK_BOOL(0 == mbedtls_md_hmac(
+                                  mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                                  key, GD_TX_KEY_SIZE,
+                                  input, sizeof(input),
+                                  hmac));
+    memcpy(digest, hmac, 4);
+}
+
+void gd_calculate_health_key(uint8_t key[GD_TX_KEY_SIZE]) {
+    APP_ERROR_CHECK_BOOL(0 == mbedtls_md_hmac(
+                                  mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                                  gd_rxm_key, GD_RXM_KEY_SIZE,
+                                  (const uint8_t *)GD_HEALTH_KEY_LABEL,
+                                  sizeof(GD_HEALTH_KEY_LABEL) - 1,
+                                  key));
+}
+
+void gd_health_calc_digest(const uint8_t key[GD_TX_KEY_SIZE],
+                           const uint8_t *data, size_t len,
+                           uint8_t digest[4]) {
+    uint8_t hmac[32];
+
+    APP_ERROR_CHECK_BOOL(0 == mbedtls_md_hmac(
+                                  mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                                  key, GD_TX_KEY_SIZE,
+                                  data, len,
+                                  hmac));
+    memcpy(digest, hmac, 4);
+}
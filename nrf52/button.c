@@ -0,0 +1,120 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Interrupt driven button handling
+ *
+ * Both edges of the button signal are detected by the HAL input (low power
+ * sense on the nRF52), so nothing runs while the button is idle. After
+ * an edge, the signal is sampled again when the debounce time has elapsed.
+ * A single shot timer detects long presses.
+ */
+
+#include <button.h>
+#include <gd_config.h>
+#include <hal.h>
+#include <scheduler.h>
+#include <systime.h>
+
+typedef enum {
+    GD_BUTTON_RELEASED,
+    GD_BUTTON_DEBOUNCE_PRESS,
+    GD_BUTTON_PRESSED,
+    GD_BUTTON_DEBOUNCE_RELEASE,
+} gd_button_state_t;
+
+static gd_hal_timer_t gd_button_debounce_timer;
+static gd_hal_timer_t gd_button_long_timer;
+static gd_button_state_t gd_button_state = GD_BUTTON_RELEASED;
+static bool gd_button_long = false; /* long press detected */
+static uint32_t gd_button_press_ms;
+static gd_button_cmd_t gd_button_cmd = GD_BUTCMD_NONE;
+
+static void gd_button_set_cmd(gd_button_cmd_t cmd) {
+    if (gd_button_cmd == GD_BUTCMD_NONE) {
+        gd_button_cmd = cmd;
+        gd_sched_post(GD_EVT_BUTTON);
+    }
+}
+
+static void gd_button_edge_handler(uint32_t pin) {
+    switch (gd_button_state) {
+        case GD_BUTTON_RELEASED:
+            gd_button_state = GD_BUTTON_DEBOUNCE_PRESS;
+            break;
+        case GD_BUTTON_PRESSED:
+            gd_button_state = GD_BUTTON_DEBOUNCE_RELEASE;
+            break;
+        default: /* bouncing, restart debounce time */
+            gd_hal_timer_stop(gd_button_debounce_timer);
+            break;
+    }
+    gd_hal_timer_start(gd_button_debounce_timer, GD_BUTTON_DEBOUNCE_MS, NULL);
+}
+
+static void gd_button_debounce_handler(void *dummy) {
+    bool pressed = gd_hal_gpio_read(GD_PINNO_BUTTON);
+    switch (gd_button_state) {
+        case GD_BUTTON_DEBOUNCE_PRESS:
+            if (pressed) {
+                gd_button_state = GD_BUTTON_PRESSED;
+                gd_button_long = false;
+                gd_button_press_ms = gd_time_ms() - GD_BUTTON_DEBOUNCE_MS;
+                gd_hal_timer_start(gd_button_long_timer,
+                                   GD_BUTTON_LONG_MS - GD_BUTTON_DEBOUNCE_MS, NULL);
+            } else {
+                gd_button_state = GD_BUTTON_RELEASED;
+            }
+            break;
+        case GD_BUTTON_DEBOUNCE_RELEASE:
+            if (pressed) {
+                gd_button_state = GD_BUTTON_PRESSED;
+                break;
+            }
+            gd_button_state = GD_BUTTON_RELEASED;
+            gd_hal_timer_stop(gd_button_long_timer);
+            if (gd_button_cmd == GD_BUTCMD_CONSUMED) {
+                gd_button_cmd = GD_BUTCMD_NONE;
+            } else if (!gd_button_long &&
+                       gd_time_ms() - GD_BUTTON_DEBOUNCE_MS - gd_button_press_ms >= GD_BUTTON_SHORT_MS) {
+                gd_button_set_cmd(GD_BUTCMD_LEARN);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void gd_button_long_handler(void *dummy) {
+    gd_button_long = true;
+    gd_button_set_cmd(GD_BUTCMD_CLEAR);
+}
+
+void gd_button_init(void) {
+    gd_hal_timer_create(&gd_button_debounce_timer, false, gd_button_debounce_handler);
+    gd_hal_timer_create(&gd_button_long_timer, false, gd_button_long_handler);
+    gd_hal_gpio_input(GD_PINNO_BUTTON, GD_HAL_PULL_DOWN, gd_button_edge_handler);
+}
+
+gd_button_cmd_t gd_get_button(void) {
+    gd_button_cmd_t r;
+    GD_HAL_CRITICAL_ENTER();
+    r = gd_button_cmd;
+    switch (r) {
+        case GD_BUTCMD_NONE:
+            break;
+        case GD_BUTCMD_CONSUMED:
+            r = GD_BUTCMD_NONE;
+            break;
+        default:
+            /* wait for release unless the button has been released already */
+            gd_button_cmd = gd_button_state == GD_BUTTON_RELEASED ?
+                                GD_BUTCMD_NONE : GD_BUTCMD_CONSUMED;
+            break;
+    }
+    GD_HAL_CRITICAL_EXIT();
+    return r;
+}
@@ -0,0 +1,94 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Activity accounting for the energy model
+ */
+
+#include <energy.h>
+#include <ack.h>
+#include <actuator.h>
+#include <flash.h>
+#include <hal.h>
+#include <scheduler.h>
+#include <systime.h>
+
+#include <nrf_log.h>
+#include <string.h>
+
+static uint64_t gd_energy_start;
+static uint16_t gd_energy_scan_interval;
+static uint16_t gd_energy_scan_window;
+
+static bool gd_energy_scanning;
+static uint64_t gd_energy_scan_start;
+static uint64_t gd_energy_scan_ticks;
+
+void gd_energy_init(void) {
+    gd_energy_start = gd_time_ticks();
+    gd_energy_scanning = false;
+    gd_energy_scan_ticks = 0;
+}
+
+void gd_energy_scan_config(uint16_t interval, uint16_t window) {
+    gd_energy_scan_interval = interval;
+    gd_energy_scan_window = window;
+}
+
+void gd_energy_scan(bool on) {
+    uint64_t now = gd_time_ticks();
+    GD_HAL_CRITICAL_ENTER();
+    if (on && !gd_energy_scanning) {
+        gd_energy_scan_start = now;
+    } else if (!on && gd_energy_scanning) {
+        gd_energy_scan_ticks += now - gd_energy_scan_start;
+    }
+    gd_energy_scanning = on;
+    GD_HAL_CRITICAL_EXIT();
+}
+
+void gd_energy_get(gd_energy_t *energy) {
+    uint64_t now = gd_time_ticks();
+    uint64_t scan_ticks;
+    gd_ack_stats_t ack;
+    gds_flash_stats_t flash;
+    gd_act_stats_t act;
+
+    GD_HAL_CRITICAL_ENTER();
+    scan_ticks = gd_energy_scan_ticks;
+    if (gd_energy_scanning) {
+        scan_ticks += now - gd_energy_scan_start;
+    }
+    GD_HAL_CRITICAL_EXIT();
+    gd_ack_get_stats(&ack);
+    gds_flash_get_stats(&flash);
+    gd_act_get_stats(&act);
+
+    memset(energy, 0, sizeof(*energy));
+    energy->uptime_us = GD_TIME_TICKS_TO_US(now - gd_energy_start);
+    energy->sleep_us = GD_TIME_TICKS_TO_US(gd_sched_get_sleep_ticks());
+    energy->scan_us = GD_TIME_TICKS_TO_US(scan_ticks);
+    energy->scan_interval_us = gd_energy_scan_interval * 625UL;
+    energy->scan_window_us = gd_energy_scan_window * 625UL;
+    energy->flash_words = flash.words_written;
+    energy->flash_erase_us = flash.erase_us;
+    energy->relay_us = act.pulse_us;
+    energy->hfxo_us = act.active_us;
+    energy->adv_events = ack.adv_events + ack.beacon_events;
+}
+
+void gd_energy_log(void) {
+    gd_energy_t e;
+    gd_energy_get(&e);
+    /* milliseconds do not overflow for 49 days; the model uses the
+     * differences of consecutive snapshots */
+    NRF_LOG_INFO("energy: uptime_ms=%u sleep_ms=%u scan_ms=%u scan_window_us=%u scan_interval_us=%u",
+                 (uint32_t)(e.uptime_us / 1000), (uint32_t)(e.sleep_us / 1000),
+                 (uint32_t)(e.scan_us / 1000), e.scan_window_us, e.scan_interval_us);
+    NRF_LOG_INFO("energy: flash_words=%u erase_us=%u relay_ms=%u hfxo_ms=%u adv_events=%u",
+                 e.flash_words, (uint32_t)e.flash_erase_us,
+                 (uint32_t)(e.relay_us / 1000), (uint32_t)(e.hfxo_us / 1000), e.adv_events);
+}
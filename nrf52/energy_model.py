@@ -0,0 +1,226 @@
+#!/usr/bin/python3
+#
+# BLE garage door opener remote control
+#
+# Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+#
+# Energy model (see include/energy.h)
+#
+#   energy_model.py log [capture]
+#       estimate the average current and the battery life from the energy
+#       snapshots of a log (the last two snapshots, or the last one if there
+#       is only one)
+#
+#   energy_model.py simulate
+#       simulate a receiver with the scan parameters of hal_nrf52.c
+#       and compare the model with the exactly integrated charge
+#
+
+import argparse
+import json
+import os
+import random
+import re
+import sys
+
+# typical nRF52832 currents at 3 V with the DC/DC converter (datasheet
+# values) and board specific values; override with --params
+PARAMS = {
+    'sleep_ua': 3.0,             # System ON, RTC running, RAM retained
+    'cpu_ma': 3.7,               # CPU running from flash at 64 MHz
+    'rx_ma': 5.4,                # radio receiving (1 Mbit/s)
+    'tx_ma': 5.3,                # radio transmitting (0 dBm)
+    'adv_event_us': 1500,        # radio time of an advertising event (3 channels)
+    'flash_write_ma': 3.7,
+    'flash_write_us_per_word': 41,
+    'flash_erase_ma': 3.7,
+    'relay_ma': 70.0,            # relay coil and driver (board specific)
+    'hfxo_ma': 0.25,             # HFXO requested by relay.c while a pulse runs
+    'battery_mah': 2400.0,
+    'battery_derating': 0.8,     # usable fraction of the nominal capacity
+}
+
+KEYS = ('uptime_ms', 'sleep_ms', 'scan_ms', 'scan_window_us', 'scan_interval_us',
+        'flash_words', 'erase_us', 'relay_ms', 'hfxo_ms', 'adv_events')
+# counters that are sent as (wrapping) 32 bit values
+WRAP = 1 << 32
+
+
+def parse_snapshots(lines):
+    """energy snapshots (dicts with KEYS) of a log"""
+    snapshots = []
+    current = {}
+    for line in lines:
+        if 'energy:' not in line:
+            continue
+        values = dict((k, int(v)) for k, v in re.findall(r'(\w+)=(\d+)', line))
+        if 'uptime_ms' in values:
+            current = values
+        else:
+            current.update(values)
+            if all(k in current for k in KEYS):
+                snapshots.append(current)
+            current = {}
+    return snapshots
+
+
+def delta(new, old):
+    """counter differences between two snapshots"""
+    d = dict((k, (new[k] - old.get(k, 0)) % WRAP) for k in KEYS)
+    d['scan_window_us'] = new['scan_window_us']
+    d['scan_interval_us'] = new['scan_interval_us']
+    return d
+
+
+def state_times(d, p):
+    """time in seconds per state"""
+    duty = d['scan_window_us'] / d['scan_interval_us'] if d['scan_interval_us'] else 0
+    return {
+        'sleep': d['sleep_ms'] / 1e3,
+        'cpu': (d['uptime_ms'] - d['sleep_ms']) / 1e3,
+        'rx': d['scan_ms'] / 1e3 * duty,
+        'tx': d['adv_events'] * p['adv_event_us'] / 1e6,
+        'flash_write': d['flash_words'] * p['flash_write_us_per_word'] / 1e6,
+        'flash_erase': d['erase_us'] / 1e6,
+        'relay': d['relay_ms'] / 1e3,
+        'hfxo': d['hfxo_ms'] / 1e3,
+    }
+
+
+def charges(times, p):
+    """charge in mAs per state; the CPU is either sleeping or active, the
+    other states add to that base current"""
+    return {
+        'sleep': times['sleep'] * p['sleep_ua'] / 1e3,
+        'cpu': times['cpu'] * p['cpu_ma'],
+        'rx': times['rx'] * p['rx_ma'],
+        'tx': times['tx'] * p['tx_ma'],
+        'flash_write': times['flash_write'] * p['flash_write_ma'],
+        'flash_erase': times['flash_erase'] * p['flash_erase_ma'],
+        'relay': times['relay'] * p['relay_ma'],
+        'hfxo': times['hfxo'] * p['hfxo_ma'],
+    }
+
+
+def report(d, p):
+    duration = d['uptime_ms'] / 1e3
+    if duration <= 0:
+        sys.exit('no time elapsed between the snapshots')
+    times = state_times(d, p)
+    q = charges(times, p)
+    avg_ma = sum(q.values()) / duration
+    print('interval: %.1f h' % (duration / 3600))
+    print('%-12s %12s %10s %10s' % ('state', 'time [s]', 'avg [uA]', 'share'))
+    for state in times:
+        print('%-12s %12.3f %10.2f %9.1f%%' % (
+            state, times[state], q[state] / duration * 1e3, 100 * q[state] / sum(q.values())))
+    print('average current: %.1f uA' % (avg_ma * 1e3))
+    hours = p['battery_mah'] * p['battery_derating'] / avg_ma
+    print('battery life (%.0f mAh, %.0f %% usable): %.0f days' % (
+        p['battery_mah'], 100 * p['battery_derating'], hours / 24))
+    return avg_ma
+
+
+def scan_params(hal_c):
+    """scan interval and window (us) as configured for gd_hal_scan_start()"""
+    with open(hal_c) as f:
+        text = f.read()
+    block = re.search(r'ble_gap_scan_params_t\s+scan_params\s*=\s*\{(.*?)\};', text, re.S).group(1)
+    values = {}
+    for name in ('interval', 'window'):
+        ms = re.search(r'\.%s\s*=\s*MSEC_TO_UNITS\((\d+),\s*UNIT_0_625_MS\)' % name, block)
+        values[name] = int(ms.group(1)) * 1000 // 625 * 625
+    return values['interval'], values['window']
+
+
+def simulate(args, p):
+    """Simulate the scanner with flash gaps after presses and compare the
+    receive time derived from the counters (scanner enabled time * duty)
+    with the exact receive time of the scan windows."""
+    interval, window = scan_params(args.hal)
+    print('scan: interval %u us, window %u us, duty %.1f %%' % (
+        interval, window, 100 * window / interval))
+    rng = random.Random(args.seed)
+    end = int(args.hours * 3600e6)
+    presses = int(args.presses_per_day * args.hours / 24)
+    press_times = sorted(rng.randrange(end) for _ in range(presses))
+
+    rx_exact = 0
+    scan_us = 0
+    cpu_us = 0
+    adv_events = 0
+    words = 0
+    relay_us = 0
+    t = 0
+    for press in press_times + [end]:
+        if press < t:
+            continue
+        # the scanner runs from t to the press; windows start at t
+        on = press - t
+        scan_us += on
+        rx_exact += (on // interval) * window + min(on % interval, window)
+        if press == end:
+            break
+        # accepted command: processing, acknowledgement, relay pulse and a
+        # flash gap for the sequence number update
+        cpu_us += args.cpu_per_press_us
+        adv_events += args.ack_events
+        words += args.words_per_press
+        relay_us += args.relay_us
+        t = press + rng.randint(args.gap_min_ms, args.gap_max_ms) * 1000
+    sleep_us = end - cpu_us
+
+    snapshot = {
+        'uptime_ms': end // 1000, 'sleep_ms': sleep_us // 1000, 'scan_ms': scan_us // 1000,
+        'scan_window_us': window, 'scan_interval_us': interval,
+        'flash_words': words, 'erase_us': 0, 'relay_ms': relay_us // 1000,
+        'hfxo_ms': relay_us // 1000, 'adv_events': adv_events}
+    lines = ['energy: ' + ' '.join('%s=%u' % (k, snapshot[k]) for k in KEYS[:5]),
+             'energy: ' + ' '.join('%s=%u' % (k, snapshot[k]) for k in KEYS[5:])]
+    d = delta(parse_snapshots(lines)[-1], {})
+    print('simulated %.1f h, %u presses' % (args.hours, presses))
+    avg_model = report(d, p)
+
+    exact = dict(state_times(d, p), rx=rx_exact / 1e6)
+    avg_exact = sum(charges(exact, p).values()) / (end / 1e6)
+    error = (avg_model - avg_exact) / avg_exact
+    print('exact average current: %.1f uA, model error: %+.3f %%' % (
+        avg_exact * 1e3, 100 * error))
+    if abs(error) > args.tolerance / 100:
+        sys.exit('model error exceeds %.2f %%' % args.tolerance)
+
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--params', help='JSON file overriding model parameters')
+sub = parser.add_subparsers(dest='command', required=True)
+p = sub.add_parser('log', help='evaluate the energy snapshots of a log')
+p.add_argument('capture', nargs='?', help='log capture (default: stdin)')
+p = sub.add_parser('simulate', help='validate the model against the scan parameters')
+p.add_argument('--hal', default=os.path.join(os.path.dirname(__file__), 'hal_nrf52.c'))
+p.add_argument('--hours', type=float, default=24 * 7)
+p.add_argument('--presses-per-day', type=float, default=20)
+p.add_argument('--gap-min-ms', type=int, default=50)
+p.add_argument('--gap-max-ms', type=int, default=2000)
+p.add_argument('--cpu-per-press-us', type=int, default=20000)
+p.add_argument('--ack-events', type=int, default=15)
+p.add_argument('--words-per-press', type=int, default=4)
+p.add_argument('--relay-us', type=int, default=500000)
+p.add_argument('--seed', type=int, default=1)
+p.add_argument('--tolerance', type=float, default=0.5, help='maximum model error in %%')
+args = parser.parse_args()
+
+params = dict(PARAMS)
+if args.params:
+    with open(args.params) as f:
+        params.update(json.load(f))
+
+if args.command == 'simulate':
+    simulate(args, params)
+else:
+    snapshots = parse_snapshots(open(args.capture) if args.capture else sys.stdin)
+    if not snapshots:
+        sys.exit('no energy snapshots found')
+    old = snapshots[-2] if len(snapshots) > 1 else {}
+    report(delta(snapshots[-1], old), params)
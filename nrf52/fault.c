@@ -0,0 +1,173 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Fault recording and recovery
+ */
+
+#include <fault.h>
+#include <scheduler.h>
+#include <systime.h>
+
+#include <app_error.h>
+#include <hardfault.h>
+#include <nrf.h>
+#include <stddef.h>
+#include <nrf_log.h>
+#include <string.h>
+
+#define GD_FAULT_MAGIC 0x46415554
+
+typedef struct {
+    uint32_t magic;
+    bool pending; /* fault recorded, not yet evaluated */
+    gd_fault_t fault;
+    gd_fault_counters_t counters;
+    uint32_t checksum;
+} gd_fault_retained_t;
+
+/* located in a NOLOAD section after .bss (see the linker script) */
+static gd_fault_retained_t gd_fault_retained __attribute__((section(".gd_noinit")));
+
+/* evaluated at startup */
+static bool gd_fault_last_valid;
+static gd_fault_t gd_fault_last;
+static uint32_t gd_fault_reset_reason;
+
+static uint32_t gd_fault_checksum(const gd_fault_retained_t *r) {
+    const uint32_t *p = (const uint32_t *)r;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < offsetof(gd_fault_retained_t, checksum) / sizeof(uint32_t); i++) {
+        sum = (sum << 1 | sum >> 31) ^ p[i];
+    }
+    return sum;
+}
+
+static void gd_fault_seal(void) {
+    gd_fault_retained.magic = GD_FAULT_MAGIC;
+    gd_fault_retained.checksum = gd_fault_checksum(&gd_fault_retained);
+}
+
+void gd_fault_init(void) {
+    /* the cycle counter measures the time from the reset to
+     * gd_fault_recovered() */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    /* POWER is restricted once the SoftDevice is enabled */
+    gd_fault_reset_reason = NRF_POWER->RESETREAS;
+    NRF_POWER->RESETREAS = gd_fault_reset_reason;
+
+    gd_fault_retained_t *r = &gd_fault_retained;
+    if (gd_fault_reset_reason == 0 ||
+        r->magic != GD_FAULT_MAGIC ||
+        r->checksum != gd_fault_checksum(r)) {
+        /* power-on reset or corrupted data */
+        memset(r, 0, sizeof(*r));
+    }
+    if (r->pending) {
+        gd_fault_last = r->fault;
+        gd_fault_last_valid = true;
+        r->pending = false;
+        switch (r->fault.id) {
+            case NRF_FAULT_ID_SD_ASSERT:
+                r->counters.sd_asserts++;
+                break;
+            case NRF_FAULT_ID_SDK_ERROR:
+            case NRF_FAULT_ID_SDK_ASSERT:
+                r->counters.app_errors++;
+                break;
+            case GD_FAULT_ID_HARDFAULT:
+                r->counters.hardfaults++;
+                break;
+            default:
+                r->counters.other++;
+                break;
+        }
+    }
+    if (gd_fault_reset_reason & POWER_RESETREAS_DOG_Msk) {
+        r->counters.watchdog++;
+    }
+    gd_fault_seal();
+}
+
+bool gd_fault_get_last(gd_fault_t *fault) {
+    if (gd_fault_last_valid) {
+        *fault = gd_fault_last;
+    }
+    return gd_fault_last_valid;
+}
+
+void gd_fault_get_counters(gd_fault_counters_t *counters) {
+    *counters = gd_fault_retained.counters;
+}
+
+uint32_t gd_fault_get_reset_reason(void) {
+    uint32_t r = gd_fault_reset_reason;
+    uint32_t flags = 0;
+    if (r & POWER_RESETREAS_RESETPIN_Msk) {
+        flags |= GD_FAULT_RESET_PIN;
+    }
+    if (r & POWER_RESETREAS_DOG_Msk) {
+        flags |= GD_FAULT_RESET_DOG;
+    }
+    if (r & POWER_RESETREAS_SREQ_Msk) {
+        flags |= GD_FAULT_RESET_SREQ;
+    }
+    if (r & POWER_RESETREAS_LOCKUP_Msk) {
+        flags |= GD_FAULT_RESET_LOCKUP;
+    }
+    if (r & (POWER_RESETREAS_OFF_Msk | POWER_RESETREAS_LPCOMP_Msk |
+             POWER_RESETREAS_DIF_Msk | POWER_RESETREAS_NFC_Msk)) {
+        flags |= GD_FAULT_RESET_WAKEUP;
+    }
+    return flags;
+}
+
+void gd_fault_recovered(void) {
+    uint32_t us = DWT->CYCCNT / (SystemCoreClock / 1000000);
+    if (!gd_fault_last_valid) {
+        return;
+    }
+    NRF_LOG_INFO("recovered from fault after %u us", us);
+    if (us > gd_fault_retained.counters.recovery_max_us) {
+        gd_fault_retained.counters.recovery_max_us = us;
+        gd_fault_seal();
+    }
+}
+
+void gd_fault_log(void) {
+    const gd_fault_counters_t *c = &gd_fault_retained.counters;
+    NRF_LOG_INFO("reset reason: %08x", gd_fault_reset_reason);
+    if (gd_fault_last_valid) {
+        NRF_LOG_ERROR("fault: id = %u, pc = %08x, info = %08x",
+                      gd_fault_last.id, gd_fault_last.pc, gd_fault_last.info);
+        NRF_LOG_ERROR("fault: uptime = %u s, last event = %u",
+                      gd_fault_last.uptime_s, gd_fault_last.last_evt);
+    }
+    NRF_LOG_INFO("crashes: SD asserts = %u, app errors = %u, hard faults = %u, other = %u",
+                 c->sd_asserts, c->app_errors, c->hardfaults, c->other);
+    NRF_LOG_INFO("watchdog resets = %u, max. recovery time = %u us",
+                 c->watchdog, c->recovery_max_us);
+}
+
+void gd_fault_reset(uint32_t id, uint32_t pc, uint32_t info) {
+    __disable_irq();
+    gd_fault_retained.fault.id = id;
+    gd_fault_retained.fault.pc = pc;
+    gd_fault_retained.fault.info = info;
+    gd_fault_retained.fault.uptime_s = gd_time_ticks_locked() / GD_HAL_COUNTER_FREQ;
+    gd_fault_retained.fault.last_evt = gd_sched_last_event();
+    gd_fault_retained.pending = true;
+    gd_fault_seal();
+    NVIC_SystemReset();
+}
+
+/* called by the hardfault library */
+void HardFault_process(HardFault_stack_t *p_stack) {
+    gd_fault_reset(GD_FAULT_ID_HARDFAULT, p_stack->pc, p_stack->lr);
+}
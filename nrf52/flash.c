@@ -0,0 +1,407 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * fstorage backend with sliced page erase
+ *
+ * Operations are queued and executed one after the other. Each partial erase
+ * is executed in a radio timeslot of its own; the signal handler requests the
+ * next timeslot until the page has been erased for GDS_ERASE_TIME_MS in
+ * total. The session idle event then completes the operation in the context
+ * of the SoftDevice event handler. If the SoftDevice is not enabled (during
+ * initialization), operations are executed directly by the NVMC.
+ */
+
+#include <flash.h>
+
+#include <app_error.h>
+#include <app_util.h>
+#include <app_util_platform.h>
+#include <nrf.h>
+#include <nrf_fstorage.h>
+#include <nrf_fstorage_sd.h>
+#include <nrf_sdh.h>
+#include <nrf_sdh_soc.h>
+#include <nrf_soc.h>
+#include <string.h>
+
+#define GDS_FLASH_PAGE_SIZE 4096
+
+#define GDS_FLASH_SOC_OBSERVER_PRIO 0
+
+#define GDS_ERASE_SLICES CEIL_DIV(GDS_ERASE_TIME_MS, GDS_ERASE_SLICE_MS)
+
+/* timeslot for a partial erase including some margin for the handler */
+#define GDS_SLOT_LENGTH_US ((GDS_ERASE_SLICE_MS + 1) * 1000)
+#define GDS_SLOT_TIMEOUT_US 100000
+
+typedef enum {
+    GDS_FLASH_WRITE,
+    GDS_FLASH_ERASE,
+} gds_flash_op_type_t;
+
+typedef struct {
+    nrf_fstorage_t const *p_fs;
+    gds_flash_op_type_t type;
+    uint32_t addr;
+    void const *p_src;
+    uint32_t len; /* octets (write) or pages (erase) */
+    void *p_param;
+} gds_flash_op_t;
+
+static gds_flash_op_t gds_flash_queue[NRF_FSTORAGE_SD_QUEUE_SIZE];
+static unsigned gds_flash_head;
+static unsigned gds_flash_count;
+static bool gds_flash_running;
+static unsigned gds_flash_retries;
+static bool gds_session_open;
+static gds_flash_stats_t gds_flash_stats;
+
+/* The timeslot signal handler runs above all critical regions, so the
+ * statistics it updates are protected by a sequence counter: it is
+ * incremented before and after each update, and readers retry if it has
+ * changed while copying. */
+static volatile uint32_t gds_flash_stats_seq;
+
+/* erase progress, shared with the timeslot signal handler */
+static volatile uint32_t gds_erase_pages;
+static volatile unsigned gds_erase_slices;
+static volatile bool gds_erase_done;
+
+static nrf_fstorage_info_t gds_flash_info = {
+    .erase_unit = GDS_FLASH_PAGE_SIZE,
+    .program_unit = sizeof(uint32_t),
+    .rmap = true,
+    .wmap = false,
+};
+
+static nrf_radio_request_t gds_slot_request = {
+    .request_type = NRF_RADIO_REQ_TYPE_EARLIEST,
+    .params.earliest = {
+        .hfclk = NRF_RADIO_HFCLK_CFG_NO_GUARANTEE,
+        .priority = NRF_RADIO_PRIORITY_NORMAL,
+        .length_us = GDS_SLOT_LENGTH_US,
+        .timeout_us = GDS_SLOT_TIMEOUT_US,
+    }};
+
+static nrf_radio_signal_callback_return_param_t gds_slot_return;
+
+static void gds_nvmc_mode(uint32_t wen) {
+    NRF_NVMC->CONFIG = wen << NVMC_CONFIG_WEN_Pos;
+    __ISB();
+    __DSB();
+}
+
+static void gds_nvmc_wait(void) {
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {}
+}
+
+static void gds_nvmc_write(uint32_t addr, const uint32_t *src, size_t words) {
+    gds_nvmc_mode(NVMC_CONFIG_WEN_Wen);
+    for (size_t i = 0; i < words; i++) {
+        ((volatile uint32_t *)addr)[i] = src[i];
+        gds_nvmc_wait();
+    }
+    gds_nvmc_mode(NVMC_CONFIG_WEN_Ren);
+}
+
+static void gds_nvmc_erase(uint32_t page_addr) {
+    gds_nvmc_mode(NVMC_CONFIG_WEN_Een);
+    NRF_NVMC->ERASEPAGE = page_addr;
+    gds_nvmc_wait();
+    gds_nvmc_mode(NVMC_CONFIG_WEN_Ren);
+}
+
+static void gds_nvmc_erase_partial(uint32_t page_addr) {
+    gds_nvmc_mode(NVMC_CONFIG_WEN_Een);
+    NRF_NVMC->ERASEPAGEPARTIALCFG = GDS_ERASE_SLICE_MS;
+    NRF_NVMC->ERASEPAGEPARTIAL = page_addr;
+    gds_nvmc_wait();
+    gds_nvmc_mode(NVMC_CONFIG_WEN_Ren);
+}
+
+static unsigned gds_flash_hist_bin(uint32_t us) {
+    uint32_t ms = us / 1000;
+    unsigned bin = 0;
+    while (bin < GDS_STALL_HIST_BINS - 1 && ms >= (1UL << bin)) {
+        bin++;
+    }
+    return bin;
+}
+
+static void gds_flash_record_stall(uint32_t us) {
+    gds_flash_stats.stall_hist[gds_flash_hist_bin(us)]++;
+    if (us > gds_flash_stats.stall_max_us) {
+        gds_flash_stats.stall_max_us = us;
+    }
+}
+
+/* Timeslot signal handler. Runs at the highest interrupt priority, so no
+ * SoftDevice functions must be called.
+ */
+static nrf_radio_signal_callback_return_param_t *gds_slot_handler(uint8_t signal_type) {
+    gds_slot_return.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_NONE;
+    if (signal_type != NRF_RADIO_CALLBACK_SIGNAL_TYPE_START) {
+        return &gds_slot_return;
+    }
+    const gds_flash_op_t *op = &gds_flash_queue[gds_flash_head];
+
+    /* TIMER0 runs at 1 MHz during the timeslot */
+    NRF_TIMER0->TASKS_CAPTURE[0] = 1;
+    gds_nvmc_erase_partial(op->addr + gds_erase_pages * GDS_FLASH_PAGE_SIZE);
+    NRF_TIMER0->TASKS_CAPTURE[1] = 1;
+    gds_flash_stats_seq++;
+    __DMB();
+    gds_flash_record_stall(NRF_TIMER0->CC[1] - NRF_TIMER0->CC[0]);
+    gds_flash_stats.erase_us += NRF_TIMER0->CC[1] - NRF_TIMER0->CC[0];
+    gds_flash_stats.slices++;
+    if (++gds_erase_slices == GDS_ERASE_SLICES) {
+        gds_erase_slices = 0;
+        gds_erase_pages++;
+        gds_flash_stats.pages++;
+    }
+    __DMB();
+    gds_flash_stats_seq++;
+    if (gds_erase_pages < op->len) {
+        gds_slot_return.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_REQUEST_AND_END;
+        gds_slot_return.params.request.p_next = &gds_slot_request;
+    } else {
+        gds_erase_done = true;
+        gds_slot_return.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_END;
+    }
+    return &gds_slot_return;
+}
+
+static void gds_flash_process(void);
+
+static void gds_flash_complete(ret_code_t result) {
+    gds_flash_op_t op;
+    CRITICAL_REGION_ENTER();
+    op = gds_flash_queue[gds_flash_head];
+    gds_flash_head = (gds_flash_head + 1) % NRF_FSTORAGE_SD_QUEUE_SIZE;
+    gds_flash_count--;
+    gds_flash_running = false;
+    if (op.type == GDS_FLASH_WRITE && result == NRF_SUCCESS) {
+        gds_flash_stats.words_written += op.len / sizeof(uint32_t);
+    }
+    CRITICAL_REGION_EXIT();
+
+    nrf_fstorage_evt_t evt = {
+        .id = op.type == GDS_FLASH_WRITE ? NRF_FSTORAGE_EVT_WRITE_RESULT
+                                         : NRF_FSTORAGE_EVT_ERASE_RESULT,
+        .result = result,
+        .addr = op.addr,
+        .p_src = op.p_src,
+        .len = op.len,
+        .p_param = op.p_param,
+    };
+    if (op.p_fs->evt_handler != NULL) {
+        op.p_fs->evt_handler(&evt);
+    }
+    gds_flash_process();
+}
+
+/* start or retry the operation at the head of the queue */
+static void gds_flash_start(const gds_flash_op_t *op) {
+    ret_code_t r;
+    if (!nrf_sdh_is_enabled()) {
+        if (op->type == GDS_FLASH_WRITE) {
+            gds_nvmc_write(op->addr, op->p_src, op->len / sizeof(uint32_t));
+        } else {
+            for (uint32_t i = 0; i < op->len; i++) {
+                gds_nvmc_erase(op->addr + i * GDS_FLASH_PAGE_SIZE);
+            }
+        }
+        gds_flash_complete(NRF_SUCCESS);
+        return;
+    }
+    if (op->type == GDS_FLASH_WRITE) {
+        r = sd_flash_write((uint32_t *)op->addr,
+                           (const uint32_t *)op->p_src,
+                           op->len / sizeof(uint32_t));
+    } else {
+        gds_erase_pages = 0;
+        gds_erase_slices = 0;
+        gds_erase_done = false;
+        r = NRF_SUCCESS;
+        if (!gds_session_open) {
+            r = sd_radio_session_open(gds_slot_handler);
+            gds_session_open = r == NRF_SUCCESS;
+        }
+        if (r == NRF_SUCCESS) {
+            r = sd_radio_request(&gds_slot_request);
+        }
+    }
+    if (r != NRF_SUCCESS) {
+        gds_flash_complete(r);
+    }
+}
+
+static void gds_flash_process(void) {
+    const gds_flash_op_t *op = NULL;
+    CRITICAL_REGION_ENTER();
+    if (!gds_flash_running && gds_flash_count > 0) {
+        gds_flash_running = true;
+        op = &gds_flash_queue[gds_flash_head];
+    }
+    CRITICAL_REGION_EXIT();
+    if (op != NULL) {
+        gds_flash_retries = 0;
+        gds_flash_start(op);
+    }
+}
+
+static ret_code_t gds_flash_enqueue(const gds_flash_op_t *op) {
+    ret_code_t r = NRF_SUCCESS;
+    CRITICAL_REGION_ENTER();
+    if (gds_flash_count < NRF_FSTORAGE_SD_QUEUE_SIZE) {
+        gds_flash_queue[(gds_flash_head + gds_flash_count) % NRF_FSTORAGE_SD_QUEUE_SIZE] = *op;
+        gds_flash_count++;
+    } else {
+        r = NRF_ERROR_NO_MEM;
+    }
+    CRITICAL_REGION_EXIT();
+    if (r == NRF_SUCCESS) {
+        gds_flash_process();
+    }
+    return r;
+}
+
+static void gds_flash_soc_evt_handler(uint32_t evt_id, void *p_context) {
+    if (!gds_flash_running) {
+        return;
+    }
+    const gds_flash_op_t *op = &gds_flash_queue[gds_flash_head];
+    switch (evt_id) {
+        case NRF_EVT_FLASH_OPERATION_SUCCESS:
+            if (op->type == GDS_FLASH_WRITE) {
+                gds_flash_complete(NRF_SUCCESS);
+            }
+            break;
+        case NRF_EVT_FLASH_OPERATION_ERROR:
+            if (op->type == GDS_FLASH_WRITE) {
+                if (++gds_flash_retries < NRF_FSTORAGE_SD_MAX_RETRIES) {
+                    gds_flash_start(op);
+                } else {
+                    gds_flash_complete(NRF_ERROR_TIMEOUT);
+                }
+            }
+            break;
+        case NRF_EVT_RADIO_BLOCKED:
+        case NRF_EVT_RADIO_CANCELED:
+            if (op->type == GDS_FLASH_ERASE && !gds_erase_done) {
+                gds_flash_stats.blocked++;
+                APP_ERROR_CHECK(sd_radio_request(&gds_slot_request));
+            }
+            break;
+        case NRF_EVT_RADIO_SESSION_IDLE:
+            if (op->type == GDS_FLASH_ERASE && gds_erase_done) {
+                gds_flash_complete(NRF_SUCCESS);
+            }
+            break;
+        case NRF_EVT_RADIO_SIGNAL_CALLBACK_INVALID_RETURN:
+            APP_ERROR_CHECK(NRF_ERROR_INTERNAL);
+            break;
+        default:
+            break;
+    }
+}
+
+NRF_SDH_SOC_OBSERVER(gds_flash_soc_observer, GDS_FLASH_SOC_OBSERVER_PRIO,
+                     gds_flash_soc_evt_handler, NULL);
+
+static ret_code_t gds_flash_init(nrf_fstorage_t *p_fs, void *p_param) {
+    p_fs->p_flash_info = &gds_flash_info;
+    return NRF_SUCCESS;
+}
+
+static ret_code_t gds_flash_uninit(nrf_fstorage_t *p_fs, void *p_param) {
+    return NRF_SUCCESS;
+}
+
+static ret_code_t gds_flash_read(nrf_fstorage_t const *p_fs, uint32_t src,
+                                 void *p_dest, uint32_t len) {
+    memcpy(p_dest, (const void *)src, len);
+    return NRF_SUCCESS;
+}
+
+static ret_code_t gds_flash_write(nrf_fstorage_t const *p_fs, uint32_t dest,
+                                  void const *p_src, uint32_t len, void *p_param) {
+    gds_flash_op_t op = {
+        .p_fs = p_fs,
+        .type = GDS_FLASH_WRITE,
+        .addr = dest,
+        .p_src = p_src,
+        .len = len,
+        .p_param = p_param,
+    };
+    return gds_flash_enqueue(&op);
+}
+
+static ret_code_t gds_flash_erase(nrf_fstorage_t const *p_fs, uint32_t page_addr,
+                                  uint32_t len, void *p_param) {
+    gds_flash_op_t op = {
+        .p_fs = p_fs,
+        .type = GDS_FLASH_ERASE,
+        .addr = page_addr,
+        .len = len,
+        .p_param = p_param,
+    };
+    return gds_flash_enqueue(&op);
+}
+
+static uint8_t const *gds_flash_rmap(nrf_fstorage_t const *p_fs, uint32_t addr) {
+    return (uint8_t const *)addr;
+}
+
+static uint8_t *gds_flash_wmap(nrf_fstorage_t const *p_fs, uint32_t addr) {
+    return NULL;
+}
+
+static bool gds_flash_is_busy(nrf_fstorage_t const *p_fs) {
+    return gds_flash_count > 0;
+}
+
+/* replaces the implementation of nrf_fstorage_sd.c */
+nrf_fstorage_api_t nrf_fstorage_sd = {
+    .init = gds_flash_init,
+    .uninit = gds_flash_uninit,
+    .read = gds_flash_read,
+    .write = gds_flash_write,
+    .erase = gds_flash_erase,
+    .rmap = gds_flash_rmap,
+    .wmap = gds_flash_wmap,
+    .is_busy = gds_flash_is_busy,
+};
+
+uint32_t gds_flash_erase_count(void) {
+    return gds_flash_stats.slices;
+}
+
+void gds_flash_record_actuation(uint32_t latency_us, uint32_t erase_count) {
+    if (gds_flash_stats.slices == erase_count) {
+        return;
+    }
+    CRITICAL_REGION_ENTER();
+    gds_flash_stats.act_count++;
+    gds_flash_stats.act_hist[gds_flash_hist_bin(latency_us)]++;
+    if (latency_us > gds_flash_stats.act_max_us) {
+        gds_flash_stats.act_max_us = latency_us;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+void gds_flash_get_stats(gds_flash_stats_t *stats) {
+    uint32_t seq;
+    do {
+        seq = gds_flash_stats_seq;
+        __DMB();
+        CRITICAL_REGION_ENTER();
+        *stats = gds_flash_stats;
+        CRITICAL_REGION_EXIT();
+        __DMB();
+    } while (seq != gds_flash_stats_seq);
+}
@@ -0,0 +1,265 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Hardware abstraction layer for the nRF52 with the S132 SoftDevice
+ */
+
+#include <hal.h>
+#include <energy.h>
+#include <memstat.h>
+#include <ramfunc.h>
+
+#include <app_error.h>
+#include <app_timer.h>
+#include <app_util_platform.h>
+#include <ble.h>
+#include <nrf_gpio.h>
+#include <nrf_log.h>
+#include <nrf_log_ctrl.h>
+#include <nrf_nvic.h>
+#include <nrf_pwr_mgmt.h>
+#include <nrf_rtc.h>
+#include <nrf_sdh.h>
+#include <nrf_sdh_ble.h>
+#include <nrfx_gpiote.h>
+#include <sdk_config.h>
+#include <string.h>
+
+#define APP_BLE_OBSERVER_PRIO 3
+#define APP_BLE_CONN_CFG_TAG  1
+
+static app_timer_t gd_hal_timer_data[GD_HAL_TIMER_COUNT];
+static unsigned gd_hal_timers;
+
+typedef struct {
+    uint32_t pin;
+    gd_hal_gpio_handler_t handler;
+} gd_hal_gpio_input_t;
+
+static gd_hal_gpio_input_t gd_hal_gpio_inputs[GD_HAL_GPIO_INPUT_COUNT];
+static unsigned gd_hal_gpio_input_count;
+
+static uint8_t scan_buffer[BLE_GAP_SCAN_BUFFER_MAX];
+
+static const ble_gap_scan_params_t scan_params = {
+    .extended = 0,
+    .report_incomplete_evts = 0,
+    .active = 0,
+    .filter_policy = BLE_GAP_SCAN_FP_ACCEPT_ALL,
+    .scan_phys = BLE_GAP_PHY_1MBPS,
+    .interval = MSEC_TO_UNITS(50, UNIT_0_625_MS),
+    .window = MSEC_TO_UNITS(30, UNIT_0_625_MS),
+    .timeout = BLE_GAP_SCAN_TIMEOUT_UNLIMITED,
+    .channel_mask = {0, 0, 0, 0, 0}};
+
+/* app_timer runs RTC1 from the 32768 Hz LFCLK with the prescaler
+ * APP_TIMER_CONFIG_RTC_FREQUENCY (divisor APP_TIMER_CONFIG_RTC_FREQUENCY + 1);
+ * all tick conversions (systime.h) depend on GD_HAL_COUNTER_FREQ */
+#define GD_HAL_LFCLK_FREQ 32768
+
+STATIC_ASSERT(GD_HAL_COUNTER_FREQ == GD_HAL_LFCLK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1));
+STATIC_ASSERT(GD_HAL_ADDR_LEN == BLE_GAP_ADDR_LEN);
+
+static gd_hal_radio_handler_t gd_hal_radio_handler;
+static volatile bool gd_hal_scanning;
+
+/* The counter and critical regions use the inline register and SoftDevice
+ * NVIC functions rather than app_timer_cnt_get() and
+ * app_util_critical_region_enter/exit(), which execute from flash. */
+
+GD_RAMFUNC uint32_t gd_hal_counter(void) {
+    /* app_timer runs on RTC1 */
+    return nrf_rtc_counter_get(NRF_RTC1) & GD_HAL_COUNTER_MASK;
+}
+
+GD_RAMFUNC uint32_t gd_hal_critical_enter(void) {
+    uint8_t nested;
+    (void)sd_nvic_critical_region_enter(&nested);
+    return nested;
+}
+
+GD_RAMFUNC void gd_hal_critical_exit(uint32_t state) {
+    (void)sd_nvic_critical_region_exit(state);
+}
+
+/* the timers are allocated from a pool (see APP_TIMER_DEF) */
+void gd_hal_timer_create(gd_hal_timer_t *timer, bool repeated,
+                         gd_hal_timer_handler_t handler) {
+    APP_ERROR_CHECK_BOOL(gd_hal_timers < GD_HAL_TIMER_COUNT);
+    *timer = gd_hal_timers++;
+    app_timer_id_t id = &gd_hal_timer_data[*timer];
+    APP_ERROR_CHECK(app_timer_create(&id,
+                                     repeated ? APP_TIMER_MODE_REPEATED
+                                              : APP_TIMER_MODE_SINGLE_SHOT,
+                                     handler));
+}
+
+GD_RAMFUNC void gd_hal_timer_start(gd_hal_timer_t timer, uint32_t ms, void *context) {
+    APP_ERROR_CHECK(app_timer_start(&gd_hal_timer_data[timer], APP_TIMER_TICKS(ms), context));
+}
+
+void gd_hal_timer_stop(gd_hal_timer_t timer) {
+    APP_ERROR_CHECK(app_timer_stop(&gd_hal_timer_data[timer]));
+}
+
+void gd_hal_gpio_output(uint32_t pin, bool level) {
+    nrf_gpio_pin_write(pin, level);
+    nrf_gpio_cfg_output(pin);
+}
+
+void gd_hal_gpio_output_high_drive(uint32_t pin, bool level) {
+    nrf_gpio_pin_write(pin, level);
+    nrf_gpio_cfg(pin,
+                 NRF_GPIO_PIN_DIR_OUTPUT,
+                 NRF_GPIO_PIN_INPUT_DISCONNECT,
+                 NRF_GPIO_PIN_NOPULL,
+                 NRF_GPIO_PIN_S0H1,
+                 NRF_GPIO_PIN_NOSENSE);
+}
+
+GD_RAMFUNC void gd_hal_gpio_write(uint32_t pin, bool level) {
+    nrf_gpio_pin_write(pin, level);
+}
+
+GD_RAMFUNC bool gd_hal_gpio_get_output(uint32_t pin) {
+    return nrf_gpio_pin_out_read(pin);
+}
+
+static void gd_hal_gpio_edge_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
+    for (unsigned i = 0; i < gd_hal_gpio_input_count; i++) {
+        if (gd_hal_gpio_inputs[i].pin == pin) {
+            gd_hal_gpio_inputs[i].handler(pin);
+        }
+    }
+}
+
+/* the inputs use the GPIOTE PORT event (SENSE), so no HFCLK is needed while
+ * waiting for an edge */
+void gd_hal_gpio_input(uint32_t pin, gd_hal_pull_t pull, gd_hal_gpio_handler_t handler) {
+    static const nrf_gpio_pin_pull_t gd_hal_pull[] = {
+        [GD_HAL_PULL_NONE] = NRF_GPIO_PIN_NOPULL,
+        [GD_HAL_PULL_DOWN] = NRF_GPIO_PIN_PULLDOWN,
+        [GD_HAL_PULL_UP] = NRF_GPIO_PIN_PULLUP};
+    APP_ERROR_CHECK_BOOL(gd_hal_gpio_input_count < GD_HAL_GPIO_INPUT_COUNT);
+    gd_hal_gpio_inputs[gd_hal_gpio_input_count++] = (gd_hal_gpio_input_t){
+        .pin = pin, .handler = handler};
+    if (!nrfx_gpiote_is_init()) {
+        APP_ERROR_CHECK(nrfx_gpiote_init());
+    }
+    nrfx_gpiote_in_config_t config = NRFX_GPIOTE_CONFIG_IN_SENSE_TOGGLE(false);
+    config.pull = gd_hal_pull[pull];
+    APP_ERROR_CHECK(nrfx_gpiote_in_init(pin, &config, gd_hal_gpio_edge_handler));
+    nrfx_gpiote_in_event_enable(pin, true);
+}
+
+bool gd_hal_gpio_read(uint32_t pin) {
+    return nrf_gpio_pin_read(pin);
+}
+
+void gd_hal_sleep(void) {
+    nrf_pwr_mgmt_run();
+}
+
+/**@brief Function for handling BLE events.
+ *
+ * @param[in]   p_ble_evt   Bluetooth stack event.
+ * @param[in]   p_context   Unused.
+ */
+GD_RAMFUNC static void ble_evt_handler(ble_evt_t const *p_ble_evt, void *p_context) {
+    ret_code_t err_code = NRF_SUCCESS;
+
+    switch (p_ble_evt->header.evt_id) {
+
+        case BLE_GAP_EVT_ADV_REPORT:;
+            const ble_gap_evt_adv_report_t *report = &p_ble_evt->evt.gap_evt.params.adv_report;
+            gd_hal_radio_handler(report->peer_addr.addr, report->data.p_data, report->data.len,
+                                 report->rssi);
+            if (!gd_hal_scanning) {
+                break;
+            }
+            ble_data_t scan_data = {
+                .p_data = scan_buffer,
+                .len = sizeof(scan_buffer)};
+            err_code = sd_ble_gap_scan_start(NULL, &scan_data);
+            /* the scanner may already have been restarted after a scan gap
+             * if this report was queued before the gap */
+            if (err_code != NRF_ERROR_INVALID_STATE) {
+                APP_ERROR_CHECK(err_code);
+            }
+            break;
+
+        default:
+            NRF_LOG_DEBUG("ble_evt_handler: evt_id = %02x", p_ble_evt->header.evt_id);
+            // No implementation needed.
+            break;
+    }
+}
+
+/**@brief Function for initializing the BLE stack.
+ *
+ * @details Initializes the SoftDevice and the BLE event interrupt.
+ */
+void gd_hal_radio_init(gd_hal_radio_handler_t handler) {
+    ret_code_t err_code;
+
+    gd_hal_radio_handler = handler;
+    err_code = nrf_sdh_enable_request();
+    APP_ERROR_CHECK(err_code);
+
+    // Configure the BLE stack using the default settings.
+    // Fetch the start address of the application RAM.
+    uint32_t ram_start = 0;
+    err_code = nrf_sdh_ble_default_cfg_set(APP_BLE_CONN_CFG_TAG, &ram_start);
+    APP_ERROR_CHECK(err_code);
+
+    // Scanner and broadcaster only: no connections and a single advertising
+    // set (acknowledgements and beacons). The default configuration does not
+    // set the role counts if there are no links (see sdk_config.h).
+    ble_cfg_t ble_cfg;
+    memset(&ble_cfg, 0, sizeof(ble_cfg));
+    ble_cfg.gap_cfg.role_count_cfg.adv_set_count = BLE_GAP_ADV_SET_COUNT_DEFAULT;
+    ble_cfg.gap_cfg.role_count_cfg.periph_role_count = 0;
+    ble_cfg.gap_cfg.role_count_cfg.central_role_count = 0;
+    ble_cfg.gap_cfg.role_count_cfg.central_sec_count = 0;
+    err_code = sd_ble_cfg_set(BLE_GAP_CFG_ROLE_COUNT, &ble_cfg, ram_start);
+    APP_ERROR_CHECK(err_code);
+
+    // Enable BLE stack. ram_start returns the RAM start required for the
+    // configuration; NRF_ERROR_NO_MEM if the linker script reserves less.
+    err_code = nrf_sdh_ble_enable(&ram_start);
+    gd_mem_set_sd_ram_start(ram_start);
+    if (err_code == NRF_ERROR_NO_MEM) {
+        NRF_LOG_ERROR("RAM origin too low, the SoftDevice needs 0x%08x", ram_start);
+        NRF_LOG_FINAL_FLUSH();
+    }
+    APP_ERROR_CHECK(err_code);
+
+    // Register a handler for BLE events.
+    NRF_SDH_BLE_OBSERVER(gd_ble_observer, APP_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
+
+    gd_energy_scan_config(scan_params.interval, scan_params.window);
+}
+
+void gd_hal_scan_start(void) {
+    ble_data_t data = {
+        .p_data = scan_buffer,
+        .len = sizeof(scan_buffer)};
+    gd_hal_scanning = true;
+    uint32_t err_code = sd_ble_gap_scan_start(&scan_params, &data);
+    APP_ERROR_CHECK(err_code);
+    gd_energy_scan(true);
+}
+
+void gd_hal_scan_stop(void) {
+    gd_hal_scanning = false;
+    /* fails if the scanner is paused after an advertising report */
+    uint32_t err_code = sd_ble_gap_scan_stop();
+    if (err_code != NRF_ERROR_INVALID_STATE) {
+        APP_ERROR_CHECK(err_code);
+    }
+    gd_energy_scan(false);
+}
@@ -0,0 +1,157 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Health telemetry beacon
+ */
+
+#include <health.h>
+#include <ack.h>
+#include <auth.h>
+#include <fault.h>
+#include <hal.h>
+#include <metrics.h>
+#include <prof.h>
+#include <scheduler.h>
+#include <storage.h>
+#include <systime.h>
+
+#include <nrf_log.h>
+#include <string.h>
+
+#define GD_HEALTH_AD_LEN (2 + sizeof(gd_ad_health_data_t))
+
+/* on-air octets of an advertising PDU: preamble, access address, header,
+ * AdvA, AD structure and CRC */
+#define GD_HEALTH_PDU_OCTETS (1 + 4 + 2 + 6 + GD_HEALTH_AD_LEN + 3)
+/* an advertising event is sent on three channels at 1 Mbit/s */
+#define GD_HEALTH_EVENT_AIRTIME_US (3 * 8 * GD_HEALTH_PDU_OCTETS)
+
+static gd_hal_timer_t gd_health_timer;
+
+static uint8_t gd_health_key[GD_TX_KEY_SIZE];
+
+/* a beacon may still use one buffer while the other one is updated */
+static uint8_t gd_health_adv_buffer[2][GD_HEALTH_AD_LEN];
+static unsigned gd_health_buf_ndx;
+
+static uint32_t gd_health_pkts;
+static unsigned gd_health_defer_count;
+static gd_health_stats_t gd_health_stats;
+
+static void gd_health_timer_handler(void *dummy) {
+    gd_sched_post(GD_EVT_HEALTH);
+}
+
+static void gd_health_schedule(uint32_t ms) {
+    gd_health_pkts = gd_metric_get(GD_METRIC_PKT_PARSED);
+    gd_hal_timer_start(gd_health_timer, ms, NULL);
+}
+
+static void gd_health_put(uint8_t *p, uint32_t value, unsigned octets) {
+    for (unsigned i = 0; i < octets; i++) {
+        p[i] = value >> (8 * i);
+    }
+}
+
+static uint32_t gd_health_sat16(uint32_t value) {
+    return value > UINT16_MAX ? UINT16_MAX : value;
+}
+
+static uint8_t gd_health_reset_reason(void) {
+    uint32_t r = gd_fault_get_reset_reason();
+    uint8_t flags = 0;
+    gd_fault_t fault;
+    if (r & GD_FAULT_RESET_PIN) {
+        flags |= GD_HEALTH_RESET_PIN;
+    }
+    if (r & GD_FAULT_RESET_DOG) {
+        flags |= GD_HEALTH_RESET_DOG;
+    }
+    if (r & GD_FAULT_RESET_SREQ) {
+        flags |= GD_HEALTH_RESET_SREQ;
+    }
+    if (r & GD_FAULT_RESET_LOCKUP) {
+        flags |= GD_HEALTH_RESET_LOCKUP;
+    }
+    if (r & GD_FAULT_RESET_WAKEUP) {
+        flags |= GD_HEALTH_RESET_WAKEUP;
+    }
+    if (gd_fault_get_last(&fault)) {
+        flags |= GD_HEALTH_RESET_FAULT;
+    }
+    return flags;
+}
+
+static void gd_health_build(uint8_t *buf) {
+    GD_PROF_SCOPE(GD_PROF_HEALTH);
+    gd_ad_health_data_t *h = (gd_ad_health_data_t *)&buf[2];
+    uint32_t free_words = 0;
+
+    buf[0] = 1 + sizeof(gd_ad_health_data_t);
+    buf[1] = AD_TYPE_MANUFACTURER_DATA;
+    gd_health_put(h->company, GD_HEALTH_COMPANY_ID, sizeof(h->company));
+    h->marker = GD_HEALTH_MARKER;
+    h->version = GD_HEALTH_VERSION;
+    gd_health_put(h->uptime_s, GD_TIME_TICKS_TO_MS(gd_time_ticks()) / 1000,
+                  sizeof(h->uptime_s));
+    h->reset_reason = gd_health_reset_reason();
+    gds_get_free_words(&free_words);
+    gd_health_put(h->fds_free_words, gd_health_sat16(free_words), sizeof(h->fds_free_words));
+    gd_health_put(h->actuations, gd_metric_get(GD_METRIC_ACTUATIONS), sizeof(h->actuations));
+    gd_health_put(h->drops, gd_health_sat16(gd_metric_get(GD_METRIC_FIFO_DROPS)),
+                  sizeof(h->drops));
+    gd_health_put(h->lockouts, gd_health_sat16(gd_metric_get(GD_METRIC_LOCKOUTS)),
+                  sizeof(h->lockouts));
+    gd_health_calc_digest(gd_health_key, (const uint8_t *)h,
+                          offsetof(gd_ad_health_data_t, digest), h->digest);
+}
+
+void gd_health_init(void) {
+    memset(&gd_health_stats, 0, sizeof(gd_health_stats));
+    gd_calculate_health_key(gd_health_key);
+    gd_hal_timer_create(&gd_health_timer, false, gd_health_timer_handler);
+    gd_health_schedule(GD_HEALTH_INTERVAL_MS);
+}
+
+void gd_health_evt_handler(void) {
+    if (gd_health_defer_count < GD_HEALTH_MAX_DEFER &&
+        gd_metric_get(GD_METRIC_PKT_PARSED) != gd_health_pkts) {
+        /* transmitters are active, wait for a quiet period */
+        gd_health_defer_count++;
+        gd_health_stats.deferred++;
+        gd_health_schedule(GD_HEALTH_QUIET_MS);
+        return;
+    }
+    uint8_t *buf = gd_health_adv_buffer[gd_health_buf_ndx];
+    gd_health_build(buf);
+    if (!gd_ack_beacon(buf, GD_HEALTH_AD_LEN, GD_HEALTH_ADV_INTERVAL_MS,
+                       GD_HEALTH_ADV_EVENTS)) {
+        /* acknowledgement running */
+        gd_health_stats.deferred++;
+        gd_health_schedule(GD_HEALTH_QUIET_MS);
+        return;
+    }
+    gd_health_buf_ndx ^= 1;
+    gd_health_defer_count = 0;
+    gd_health_stats.beacons++;
+    gd_health_schedule(GD_HEALTH_INTERVAL_MS);
+}
+
+void gd_health_get_stats(gd_health_stats_t *stats) {
+    gd_ack_stats_t ack;
+    gd_ack_get_stats(&ack);
+    *stats = gd_health_stats;
+    stats->adv_events = ack.beacon_events;
+    stats->airtime_us = ack.beacon_events * GD_HEALTH_EVENT_AIRTIME_US;
+}
+
+void gd_health_log(void) {
+    gd_health_stats_t s;
+    gd_health_get_stats(&s);
+    NRF_LOG_INFO("health: %u beacons, %u deferred, %u adv. events, airtime %u us",
+                 s.beacons, s.deferred, s.adv_events, s.airtime_us);
+}
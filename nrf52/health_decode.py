@@ -0,0 +1,77 @@
+#!/usr/bin/python3
+#
+# BLE garage door opener remote control
+#
+# Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+#
+# Verify and decode health beacons (see include/health.h) from recorded
+# captures. Any line containing the advertising data as hex octets (with or
+# without separators, e.g. from btmon or nRF Connect) is recognized.
+#
+
+import argparse
+import hashlib
+import hmac
+import re
+import struct
+import sys
+
+COMPANY_ID = 0xffff
+MARKER = 0x67
+VERSION = 1
+KEY_LABEL = b'health'
+
+# company, marker, version, uptime_s, reset_reason, fds_free_words,
+# actuations, drops, lockouts, digest
+FORMAT = '<HBBIBHIHH4s'
+SIZE = struct.calcsize(FORMAT)
+DIGEST_OFFSET = SIZE - 4
+
+RESET_FLAGS = [(0x01, 'pin'), (0x02, 'watchdog'), (0x04, 'soft'), (0x08, 'lockup'),
+               (0x10, 'wakeup'), (0x80, 'fault')]
+
+parser = argparse.ArgumentParser()
+parser.add_argument('keyfile', help='Receiver Master Key (binary)')
+parser.add_argument('capture', nargs='?', help='capture (default: stdin)')
+args = parser.parse_args()
+
+with open(args.keyfile, 'rb') as f:
+    key = hmac.new(f.read(), KEY_LABEL, hashlib.sha256).digest()
+
+header = struct.pack('<HBB', COMPANY_ID, MARKER, VERSION)
+
+
+def hex_octets(line):
+    """octets of all hex sequences of a line"""
+    text = re.sub(r'\b0x', '', line)
+    for run in re.findall(r'(?:[0-9A-Fa-f]{2}[ :-]?)+', text):
+        digits = re.sub(r'[ :-]', '', run)
+        if len(digits) % 2 == 0:
+            yield bytes.fromhex(digits)
+
+
+def decode(data):
+    (_, _, _, uptime, reset, free_words, actuations, drops, lockouts,
+     digest) = struct.unpack_from(FORMAT, data)
+    expected = hmac.new(key, data[:DIGEST_OFFSET], hashlib.sha256).digest()[:4]
+    reasons = [name for (flag, name) in RESET_FLAGS if reset & flag] or ['power-on']
+    print('%s uptime %ud %02u:%02u:%02u, reset: %s, fds free: %u words, '
+          'actuations: %u, drops: %u, lockouts: %u' % (
+              'valid  ' if hmac.compare_digest(digest, expected) else 'INVALID',
+              uptime // 86400, uptime // 3600 % 24, uptime // 60 % 60, uptime % 60,
+              ','.join(reasons), free_words, actuations, drops, lockouts))
+
+
+lines = open(args.capture) if args.capture else sys.stdin
+last = None
+for line in lines:
+    for octets in hex_octets(line):
+        pos = octets.find(header)
+        if pos < 0 or len(octets) < pos + SIZE:
+            continue
+        data = octets[pos:pos + SIZE]
+        if data != last:  # a burst repeats the same data
+            decode(data)
+            last = data
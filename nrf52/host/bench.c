@@ -0,0 +1,157 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Benchmark of the Advertising Data parser on a Linux host
+ *
+ * Runs the parser of handle_adv_report() (adv_data.c) over the corpus of
+ * advertising payloads of other devices (see corpus.h) mixed with commands
+ * and reports the parsed and rejected reports per second. The nRF52 figures
+ * are the host figures divided by the given CPU scale (speed ratio of the
+ * host to the nRF52).
+ */
+
+#include <corpus.h>
+
+#include <adv_data.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GD_BENCH_PACKETS 1024
+
+/* uniform in [0, n) */
+static uint32_t gd_bench_rand(uint32_t n) {
+    return n > 0 ? (uint32_t)(drand48() * n) : 0;
+}
+
+static uint64_t gd_bench_cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* advertising data of a command (see gd_ad_service_data_t); the parser does
+ * not check the digest */
+static size_t gd_bench_command(uint8_t *buf, const ble_uuid128_t *uuid, uint32_t seq_no) {
+    gd_ad_service_data_t sd;
+    sd.uuid = *uuid;
+    sd.msg.cmd = 0x01;
+    sd.msg.seq_no[0] = seq_no >> 16;
+    sd.msg.seq_no[1] = seq_no >> 8;
+    sd.msg.seq_no[2] = seq_no;
+    for (size_t i = 0; i < sizeof(sd.msg.digest); i++) {
+        sd.msg.digest[i] = gd_bench_rand(256);
+    }
+    buf[0] = GD_AD_SERVICE_DATA_LEN;
+    buf[1] = AD_TYPE_SERVICE_DATA128;
+    memcpy(&buf[2], &sd, sizeof(sd));
+    return 2 + sizeof(sd);
+}
+
+/* The corpus (each kind equally often) and commands of one transmitter,
+ * parsed like in handle_adv_report() */
+static void gd_bench_run(unsigned passes, double cpu_scale) {
+    static uint8_t data[GD_BENCH_PACKETS][31];
+    static size_t len[GD_BENCH_PACKETS];
+    ble_uuid128_t uuid;
+    uint32_t seq_no = 0;
+    uint32_t commands = 0;
+    uint32_t rejects = 0;
+
+    for (size_t i = 0; i < sizeof(uuid.uuid128); i++) {
+        uuid.uuid128[i] = gd_bench_rand(256);
+    }
+    for (unsigned i = 0; i < GD_BENCH_PACKETS; i++) {
+        unsigned kind = i % (GD_CORPUS_COUNT + 1);
+        if (kind == GD_CORPUS_COUNT) {
+            len[i] = gd_bench_command(data[i], &uuid, ++seq_no);
+        } else {
+            len[i] = gd_corpus_packet(kind, data[i], gd_bench_rand);
+        }
+    }
+    uint64_t start = gd_bench_cpu_ns();
+    for (unsigned pass = 0; pass < passes; pass++) {
+        for (unsigned i = 0; i < GD_BENCH_PACKETS; i++) {
+            gd_ad_iter_t it;
+            gd_ad_struct_t ads;
+            bool found = false;
+            gd_ad_iter_init(&it, data[i], len[i]);
+            while (gd_ad_iter_next(&it, &ads)) {
+                const gd_ad_service_data_t *sd = gd_ad_as_service_data(&ads);
+                if (sd != NULL) {
+                    /* the report is copied into the FIFO */
+                    volatile gd_message_t msg = sd->msg;
+                    (void)msg;
+                    found = true;
+                }
+            }
+            if (found) {
+                commands++;
+            } else {
+                rejects++;
+            }
+        }
+    }
+    double seconds = (gd_bench_cpu_ns() - start) / 1e9;
+    uint32_t reports = commands + rejects;
+    printf("corpus:           %u packets (", GD_BENCH_PACKETS);
+    for (unsigned kind = 0; kind < GD_CORPUS_COUNT; kind++) {
+        printf("%s, ", gd_corpus_name(kind));
+    }
+    printf("commands)\n");
+    printf("reports:          %u (commands %u, rejects %u) in %.3f s\n",
+           reports, commands, rejects, seconds);
+    printf("host:             %.0f reports/s, %.0f rejects/s, %.1f ns per report\n",
+           reports / seconds, rejects / seconds, seconds * 1e9 / reports);
+    printf("nRF52 (scale %g): %.0f reports/s, %.0f rejects/s\n", cpu_scale,
+           reports / seconds / cpu_scale, rejects / seconds / cpu_scale);
+}
+
+static void gd_bench_usage(const char *name) {
+    printf("usage: %s [options]\n"
+           "  -s, --seed N        random seed (default: 1)\n"
+           "  -n, --passes N      passes over the corpus (1000)\n"
+           "  -c, --cpu-scale X   host CPU speed relative to the nRF52 (40)\n",
+           name);
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option options[] = {
+        {"seed", required_argument, NULL, 's'},
+        {"passes", required_argument, NULL, 'n'},
+        {"cpu-scale", required_argument, NULL, 'c'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+    long seed = 1;
+    unsigned passes = 1000;
+    double cpu_scale = 40;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "s:n:c:h", options, NULL)) != -1) {
+        switch (c) {
+            case 's': seed = atol(optarg); break;
+            case 'n': passes = atoi(optarg); break;
+            case 'c': cpu_scale = atof(optarg); break;
+            case 'h':
+                gd_bench_usage(argv[0]);
+                return 0;
+            default:
+                gd_bench_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (passes == 0 || cpu_scale <= 0) {
+        fprintf(stderr, "invalid parameters\n");
+        return 1;
+    }
+    srand48(seed);
+    gd_bench_run(passes, cpu_scale);
+    return 0;
+}
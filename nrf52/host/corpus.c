@@ -0,0 +1,76 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Advertising payloads of other devices (see corpus.h)
+ *
+ * The templates follow the published formats (Apple iBeacon, Google
+ * Eddystone and Fast Pair, Microsoft Swift Pair) and the payloads seen from
+ * phones. Identifiers and counters are randomized.
+ */
+
+#include <corpus.h>
+
+#include <string.h>
+
+typedef struct {
+    const char *name;
+    uint8_t len;
+    uint8_t data[31];
+    uint8_t random_from; /* octets from here on are randomized ... */
+    uint8_t random_to;   /* ... up to here (exclusive) */
+} gd_corpus_template_t;
+
+static const gd_corpus_template_t gd_corpus_templates[GD_CORPUS_COUNT] = {
+    [GD_CORPUS_IBEACON] = {
+        "ibeacon", 30,
+        {0x02, 0x01, 0x06, 0x1a, 0xff, 0x4c, 0x00, 0x02, 0x15},
+        9, 30},
+    [GD_CORPUS_EDDYSTONE_UID] = {
+        "eddystone_uid", 31,
+        {0x02, 0x01, 0x06, 0x03, 0x03, 0xaa, 0xfe, 0x17, 0x16, 0xaa, 0xfe, 0x00, 0xee},
+        13, 29},
+    [GD_CORPUS_EDDYSTONE_URL] = {
+        "eddystone_url", 25,
+        {0x02, 0x01, 0x06, 0x03, 0x03, 0xaa, 0xfe, 0x11, 0x16, 0xaa, 0xfe, 0x10, 0xee,
+         0x03, 'e', 'x', 'a', 'm', 'p', 'l', 'e', '/', 'g', 'd', 0x07},
+        25, 25},
+    [GD_CORPUS_APPLE_NEARBY] = {
+        "apple_nearby", 14,
+        {0x02, 0x01, 0x1a, 0x0a, 0xff, 0x4c, 0x00, 0x10, 0x05, 0x03, 0x1c},
+        11, 14},
+    [GD_CORPUS_SWIFT_PAIR] = {
+        "swift_pair", 31,
+        {0x1e, 0xff, 0x06, 0x00, 0x01, 0x09, 0x20, 0x02},
+        8, 31},
+    [GD_CORPUS_FAST_PAIR] = {
+        "fast_pair", 21,
+        {0x02, 0x01, 0x06, 0x03, 0x03, 0x2c, 0xfe, 0x06, 0x16, 0x2c, 0xfe, 0x00, 0x00, 0x00,
+         0x02, 0x0a, 0xf4, 0x03, 0x09, 'P', 'h'},
+        11, 14},
+    [GD_CORPUS_NAME] = {
+        "name", 21,
+        {0x02, 0x01, 0x06, 0x0d, 0x09, 'G', 'a', 'l', 'a', 'x', 'y', ' ', 'W', 'a', 't',
+         'c', 'h', 0x03, 0x19, 0xc2, 0x00},
+        21, 21},
+    [GD_CORPUS_MALFORMED] = {
+        "malformed", 12,
+        {0x02, 0x01, 0x06, 0x1a, 0xff, 0x4c, 0x00, 0x02, 0x15},
+        9, 12},
+};
+
+size_t gd_corpus_packet(gd_corpus_kind_t kind, uint8_t *buf, gd_corpus_rand_t rnd) {
+    const gd_corpus_template_t *t = &gd_corpus_templates[kind];
+    memcpy(buf, t->data, t->len);
+    for (unsigned i = t->random_from; i < t->random_to; i++) {
+        buf[i] = rnd(256);
+    }
+    return t->len;
+}
+
+const char *gd_corpus_name(gd_corpus_kind_t kind) {
+    return gd_corpus_templates[kind].name;
+}
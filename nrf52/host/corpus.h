@@ -0,0 +1,40 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Advertising payloads of other devices (beacons and phones) for the
+ * simulation and the parser benchmark
+ */
+
+#ifndef __CORPUS_H__
+#define __CORPUS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    GD_CORPUS_IBEACON,
+    GD_CORPUS_EDDYSTONE_UID,
+    GD_CORPUS_EDDYSTONE_URL,
+    GD_CORPUS_APPLE_NEARBY,   /* iPhone Continuity message */
+    GD_CORPUS_SWIFT_PAIR,     /* Microsoft Swift Pair */
+    GD_CORPUS_FAST_PAIR,      /* Google Fast Pair (Android) */
+    GD_CORPUS_NAME,           /* flags and complete local name */
+    GD_CORPUS_MALFORMED,      /* length field exceeds the report */
+    GD_CORPUS_COUNT,
+} gd_corpus_kind_t;
+
+/* random source: uniform in [0, n) */
+typedef uint32_t (*gd_corpus_rand_t)(uint32_t n);
+
+/** Generate a payload of the given kind with random variable fields.
+ * buf must hold 31 octets. Returns the length.
+ */
+size_t gd_corpus_packet(gd_corpus_kind_t kind, uint8_t *buf, gd_corpus_rand_t rnd);
+
+const char *gd_corpus_name(gd_corpus_kind_t kind);
+
+#endif
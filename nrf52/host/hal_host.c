@@ -0,0 +1,496 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Hardware abstraction layer for a Linux host (see hal_host.h)
+ */
+
+#include <hal_host.h>
+
+#include <app_error.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GD_HOST_GPIO_PINS 64
+
+typedef struct {
+    uint64_t time_us;
+    uint64_t seq; /* events of the same time in the order of posting */
+    gd_host_evt_type_t type;
+    gd_host_evt_handler_t handler;
+    void *context;
+} gd_host_evt_t;
+
+typedef struct {
+    gd_hal_timer_handler_t handler;
+    bool repeated;
+    bool running;
+    uint64_t expiry_us;
+    uint32_t period_us;
+    void *context;
+} gd_host_timer_t;
+
+typedef struct {
+    uint64_t time_us;
+    uint8_t addr[GD_HAL_ADDR_LEN];
+    uint8_t len;
+    int8_t rssi;
+    uint8_t data[31];
+} gd_host_packet_t;
+
+static gd_host_config_t gd_host_config;
+static gd_host_stats_t gd_host_stats;
+
+/* simulated time */
+static uint64_t gd_host_now_ns;
+static uint64_t gd_host_cpu_ns;      /* CPU time at the last update */
+static uint64_t gd_host_cpu_overhead; /* CPU time of reading the CPU time */
+static unsigned gd_host_stopped;
+
+/* pending events (binary heap) */
+static gd_host_evt_t *gd_host_evts;
+static size_t gd_host_evt_count;
+static size_t gd_host_evt_size;
+static uint64_t gd_host_evt_seq;
+
+static gd_host_timer_t gd_host_timers[GD_HAL_TIMER_COUNT];
+static unsigned gd_host_timer_count;
+
+static unsigned gd_host_nesting;
+static bool gd_host_in_isr;
+
+static gd_hal_radio_handler_t gd_host_radio_handler;
+static bool gd_host_scanning;
+static uint64_t gd_host_scan_start_us;
+
+static bool gd_host_gpio[GD_HOST_GPIO_PINS];
+static gd_host_gpio_handler_t gd_host_gpio_handler;
+static bool gd_host_gpio_in[GD_HOST_GPIO_PINS];
+static gd_hal_gpio_handler_t gd_host_gpio_in_handler[GD_HOST_GPIO_PINS];
+
+static uint64_t gd_host_cpu_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void gd_host_clock_update(void) {
+    uint64_t cpu = gd_host_cpu_time();
+    uint64_t elapsed = cpu - gd_host_cpu_ns;
+    elapsed = elapsed > gd_host_cpu_overhead ? elapsed - gd_host_cpu_overhead : 0;
+    if (gd_host_stopped == 0) {
+        gd_host_now_ns += (uint64_t)(elapsed * gd_host_config.cpu_scale);
+    }
+    gd_host_cpu_ns = cpu;
+}
+
+void gd_host_init(const gd_host_config_t *config) {
+    gd_host_config = *config;
+    memset(&gd_host_stats, 0, sizeof(gd_host_stats));
+    /* the simulated time should not include the measurement itself */
+    uint64_t start = gd_host_cpu_time();
+    for (unsigned i = 0; i < 1000; i++) {
+        (void)gd_host_cpu_time();
+    }
+    gd_host_cpu_overhead = (gd_host_cpu_time() - start) / 1001;
+    gd_host_now_ns = 0;
+    gd_host_cpu_ns = gd_host_cpu_time();
+}
+
+uint64_t gd_host_now_us(void) {
+    gd_host_clock_update();
+    return gd_host_now_ns / 1000;
+}
+
+void gd_host_clock_stop(void) {
+    gd_host_clock_update();
+    gd_host_stopped++;
+}
+
+void gd_host_clock_start(void) {
+    gd_host_clock_update();
+    gd_host_stopped--;
+}
+
+void gd_host_cpu_halt(uint32_t duration_us) {
+    gd_host_clock_update();
+    gd_host_now_ns += (uint64_t)duration_us * 1000;
+}
+
+static bool gd_host_evt_before(const gd_host_evt_t *a, const gd_host_evt_t *b) {
+    return a->time_us < b->time_us || (a->time_us == b->time_us && a->seq < b->seq);
+}
+
+static void gd_host_evt_swap(size_t i, size_t j) {
+    gd_host_evt_t t = gd_host_evts[i];
+    gd_host_evts[i] = gd_host_evts[j];
+    gd_host_evts[j] = t;
+}
+
+void gd_host_post(uint64_t time_us, gd_host_evt_type_t type,
+                  gd_host_evt_handler_t handler, void *context) {
+    if (gd_host_evt_count == gd_host_evt_size) {
+        gd_host_evt_size = gd_host_evt_size ? 2 * gd_host_evt_size : 64;
+        gd_host_evts = realloc(gd_host_evts, gd_host_evt_size * sizeof(gd_host_evt_t));
+        APP_ERROR_CHECK_BOOL(gd_host_evts != NULL);
+    }
+    size_t i = gd_host_evt_count++;
+    gd_host_evts[i] = (gd_host_evt_t){
+        .time_us = time_us,
+        .seq = gd_host_evt_seq++,
+        .type = type,
+        .handler = handler,
+        .context = context};
+    while (i > 0 && gd_host_evt_before(&gd_host_evts[i], &gd_host_evts[(i - 1) / 2])) {
+        gd_host_evt_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static gd_host_evt_t gd_host_evt_pop(void) {
+    gd_host_evt_t e = gd_host_evts[0];
+    gd_host_evts[0] = gd_host_evts[--gd_host_evt_count];
+    size_t i = 0;
+    for (;;) {
+        size_t m = i;
+        for (size_t c = 2 * i + 1; c <= 2 * i + 2 && c < gd_host_evt_count; c++) {
+            if (gd_host_evt_before(&gd_host_evts[c], &gd_host_evts[m])) {
+                m = c;
+            }
+        }
+        if (m == i) {
+            break;
+        }
+        gd_host_evt_swap(i, m);
+        i = m;
+    }
+    return e;
+}
+
+/* time of the next event or timer expiry; returns false if there is none */
+static bool gd_host_next(uint64_t *time_us, gd_host_timer_t **timer) {
+    bool found = false;
+    *timer = NULL;
+    if (gd_host_evt_count > 0) {
+        *time_us = gd_host_evts[0].time_us;
+        found = true;
+    }
+    for (unsigned i = 0; i < gd_host_timer_count; i++) {
+        gd_host_timer_t *t = &gd_host_timers[i];
+        if (t->running && (!found || t->expiry_us < *time_us)) {
+            *time_us = t->expiry_us;
+            *timer = t;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/* deliver all due events */
+static void gd_host_dispatch(void) {
+    uint64_t time_us;
+    gd_host_timer_t *timer;
+    if (gd_host_in_isr || gd_host_nesting > 0) {
+        return;
+    }
+    while (gd_host_next(&time_us, &timer) && time_us <= gd_host_now_us()) {
+        uint64_t start = gd_host_now_us();
+        bool irq = true;
+        gd_host_in_isr = true;
+        if (timer != NULL) {
+            if (timer->repeated) {
+                timer->expiry_us += timer->period_us;
+            } else {
+                timer->running = false;
+            }
+            timer->handler(timer->context);
+        } else {
+            gd_host_evt_t e = gd_host_evt_pop();
+            if (e.type == GD_HOST_EVT_SIM) {
+                irq = false;
+                gd_host_clock_stop();
+                e.handler(e.context);
+                gd_host_clock_start();
+            } else {
+                e.handler(e.context);
+            }
+        }
+        gd_host_in_isr = false;
+        if (irq) {
+            gd_host_stats.interrupts++;
+            gd_host_stats.isr_us += gd_host_now_us() - start;
+        }
+    }
+}
+
+uint32_t gd_hal_counter(void) {
+    return (uint32_t)(gd_host_now_us() * GD_HAL_COUNTER_FREQ / 1000000) & GD_HAL_COUNTER_MASK;
+}
+
+uint32_t gd_hal_critical_enter(void) {
+    gd_host_nesting++;
+    return 0;
+}
+
+void gd_hal_critical_exit(uint32_t state) {
+    if (--gd_host_nesting == 0) {
+        gd_host_dispatch();
+    }
+}
+
+void gd_hal_timer_create(gd_hal_timer_t *timer, bool repeated,
+                         gd_hal_timer_handler_t handler) {
+    APP_ERROR_CHECK_BOOL(gd_host_timer_count < GD_HAL_TIMER_COUNT);
+    *timer = gd_host_timer_count++;
+    gd_host_timers[*timer] = (gd_host_timer_t){.handler = handler, .repeated = repeated};
+}
+
+void gd_hal_timer_start(gd_hal_timer_t timer, uint32_t ms, void *context) {
+    gd_host_timer_t *t = &gd_host_timers[timer];
+    APP_ERROR_CHECK_BOOL(timer < gd_host_timer_count && ms > 0);
+    if (t->running) {
+        return;
+    }
+    t->period_us = ms * 1000;
+    t->expiry_us = gd_host_now_us() + t->period_us;
+    t->context = context;
+    t->running = true;
+}
+
+void gd_hal_timer_stop(gd_hal_timer_t timer) {
+    gd_host_timers[timer].running = false;
+}
+
+void gd_hal_gpio_output(uint32_t pin, bool level) {
+    gd_hal_gpio_write(pin, level);
+}
+
+void gd_hal_gpio_output_high_drive(uint32_t pin, bool level) {
+    gd_hal_gpio_write(pin, level);
+}
+
+void gd_hal_gpio_write(uint32_t pin, bool level) {
+    APP_ERROR_CHECK_BOOL(pin < GD_HOST_GPIO_PINS);
+    if (gd_host_gpio[pin] != level) {
+        gd_host_gpio[pin] = level;
+        if (gd_host_gpio_handler != NULL) {
+            gd_host_clock_stop();
+            gd_host_gpio_handler(pin, level);
+            gd_host_clock_start();
+        }
+    }
+}
+
+bool gd_hal_gpio_get_output(uint32_t pin) {
+    return gd_host_gpio[pin];
+}
+
+void gd_host_set_gpio_handler(gd_host_gpio_handler_t handler) {
+    gd_host_gpio_handler = handler;
+}
+
+void gd_hal_gpio_input(uint32_t pin, gd_hal_pull_t pull, gd_hal_gpio_handler_t handler) {
+    APP_ERROR_CHECK_BOOL(pin < GD_HOST_GPIO_PINS);
+    gd_host_gpio_in[pin] = pull == GD_HAL_PULL_UP;
+    gd_host_gpio_in_handler[pin] = handler;
+}
+
+bool gd_hal_gpio_read(uint32_t pin) {
+    return gd_host_gpio_in[pin];
+}
+
+static void gd_host_gpio_edge(void *context) {
+    uint32_t pin = (uintptr_t)context;
+    if (gd_host_gpio_in_handler[pin] != NULL) {
+        gd_host_gpio_in_handler[pin](pin);
+    }
+}
+
+void gd_host_gpio_input(uint32_t pin, bool level) {
+    APP_ERROR_CHECK_BOOL(pin < GD_HOST_GPIO_PINS);
+    if (gd_host_gpio_in[pin] != level) {
+        gd_host_gpio_in[pin] = level;
+        gd_host_post(gd_host_now_us(), GD_HOST_EVT_IRQ, gd_host_gpio_edge,
+                     (void *)(uintptr_t)pin);
+    }
+}
+
+void gd_hal_sleep(void) {
+    uint64_t time_us;
+    gd_host_timer_t *timer;
+    APP_ERROR_CHECK_BOOL(gd_host_next(&time_us, &timer));
+    gd_host_clock_update();
+    if (time_us * 1000 > gd_host_now_ns) {
+        gd_host_now_ns = time_us * 1000;
+    }
+    gd_host_dispatch();
+}
+
+void gd_hal_radio_init(gd_hal_radio_handler_t handler) {
+    gd_host_radio_handler = handler;
+}
+
+void gd_hal_scan_start(void) {
+    gd_host_scanning = true;
+    gd_host_scan_start_us = gd_host_now_us();
+}
+
+void gd_hal_scan_stop(void) {
+    gd_host_scanning = false;
+}
+
+static void gd_host_radio_receive(void *context) {
+    gd_host_packet_t *p = context;
+    gd_host_radio_handler(p->addr, p->data, p->len, p->rssi);
+    free(p);
+}
+
+/* the scanner state is evaluated when the packet is sent (the event may be
+ * delivered later if interrupts are disabled) */
+static void gd_host_radio_packet(void *context) {
+    gd_host_packet_t *p = context;
+    gd_host_stats.packets++;
+    if (!gd_host_scanning || gd_host_radio_handler == NULL ||
+        p->time_us < gd_host_scan_start_us) {
+        gd_host_stats.missed_stopped++;
+    } else if ((p->time_us - gd_host_scan_start_us) % gd_host_config.scan_interval_us >=
+               gd_host_config.scan_window_us) {
+        gd_host_stats.missed_window++;
+    } else {
+        gd_host_stats.reports++;
+        gd_host_post(p->time_us, GD_HOST_EVT_IRQ, gd_host_radio_receive, p);
+        return;
+    }
+    free(p);
+}
+
+void gd_host_radio_send(uint64_t time_us, const uint8_t *addr, const uint8_t *data, size_t len,
+                        int8_t rssi) {
+    gd_host_packet_t *p = malloc(sizeof(gd_host_packet_t));
+    APP_ERROR_CHECK_BOOL(p != NULL && len <= sizeof(p->data));
+    p->time_us = time_us;
+    memcpy(p->addr, addr, sizeof(p->addr));
+    p->len = len;
+    p->rssi = rssi;
+    memcpy(p->data, data, len);
+    gd_host_post(time_us, GD_HOST_EVT_SIM, gd_host_radio_packet, p);
+}
+
+uint64_t gd_host_radio_idle(uint64_t time_us, uint32_t duration_us) {
+    uint32_t interval = gd_host_config.scan_interval_us;
+    uint32_t window = gd_host_config.scan_window_us;
+    if (!gd_host_scanning || time_us < gd_host_scan_start_us) {
+        return time_us;
+    }
+    uint64_t phase = (time_us - gd_host_scan_start_us) % interval;
+    if (phase >= window && interval - phase >= duration_us) {
+        return time_us;
+    }
+    if (interval - window < duration_us) {
+        /* the SoftDevice preempts the scanner eventually */
+        return time_us + interval;
+    }
+    return time_us - phase + (phase < window ? window : interval + window);
+}
+
+void gd_host_get_stats(gd_host_stats_t *stats) {
+    *stats = gd_host_stats;
+}
+
+void gd_host_set_log_level(gd_host_log_level_t level) {
+    gd_host_config.log_level = level;
+}
+
+static const char *const gd_host_log_names[] = {"error", "warning", "info", "debug"};
+
+/* UART output of a log entry for both firmware log backends, independent of
+ * the log level of the host (the firmware logs at debug level).
+ *
+ * Text: "<info> app: " prefix and CR LF (no time stamps or colors, see
+ * sdk_config.h); hexdumps in lines of 8 bytes " xx" followed by '|' and the
+ * characters. Binary: the frames of logbin.h plus COBS overhead and delimiter
+ * (2 bytes for frames shorter than 254 bytes). String arguments are sent by
+ * address as they are located in flash on the target.
+ */
+#define GD_HOST_LOG_PREFIX(level) (strlen(gd_host_log_names[level]) + 8)
+#define GD_HOST_LOG_HEXDUMP_LINE  8
+#define GD_HOST_LOG_HEXDUMP_CHUNK 64
+#define GD_HOST_LOG_COBS          2
+
+static unsigned gd_host_log_nargs(const char *fmt) {
+    unsigned nargs = 0;
+    while ((fmt = strchr(fmt, '%')) != NULL) {
+        fmt++;
+        if (*fmt == '%') {
+            fmt++;
+        } else if (*fmt != '\0') {
+            nargs++;
+        }
+    }
+    return nargs;
+}
+
+static void gd_host_log_count(gd_host_log_level_t level, const char *fmt, va_list ap) {
+    gd_host_stats.log_entries++;
+    gd_host_stats.log_text_bytes +=
+        GD_HOST_LOG_PREFIX(level) + vsnprintf(NULL, 0, fmt, ap) + 2;
+    gd_host_stats.log_bin_bytes += 5 + 4 * gd_host_log_nargs(fmt) + GD_HOST_LOG_COBS;
+}
+
+static void gd_host_log_count_hexdump(gd_host_log_level_t level, size_t len) {
+    gd_host_stats.log_entries++;
+    for (size_t i = 0; i < len; i += GD_HOST_LOG_HEXDUMP_LINE) {
+        size_t n = len - i < GD_HOST_LOG_HEXDUMP_LINE ? len - i : GD_HOST_LOG_HEXDUMP_LINE;
+        gd_host_stats.log_text_bytes +=
+            GD_HOST_LOG_PREFIX(level) + 3 * GD_HOST_LOG_HEXDUMP_LINE + 1 + n + 2;
+    }
+    for (size_t i = 0; i < len; i += GD_HOST_LOG_HEXDUMP_CHUNK) {
+        size_t n = len - i < GD_HOST_LOG_HEXDUMP_CHUNK ? len - i : GD_HOST_LOG_HEXDUMP_CHUNK;
+        gd_host_stats.log_bin_bytes += 3 + n + GD_HOST_LOG_COBS;
+    }
+}
+
+void gd_host_log(gd_host_log_level_t level, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    gd_host_log_count(level, fmt, ap);
+    va_end(ap);
+    if (level > gd_host_config.log_level) {
+        return;
+    }
+    gd_host_clock_stop();
+    printf("[%10.6f] <%s> ", gd_host_now_ns / 1e9, gd_host_log_names[level]);
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("\n");
+    gd_host_clock_start();
+}
+
+void gd_host_log_hexdump(gd_host_log_level_t level, const void *data, size_t len) {
+    const uint8_t *p = data;
+    gd_host_log_count_hexdump(level, len);
+    if (level > gd_host_config.log_level) {
+        return;
+    }
+    gd_host_clock_stop();
+    printf("[%10.6f] <%s> ", gd_host_now_ns / 1e9, gd_host_log_names[level]);
+    for (size_t i = 0; i < len; i++) {
+        printf(" %02x", p[i]);
+    }
+    printf("\n");
+    gd_host_clock_start();
+}
+
+void app_error_handler(ret_code_t error_code, uint32_t line_num, const uint8_t *p_file_name) {
+    fprintf(stderr, "[%10.6f] fatal error %u at %s:%u\n",
+            gd_host_now_ns / 1e9, error_code, (const char *)p_file_name, line_num);
+    exit(2);
+}
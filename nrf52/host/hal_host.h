@@ -0,0 +1,111 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Hardware abstraction layer for a Linux host (simulation)
+ *
+ * Time is simulated. While code runs, the simulated time advances with the
+ * CPU time of the host thread multiplied by cpu_scale (the speed ratio of the
+ * host to the nRF52). gd_hal_sleep() advances it to the next event. Events
+ * are delivered like interrupts: at the end of the outermost critical region
+ * and while sleeping, never nested.
+ */
+
+#ifndef __HAL_HOST_H__
+#define __HAL_HOST_H__
+
+#include <hal.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    GD_HOST_LOG_ERROR,
+    GD_HOST_LOG_WARNING,
+    GD_HOST_LOG_INFO,
+    GD_HOST_LOG_DEBUG,
+} gd_host_log_level_t;
+
+typedef enum {
+    GD_HOST_EVT_IRQ, /* firmware interrupt: its CPU time is simulated time */
+    GD_HOST_EVT_SIM, /* simulation (traffic generator): takes no time */
+} gd_host_evt_type_t;
+
+typedef struct {
+    double cpu_scale;          /* simulated time per host CPU time */
+    uint32_t scan_interval_us; /* see scan_params in hal_nrf52.c */
+    uint32_t scan_window_us;
+    gd_host_log_level_t log_level;
+} gd_host_config_t;
+
+typedef struct {
+    uint32_t packets;        /* advertising packets sent */
+    uint32_t reports;        /* packets received (reported to the handler) */
+    uint32_t missed_window;  /* packets sent between scan windows */
+    uint32_t missed_stopped; /* packets sent while the scanner was stopped */
+    uint32_t interrupts;
+    uint64_t isr_us;         /* time spent in interrupt handlers */
+    uint32_t log_entries;    /* log calls of all levels */
+    uint32_t log_text_bytes; /* UART bytes of the text backend */
+    uint32_t log_bin_bytes;  /* UART bytes of the binary backend (logbin.c) */
+} gd_host_stats_t;
+
+typedef void (*gd_host_evt_handler_t)(void *context);
+
+/* called for each change of an output pin */
+typedef void (*gd_host_gpio_handler_t)(uint32_t pin, bool level);
+
+void gd_host_init(const gd_host_config_t *config);
+
+/** Get the simulated time in microseconds
+ */
+uint64_t gd_host_now_us(void);
+
+/** Stop and restart the simulated time while simulation code runs in
+ * firmware context (nestable)
+ */
+void gd_host_clock_stop(void);
+void gd_host_clock_start(void);
+
+/** Advance the simulated time while the CPU is halted (e.g. by a flash
+ * erase); events due in the meantime are delivered afterwards
+ */
+void gd_host_cpu_halt(uint32_t duration_us);
+
+/** Schedule an event (the handler is called in interrupt context)
+ */
+void gd_host_post(uint64_t time_us, gd_host_evt_type_t type,
+                  gd_host_evt_handler_t handler, void *context);
+
+/** Send an advertising packet of the advertiser addr (GD_HAL_ADDR_LEN bytes)
+ * at the given time. It is reported if the scanner is running and the time is
+ * within a scan window.
+ */
+void gd_host_radio_send(uint64_t time_us, const uint8_t *addr, const uint8_t *data, size_t len,
+                        int8_t rssi);
+
+/** Get the earliest time from time_us on at which the radio is idle for
+ * duration_us (flash operations of the SoftDevice need radio idle time)
+ */
+uint64_t gd_host_radio_idle(uint64_t time_us, uint32_t duration_us);
+
+void gd_host_set_gpio_handler(gd_host_gpio_handler_t handler);
+
+/** Drive an input pin (see gd_hal_gpio_input()). A change of the level
+ * raises the edge interrupt.
+ */
+void gd_host_gpio_input(uint32_t pin, bool level);
+
+void gd_host_get_stats(gd_host_stats_t *stats);
+
+void gd_host_set_log_level(gd_host_log_level_t level);
+
+void gd_host_log(gd_host_log_level_t level, const char *fmt, ...);
+
+void gd_host_log_hexdump(gd_host_log_level_t level, const void *data, size_t len);
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Host build: subset of the nRF5 SDK app_error.h (errors abort the simulation)
+ */
+
+#ifndef APP_ERROR_H__
+#define APP_ERROR_H__
+
+#include <sdk_errors.h>
+
+#include <stdint.h>
+
+void app_error_handler(ret_code_t error_code, uint32_t line_num, const uint8_t *p_file_name);
+
+#define APP_ERROR_CHECK(ERR_CODE)                                                   \
+    do {                                                                            \
+        const uint32_t LOCAL_ERR_CODE = (ERR_CODE);                                 \
+        if (LOCAL_ERR_CODE != NRF_SUCCESS) {                                        \
+            app_error_handler(LOCAL_ERR_CODE, __LINE__, (const uint8_t *)__FILE__); \
+        }                                                                           \
+    } while (0)
+
+#define APP_ERROR_CHECK_BOOL(BOOLEAN_VALUE)                                \
+    do {                                                                   \
+        if (!(BOOLEAN_VALUE)) {                                            \
+            app_error_handler(0, __LINE__, (const uint8_t *)__FILE__);     \
+        }                                                                  \
+    } while (0)
+
+#endif
@@ -0,0 +1,22 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Host build: subset of the nRF5 SDK app_util.h
+ */
+
+#ifndef APP_UTIL_H__
+#define APP_UTIL_H__
+
+#define STATIC_ASSERT(EXPR) _Static_assert((EXPR), #EXPR)
+
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+#define CEIL_DIV(A, B) (((A) + (B) - 1) / (B))
+
+#define ROUNDED_DIV(A, B) (((A) + ((B) / 2)) / (B))
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Host build: subset of the nRF5 SDK ble_types.h
+ */
+
+#ifndef BLE_H__
+#define BLE_H__
+
+#include <stdint.h>
+
+typedef struct {
+    uint8_t uuid128[16];
+} ble_uuid128_t;
+
+#endif
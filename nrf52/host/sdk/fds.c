@@ -0,0 +1,445 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Host build: Flash Data Storage kept in RAM
+ *
+ * Operations are queued like in FDS and completed in order in interrupt
+ * context. Their duration is modelled after the nRF52832 (word write time,
+ * sliced page erase, see flash.h) and each one needs radio idle time between
+ * scan windows, like a SoftDevice flash operation.
+ *
+ * The CPU is halted during each partial erase. This is modelled by advancing
+ * the simulated time at the start of the slice, so the erase statistics of
+ * flash.h (including the actuation latency) are available on the host.
+ */
+
+#include <fds.h>
+#include <flash.h>
+#include <hal_host.h>
+
+#include <app_error.h>
+#include <app_util.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/* size of the record header in words */
+#define FDS_HEADER_WORDS   3
+#define FDS_PAGE_TAG_WORDS 2
+
+#define FDS_WORD_WRITE_US  41
+#define FDS_OP_OVERHEAD_US 100
+
+#define FDS_PAGE_WORDS (FDS_VIRTUAL_PAGE_SIZE - FDS_PAGE_TAG_WORDS)
+#define FDS_CAPACITY_WORDS \
+    ((FDS_VIRTUAL_PAGES - FDS_VIRTUAL_PAGES_RESERVED - 1) * FDS_PAGE_WORDS)
+
+typedef enum {
+    FDS_REC_VALID,
+    FDS_REC_DIRTY,  /* deleted, freed by garbage collection */
+    FDS_REC_ERASED,
+} fds_rec_state_t;
+
+typedef struct {
+    fds_header_t header;
+    uint32_t *data;
+    fds_rec_state_t state;
+} fds_rec_t;
+
+typedef struct {
+    fds_evt_id_t id;
+    uint32_t record_id; /* record to be written (WRITE, UPDATE) */
+    uint32_t old_id;    /* record to be deleted (UPDATE, DEL_RECORD) */
+    fds_record_t record;
+    uint32_t words;     /* reserved words */
+} fds_op_t;
+
+static fds_cb_t fds_users[FDS_MAX_USERS];
+static unsigned fds_user_count;
+static bool fds_initialized;
+
+/* records in the order of writing; erased ones keep their slot so that the
+ * find tokens remain valid */
+static fds_rec_t *fds_recs;
+static size_t fds_rec_count;
+static size_t fds_rec_size;
+static uint32_t fds_last_id;
+
+static unsigned fds_open_records;
+static unsigned fds_queued;
+static uint32_t fds_words_reserved;
+static uint64_t fds_busy_until_us;
+static uint32_t fds_fail_writes;
+
+static gds_flash_stats_t fds_flash_stats;
+
+static void fds_send_evt(const fds_evt_t *evt) {
+    for (unsigned i = 0; i < fds_user_count; i++) {
+        fds_users[i](evt);
+    }
+}
+
+static fds_rec_t *fds_rec_find_id(uint32_t record_id) {
+    for (size_t i = 0; i < fds_rec_count; i++) {
+        if (fds_recs[i].state == FDS_REC_VALID && fds_recs[i].header.record_id == record_id) {
+            return &fds_recs[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t fds_words_used(uint32_t *dirty) {
+    uint32_t used = 0;
+    *dirty = 0;
+    for (size_t i = 0; i < fds_rec_count; i++) {
+        fds_rec_t *r = &fds_recs[i];
+        uint32_t words = FDS_HEADER_WORDS + r->header.length_words;
+        if (r->state != FDS_REC_ERASED) {
+            used += words;
+        }
+        if (r->state == FDS_REC_DIRTY) {
+            *dirty += words;
+        }
+    }
+    return used;
+}
+
+static unsigned fds_hist_bin(uint32_t us) {
+    uint32_t ms = us / 1000;
+    unsigned bin = 0;
+    while (bin < GDS_STALL_HIST_BINS - 1 && ms >= (1UL << bin)) {
+        bin++;
+    }
+    return bin;
+}
+
+/* partial erase, the context is 1 for the last slice of a page */
+static void fds_erase_slice(void *context) {
+    const uint32_t us = GDS_ERASE_SLICE_MS * 1000;
+    fds_flash_stats.slices++;
+    if ((uintptr_t)context != 0) {
+        fds_flash_stats.pages++;
+    }
+    fds_flash_stats.erase_us += us;
+    fds_flash_stats.stall_hist[fds_hist_bin(us)]++;
+    if (us > fds_flash_stats.stall_max_us) {
+        fds_flash_stats.stall_max_us = us;
+    }
+    gd_host_cpu_halt(us);
+}
+
+/* Get the completion time of an operation. Each step needs radio idle time;
+ * steps are queued after the operations in progress. */
+static uint64_t fds_schedule(uint32_t write_words, uint32_t erase_pages) {
+    uint64_t t = gd_host_now_us();
+    if (t < fds_busy_until_us) {
+        t = fds_busy_until_us;
+    }
+    uint32_t duration = FDS_OP_OVERHEAD_US + write_words * FDS_WORD_WRITE_US;
+    t = gd_host_radio_idle(t, duration) + duration;
+    fds_flash_stats.words_written += write_words;
+    const uint32_t slices = CEIL_DIV(GDS_ERASE_TIME_MS, GDS_ERASE_SLICE_MS);
+    for (uint32_t i = 0; i < erase_pages * slices; i++) {
+        duration = GDS_ERASE_SLICE_MS * 1000;
+        t = gd_host_radio_idle(t, duration);
+        gd_host_post(t, GD_HOST_EVT_SIM, fds_erase_slice,
+                     (void *)(uintptr_t)((i + 1) % slices == 0));
+        t += duration;
+    }
+    fds_busy_until_us = t;
+    return t;
+}
+
+static void fds_op_complete(void *context) {
+    fds_op_t *op = context;
+    fds_evt_t evt = {.id = op->id, .result = NRF_SUCCESS};
+    fds_rec_t *old;
+
+    fds_queued--;
+    fds_words_reserved -= op->words;
+    switch (op->id) {
+        case FDS_EVT_WRITE:
+        case FDS_EVT_UPDATE:
+            evt.write.file_id = op->record.file_id;
+            evt.write.record_key = op->record.key;
+            if (fds_fail_writes > 0) {
+                fds_fail_writes--;
+                evt.result = FDS_ERR_OPERATION_TIMEOUT;
+                break;
+            }
+            if (fds_rec_count == fds_rec_size) {
+                fds_rec_size = fds_rec_size ? 2 * fds_rec_size : 64;
+                fds_recs = realloc(fds_recs, fds_rec_size * sizeof(fds_rec_t));
+                APP_ERROR_CHECK_BOOL(fds_recs != NULL);
+            }
+            fds_rec_t *r = &fds_recs[fds_rec_count++];
+            size_t size = op->record.data.length_words * sizeof(uint32_t);
+            r->header = (fds_header_t){
+                .record_key = op->record.key,
+                .length_words = op->record.data.length_words,
+                .file_id = op->record.file_id,
+                .record_id = op->record_id};
+            r->data = malloc(size);
+            APP_ERROR_CHECK_BOOL(r->data != NULL);
+            memcpy(r->data, op->record.data.p_data, size);
+            r->state = FDS_REC_VALID;
+            old = fds_rec_find_id(op->old_id);
+            if (old != NULL) {
+                old->state = FDS_REC_DIRTY;
+            }
+            evt.write.record_id = op->record_id;
+            evt.write.is_record_updated = op->id == FDS_EVT_UPDATE;
+            break;
+
+        case FDS_EVT_DEL_RECORD:
+            old = fds_rec_find_id(op->old_id);
+            if (old == NULL) {
+                evt.result = FDS_ERR_NOT_FOUND;
+                break;
+            }
+            old->state = FDS_REC_DIRTY;
+            evt.del.record_id = op->old_id;
+            evt.del.file_id = old->header.file_id;
+            evt.del.record_key = old->header.record_key;
+            break;
+
+        case FDS_EVT_DEL_FILE:
+            for (size_t i = 0; i < fds_rec_count; i++) {
+                if (fds_recs[i].state == FDS_REC_VALID &&
+                    fds_recs[i].header.file_id == op->record.file_id) {
+                    fds_recs[i].state = FDS_REC_DIRTY;
+                }
+            }
+            evt.del.file_id = op->record.file_id;
+            break;
+
+        case FDS_EVT_GC:
+            for (size_t i = 0; i < fds_rec_count; i++) {
+                if (fds_recs[i].state == FDS_REC_DIRTY) {
+                    fds_recs[i].state = FDS_REC_ERASED;
+                    free(fds_recs[i].data);
+                    fds_recs[i].data = NULL;
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+    free(op);
+    fds_send_evt(&evt);
+}
+
+/* queue an operation that writes write_words and erases erase_pages */
+static ret_code_t fds_op_queue(fds_op_t *op, uint32_t write_words, uint32_t erase_pages) {
+    uint32_t dirty;
+    if (!fds_initialized) {
+        return FDS_ERR_NOT_INITIALIZED;
+    }
+    if (fds_queued >= FDS_OP_QUEUE_SIZE) {
+        return FDS_ERR_NO_SPACE_IN_QUEUES;
+    }
+    if (op->words > 0 &&
+        fds_words_used(&dirty) + fds_words_reserved + op->words > FDS_CAPACITY_WORDS) {
+        return FDS_ERR_NO_SPACE_IN_FLASH;
+    }
+    fds_op_t *p = malloc(sizeof(fds_op_t));
+    APP_ERROR_CHECK_BOOL(p != NULL);
+    *p = *op;
+    fds_queued++;
+    fds_words_reserved += op->words;
+    gd_host_post(fds_schedule(write_words, erase_pages), GD_HOST_EVT_IRQ, fds_op_complete, p);
+    return NRF_SUCCESS;
+}
+
+ret_code_t fds_register(fds_cb_t cb) {
+    if (fds_user_count >= FDS_MAX_USERS) {
+        return FDS_ERR_USER_LIMIT_REACHED;
+    }
+    fds_users[fds_user_count++] = cb;
+    return NRF_SUCCESS;
+}
+
+/* completed immediately, the flash is empty */
+ret_code_t fds_init(void) {
+    fds_evt_t evt = {.id = FDS_EVT_INIT, .result = NRF_SUCCESS};
+    fds_initialized = true;
+    fds_send_evt(&evt);
+    return NRF_SUCCESS;
+}
+
+static ret_code_t fds_record_queue(fds_evt_id_t id, fds_record_desc_t *p_desc,
+                                   fds_record_t const *p_record) {
+    if (p_record == NULL) {
+        return FDS_ERR_NULL_ARG;
+    }
+    if (p_record->data.length_words > FDS_PAGE_WORDS - FDS_HEADER_WORDS) {
+        return FDS_ERR_RECORD_TOO_LARGE;
+    }
+    fds_op_t op = {
+        .id = id,
+        .record_id = fds_last_id + 1,
+        .old_id = id == FDS_EVT_UPDATE ? p_desc->record_id : 0,
+        .record = *p_record,
+        .words = FDS_HEADER_WORDS + p_record->data.length_words};
+    /* an update deletes the old record (one word) */
+    ret_code_t r = fds_op_queue(&op, op.words + (id == FDS_EVT_UPDATE), 0);
+    if (r == NRF_SUCCESS) {
+        fds_last_id = op.record_id;
+        if (p_desc != NULL) {
+            p_desc->record_id = op.record_id;
+        }
+    }
+    return r;
+}
+
+ret_code_t fds_record_write(fds_record_desc_t *p_desc, fds_record_t const *p_record) {
+    return fds_record_queue(FDS_EVT_WRITE, p_desc, p_record);
+}
+
+ret_code_t fds_record_update(fds_record_desc_t *p_desc, fds_record_t const *p_record) {
+    if (p_desc == NULL) {
+        return FDS_ERR_NULL_ARG;
+    }
+    return fds_record_queue(FDS_EVT_UPDATE, p_desc, p_record);
+}
+
+ret_code_t fds_record_delete(fds_record_desc_t *p_desc) {
+    if (p_desc == NULL) {
+        return FDS_ERR_NULL_ARG;
+    }
+    fds_op_t op = {.id = FDS_EVT_DEL_RECORD, .old_id = p_desc->record_id};
+    return fds_op_queue(&op, 1, 0);
+}
+
+ret_code_t fds_file_delete(uint16_t file_id) {
+    uint32_t words = 0;
+    for (size_t i = 0; i < fds_rec_count; i++) {
+        words += fds_recs[i].state == FDS_REC_VALID && fds_recs[i].header.file_id == file_id;
+    }
+    fds_op_t op = {.id = FDS_EVT_DEL_FILE, .record = {.file_id = file_id}};
+    return fds_op_queue(&op, words, 0);
+}
+
+/* All pages in use are collected: valid records are copied to the swap page
+ * and the pages are erased. */
+ret_code_t fds_gc(void) {
+    uint32_t dirty;
+    uint32_t used = fds_words_used(&dirty);
+    fds_op_t op = {.id = FDS_EVT_GC};
+    return fds_op_queue(&op, used - dirty, CEIL_DIV(used, FDS_PAGE_WORDS));
+}
+
+ret_code_t fds_record_open(fds_record_desc_t *p_desc, fds_flash_record_t *p_flash_record) {
+    if (p_desc == NULL || p_flash_record == NULL) {
+        return FDS_ERR_NULL_ARG;
+    }
+    fds_rec_t *r = fds_rec_find_id(p_desc->record_id);
+    if (r == NULL) {
+        return FDS_ERR_NOT_FOUND;
+    }
+    p_flash_record->p_header = &r->header;
+    p_flash_record->p_data = r->data;
+    fds_open_records++;
+    return NRF_SUCCESS;
+}
+
+ret_code_t fds_record_close(fds_record_desc_t *p_desc) {
+    if (p_desc == NULL) {
+        return FDS_ERR_NULL_ARG;
+    }
+    if (fds_open_records == 0) {
+        return FDS_ERR_NO_OPEN_RECORDS;
+    }
+    fds_open_records--;
+    return NRF_SUCCESS;
+}
+
+static ret_code_t fds_find(bool any_key, uint16_t file_id, uint16_t record_key,
+                           fds_record_desc_t *p_desc, fds_find_token_t *p_token) {
+    if (p_desc == NULL || p_token == NULL) {
+        return FDS_ERR_NULL_ARG;
+    }
+    for (size_t i = p_token->ndx; i < fds_rec_count; i++) {
+        const fds_rec_t *r = &fds_recs[i];
+        if (r->state == FDS_REC_VALID && r->header.file_id == file_id &&
+            (any_key || r->header.record_key == record_key)) {
+            p_desc->record_id = r->header.record_id;
+            p_token->ndx = i + 1;
+            return NRF_SUCCESS;
+        }
+    }
+    p_token->ndx = fds_rec_count;
+    return FDS_ERR_NOT_FOUND;
+}
+
+ret_code_t fds_record_find(uint16_t file_id, uint16_t record_key,
+                           fds_record_desc_t *p_desc, fds_find_token_t *p_token) {
+    return fds_find(false, file_id, record_key, p_desc, p_token);
+}
+
+ret_code_t fds_record_find_in_file(uint16_t file_id, fds_record_desc_t *p_desc,
+                                   fds_find_token_t *p_token) {
+    return fds_find(true, file_id, 0, p_desc, p_token);
+}
+
+ret_code_t fds_record_id_from_desc(fds_record_desc_t const *p_desc, uint32_t *p_record_id) {
+    if (p_desc == NULL || p_record_id == NULL) {
+        return FDS_ERR_NULL_ARG;
+    }
+    *p_record_id = p_desc->record_id;
+    return NRF_SUCCESS;
+}
+
+ret_code_t fds_stat(fds_stat_t *p_stat) {
+    uint32_t dirty;
+    if (p_stat == NULL) {
+        return FDS_ERR_NULL_ARG;
+    }
+    if (!fds_initialized) {
+        return FDS_ERR_NOT_INITIALIZED;
+    }
+    memset(p_stat, 0, sizeof(fds_stat_t));
+    uint32_t used = fds_words_used(&dirty);
+    for (size_t i = 0; i < fds_rec_count; i++) {
+        p_stat->valid_records += fds_recs[i].state == FDS_REC_VALID;
+        p_stat->dirty_records += fds_recs[i].state == FDS_REC_DIRTY;
+    }
+    p_stat->pages_available = FDS_VIRTUAL_PAGES - FDS_VIRTUAL_PAGES_RESERVED;
+    p_stat->open_records = fds_open_records;
+    p_stat->words_reserved = fds_words_reserved;
+    p_stat->words_used = used;
+    p_stat->freeable_words = dirty;
+    used += fds_words_reserved;
+    p_stat->largest_contig = used < FDS_CAPACITY_WORDS
+                                 ? FDS_PAGE_WORDS - used % FDS_PAGE_WORDS
+                                 : 0;
+    return NRF_SUCCESS;
+}
+
+uint32_t gds_flash_erase_count(void) {
+    return fds_flash_stats.slices;
+}
+
+void gds_flash_record_actuation(uint32_t latency_us, uint32_t erase_count) {
+    if (fds_flash_stats.slices == erase_count) {
+        return;
+    }
+    fds_flash_stats.act_count++;
+    fds_flash_stats.act_hist[fds_hist_bin(latency_us)]++;
+    if (latency_us > fds_flash_stats.act_max_us) {
+        fds_flash_stats.act_max_us = latency_us;
+    }
+}
+
+void gds_flash_get_stats(gds_flash_stats_t *stats) {
+    *stats = fds_flash_stats;
+}
+
+void fds_host_fail_writes(uint32_t count) {
+    fds_fail_writes = count;
+}
@@ -0,0 +1,82 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Host build: nRF5 SDK atomic FIFO for a single producer (interrupt
+ * context) and a single consumer (main loop)
+ */
+
+#ifndef NRF_ATFIFO_H__
+#define NRF_ATFIFO_H__
+
+#include <sdk_errors.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint8_t *p_buf;
+    size_t item_size;
+    uint32_t item_cnt;
+    volatile uint32_t head; /* items taken */
+    volatile uint32_t tail; /* items put */
+} nrf_atfifo_t;
+
+typedef struct {
+    uint32_t ndx;
+} nrf_atfifo_item_put_t;
+
+typedef struct {
+    uint32_t ndx;
+} nrf_atfifo_item_get_t;
+
+#define NRF_ATFIFO_DEF(fifo_id, storage_type, item_cnt)         \
+    static storage_type fifo_id##_storage[(item_cnt)];          \
+    static nrf_atfifo_t fifo_id##_inst;                         \
+    static nrf_atfifo_t *const fifo_id = &fifo_id##_inst
+
+#define NRF_ATFIFO_INIT(fifo_id)                                                   \
+    nrf_atfifo_init(fifo_id, fifo_id##_storage, sizeof(fifo_id##_storage),         \
+                    sizeof(fifo_id##_storage[0]))
+
+static inline ret_code_t nrf_atfifo_init(nrf_atfifo_t *p_fifo, void *p_buf, size_t buf_size,
+                                         size_t item_size) {
+    p_fifo->p_buf = p_buf;
+    p_fifo->item_size = item_size;
+    p_fifo->item_cnt = buf_size / item_size;
+    p_fifo->head = 0;
+    p_fifo->tail = 0;
+    return NRF_SUCCESS;
+}
+
+static inline void *nrf_atfifo_item_alloc(nrf_atfifo_t *p_fifo, nrf_atfifo_item_put_t *p_context) {
+    if (p_fifo->tail - p_fifo->head >= p_fifo->item_cnt) {
+        return NULL;
+    }
+    p_context->ndx = p_fifo->tail % p_fifo->item_cnt;
+    return p_fifo->p_buf + p_context->ndx * p_fifo->item_size;
+}
+
+static inline bool nrf_atfifo_item_put(nrf_atfifo_t *p_fifo, nrf_atfifo_item_put_t *p_context) {
+    p_fifo->tail++;
+    return true;
+}
+
+static inline void *nrf_atfifo_item_get(nrf_atfifo_t *p_fifo, nrf_atfifo_item_get_t *p_context) {
+    if (p_fifo->tail == p_fifo->head) {
+        return NULL;
+    }
+    p_context->ndx = p_fifo->head % p_fifo->item_cnt;
+    return p_fifo->p_buf + p_context->ndx * p_fifo->item_size;
+}
+
+static inline bool nrf_atfifo_item_free(nrf_atfifo_t *p_fifo, nrf_atfifo_item_get_t *p_context) {
+    p_fifo->head++;
+    return true;
+}
+
+#endif
@@ -0,0 +1,22 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Host build: subset of the nRF5 SDK nrf_atomic.h
+ */
+
+#ifndef NRF_ATOMIC_H__
+#define NRF_ATOMIC_H__
+
+#include <stdint.h>
+
+typedef volatile uint32_t nrf_atomic_u32_t;
+
+static inline uint32_t nrf_atomic_u32_add(nrf_atomic_u32_t *p_data, uint32_t value) {
+    return __atomic_add_fetch(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+#endif
@@ -0,0 +1,16 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Host build: pin numbering of the nRF5 SDK nrf_gpio.h (see gd_config.h)
+ */
+
+#ifndef NRF_GPIO_H__
+#define NRF_GPIO_H__
+
+#define NRF_GPIO_PIN_MAP(port, pin) (((port) << 5) | ((pin) & 0x1F))
+
+#endif
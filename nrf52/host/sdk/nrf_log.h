@@ -0,0 +1,24 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Host build: nRF5 SDK logger (see gd_host_log())
+ */
+
+#ifndef NRF_LOG_H__
+#define NRF_LOG_H__
+
+#include <hal_host.h>
+
+#define NRF_LOG_ERROR(...)   gd_host_log(GD_HOST_LOG_ERROR, __VA_ARGS__)
+#define NRF_LOG_WARNING(...) gd_host_log(GD_HOST_LOG_WARNING, __VA_ARGS__)
+#define NRF_LOG_INFO(...)    gd_host_log(GD_HOST_LOG_INFO, __VA_ARGS__)
+#define NRF_LOG_DEBUG(...)   gd_host_log(GD_HOST_LOG_DEBUG, __VA_ARGS__)
+
+#define NRF_LOG_HEXDUMP_INFO(p_data, len)  gd_host_log_hexdump(GD_HOST_LOG_INFO, p_data, len)
+#define NRF_LOG_HEXDUMP_DEBUG(p_data, len) gd_host_log_hexdump(GD_HOST_LOG_DEBUG, p_data, len)
+
+#endif
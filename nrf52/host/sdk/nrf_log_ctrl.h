@@ -0,0 +1,16 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Host build: nRF5 SDK logger control (nothing to control, see nrf_log.h)
+ */
+
+#ifndef NRF_LOG_CTRL_H__
+#define NRF_LOG_CTRL_H__
+
+#include <nrf_log.h>
+
+#endif
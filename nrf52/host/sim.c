@@ -0,0 +1,443 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Receiver simulation on a Linux host
+ *
+ * Runs the receiver pipeline of the firmware (receiver.c, storage.c, ...) on
+ * top of hal_host.c. Simulated transmitters send commands like the remote
+ * controls: each press is advertised repeatedly until the receiver
+ * acknowledges it or the repetitions are exhausted. Noise (advertising of
+ * other devices, see corpus.h) and forged commands can be added. The summary
+ * shows throughput and the latency from a press to its acknowledgement.
+ */
+
+#include <hal_host.h>
+#include <corpus.h>
+
+#include <actuator.h>
+#include <adv_data.h>
+#include <auth.h>
+#include <flash.h>
+#include <metrics.h>
+#include <prof.h>
+#include <ratelimit.h>
+#include <receiver.h>
+#include <relay.h>
+#include <scheduler.h>
+#include <stall.h>
+#include <storage.h>
+#include <systime.h>
+#include <trace.h>
+#include <txstats.h>
+
+#include <app_error.h>
+#include <nrf_gpio.h>
+
+#include <mbedtls/md.h>
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    unsigned duration_s;
+    unsigned tx_count;
+    unsigned press_interval_ms; /* mean time between presses per transmitter */
+    unsigned repeat_interval_ms; /* advertising interval of a transmitter */
+    unsigned repeats;           /* advertising events per press */
+    unsigned noise_rate;        /* packets of other devices per second */
+    unsigned forged_rate;       /* forged commands per second */
+    int verbose;
+} gd_sim_config_t;
+
+typedef struct {
+    ble_uuid128_t uuid;
+    uint8_t addr[GD_HAL_ADDR_LEN];
+    uint8_t key[GD_TX_KEY_SIZE];
+    uint8_t cmd;
+    uint32_t seq_no;
+    uint64_t press_us; /* time of the current press */
+    unsigned sent;     /* advertising events of the current press */
+    bool acked;
+    bool pressed;      /* current press not yet acknowledged or lost */
+} gd_sim_tx_t;
+
+typedef struct {
+    uint32_t presses;
+    uint32_t acked;
+    uint32_t lost;
+    uint32_t busy;     /* presses skipped since the previous one was running */
+    uint32_t pulses;
+    uint32_t noise;
+    uint32_t forged;
+} gd_sim_stats_t;
+
+static gd_sim_config_t gd_sim_config = {
+    .duration_s = 600,
+    .tx_count = 4,
+    .press_interval_ms = 30000,
+    .repeat_interval_ms = 20,
+    .repeats = 150,
+    .noise_rate = 50,
+    .forged_rate = 0};
+
+static gd_sim_tx_t *gd_sim_tx;
+static gd_sim_stats_t gd_sim_stats;
+static uint32_t *gd_sim_latency_us;
+static uint32_t gd_sim_latency_size;
+static bool gd_sim_done;
+
+static const uint32_t gd_sim_relay_pins[GD_RELAY_CHANNELS] = GD_PINNO_RELAYS;
+
+/* uniform in [0, n) */
+static uint32_t gd_sim_rand(uint32_t n) {
+    return n > 0 ? (uint32_t)(drand48() * n) : 0;
+}
+
+/* exponentially distributed delay with the given mean */
+static uint64_t gd_sim_exp_us(uint64_t mean_us) {
+    double u = drand48();
+    return (uint64_t)(-(double)mean_us * log1p(-u));
+}
+
+static void gd_sim_random_uuid(ble_uuid128_t *uuid) {
+    for (size_t i = 0; i < sizeof(uuid->uuid128); i++) {
+        uuid->uuid128[i] = gd_sim_rand(256);
+    }
+}
+
+static void gd_sim_random_addr(uint8_t *addr) {
+    for (size_t i = 0; i < GD_HAL_ADDR_LEN; i++) {
+        addr[i] = gd_sim_rand(256);
+    }
+}
+
+/* advertising data of a command (see gd_ad_service_data_t) */
+static size_t gd_sim_command(uint8_t *buf, const gd_sim_tx_t *tx, bool forged) {
+    gd_ad_service_data_t sd;
+    uint8_t digest[32];
+    sd.uuid = tx->uuid;
+    sd.msg.cmd = tx->cmd;
+    sd.msg.seq_no[0] = tx->seq_no >> 16;
+    sd.msg.seq_no[1] = tx->seq_no >> 8;
+    sd.msg.seq_no[2] = tx->seq_no;
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                    tx->key, sizeof(tx->key), &sd.msg.cmd, 4, digest);
+    memcpy(sd.msg.digest, digest, sizeof(sd.msg.digest));
+    if (forged) {
+        sd.msg.digest[gd_sim_rand(sizeof(sd.msg.digest))] ^= 1 + gd_sim_rand(255);
+    }
+    buf[0] = GD_AD_SERVICE_DATA_LEN;
+    buf[1] = AD_TYPE_SERVICE_DATA128;
+    memcpy(&buf[2], &sd, sizeof(sd));
+    return 2 + sizeof(sd);
+}
+
+static void gd_sim_press(void *context);
+
+static void gd_sim_advertise(void *context) {
+    gd_sim_tx_t *tx = context;
+    uint64_t now = gd_host_now_us();
+    if (tx->acked || tx->sent == gd_sim_config.repeats) {
+        if (!tx->acked) {
+            gd_sim_stats.lost++;
+        }
+        tx->pressed = false;
+        return;
+    }
+    uint8_t buf[31];
+    gd_host_radio_send(now, tx->addr, buf, gd_sim_command(buf, tx, false),
+                       -60 - gd_sim_rand(30));
+    tx->sent++;
+    /* advDelay of 0 to 10 ms */
+    gd_host_post(now + gd_sim_config.repeat_interval_ms * 1000 + gd_sim_rand(10000),
+                 GD_HOST_EVT_SIM, gd_sim_advertise, tx);
+}
+
+static void gd_sim_press(void *context) {
+    gd_sim_tx_t *tx = context;
+    uint64_t now = gd_host_now_us();
+    if (tx->pressed) {
+        gd_sim_stats.busy++;
+    } else {
+        gd_sim_stats.presses++;
+        tx->seq_no++;
+        tx->press_us = now;
+        tx->sent = 0;
+        tx->acked = false;
+        tx->pressed = true;
+        gd_sim_advertise(tx);
+    }
+    gd_host_post(now + gd_sim_exp_us(gd_sim_config.press_interval_ms * 1000ULL),
+                 GD_HOST_EVT_SIM, gd_sim_press, tx);
+}
+
+/* advertising of other devices */
+static void gd_sim_noise(void *context) {
+    uint64_t now = gd_host_now_us();
+    uint8_t addr[GD_HAL_ADDR_LEN];
+    uint8_t buf[31];
+    size_t len = gd_corpus_packet(gd_sim_rand(GD_CORPUS_COUNT), buf, gd_sim_rand);
+    gd_sim_random_addr(addr);
+    gd_host_radio_send(now, addr, buf, len, -90 + gd_sim_rand(40));
+    gd_sim_stats.noise++;
+    gd_host_post(now + gd_sim_exp_us(1000000 / gd_sim_config.noise_rate),
+                 GD_HOST_EVT_SIM, gd_sim_noise, NULL);
+}
+
+/* commands of known transmitters with a wrong digest, sent by an attacker
+ * with its own address */
+static void gd_sim_forged(void *context) {
+    static const uint8_t addr[GD_HAL_ADDR_LEN] = {0x66, 0x55, 0x44, 0x33, 0x22, 0xc1};
+    uint64_t now = gd_host_now_us();
+    gd_sim_tx_t tx = gd_sim_tx[gd_sim_rand(gd_sim_config.tx_count)];
+    uint8_t buf[31];
+    tx.seq_no += 1 + gd_sim_rand(100);
+    gd_host_radio_send(now, addr, buf, gd_sim_command(buf, &tx, true), -70);
+    gd_sim_stats.forged++;
+    gd_host_post(now + gd_sim_exp_us(1000000 / gd_sim_config.forged_rate),
+                 GD_HOST_EVT_SIM, gd_sim_forged, NULL);
+}
+
+static void gd_sim_end(void *context) {
+    gd_sim_done = true;
+}
+
+/* replaces ack.c: the transmitter stops advertising when it receives the
+ * acknowledgement */
+void gd_ack_send(const ble_uuid128_t *uuid,
+                 const uint8_t key[GD_TX_KEY_SIZE],
+                 const gd_message_t *msg) {
+    gd_host_clock_stop();
+    uint32_t seq_no = (msg->seq_no[0] << 16) | (msg->seq_no[1] << 8) | msg->seq_no[2];
+    for (unsigned i = 0; i < gd_sim_config.tx_count; i++) {
+        gd_sim_tx_t *tx = &gd_sim_tx[i];
+        if (memcmp(&tx->uuid, uuid, sizeof(ble_uuid128_t)) == 0 &&
+            tx->seq_no == seq_no && tx->pressed && !tx->acked) {
+            tx->acked = true;
+            if (gd_sim_stats.acked == gd_sim_latency_size) {
+                gd_sim_latency_size = gd_sim_latency_size ? 2 * gd_sim_latency_size : 1024;
+                gd_sim_latency_us = realloc(gd_sim_latency_us,
+                                            gd_sim_latency_size * sizeof(uint32_t));
+                APP_ERROR_CHECK_BOOL(gd_sim_latency_us != NULL);
+            }
+            gd_sim_latency_us[gd_sim_stats.acked++] = gd_host_now_us() - tx->press_us;
+        }
+    }
+    gd_host_clock_start();
+}
+
+static void gd_sim_gpio_handler(uint32_t pin, bool level) {
+    for (unsigned i = 0; i < GD_RELAY_CHANNELS; i++) {
+        if (pin == gd_sim_relay_pins[i] && level) {
+            gd_sim_stats.pulses++;
+        }
+    }
+}
+
+static void gd_sim_act_state_handler(bool active) {
+}
+
+static int gd_sim_cmp(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void gd_sim_summary(void) {
+    gd_host_stats_t hs;
+    gd_host_get_stats(&hs);
+    double seconds = gd_host_now_us() / 1e6;
+    uint32_t n = gd_sim_stats.acked;
+
+    printf("simulated time:   %.3f s\n", seconds);
+    printf("packets:          %u (reported %u, between windows %u, scanner stopped %u)\n",
+           hs.packets, hs.reports, hs.missed_window, hs.missed_stopped);
+    printf("noise/forged:     %u/%u\n", gd_sim_stats.noise, gd_sim_stats.forged);
+    printf("interrupts:       %u (%.3f s)\n", hs.interrupts, hs.isr_us / 1e6);
+    printf("presses:          %u (acknowledged %u, lost %u, skipped %u)\n",
+           gd_sim_stats.presses, n, gd_sim_stats.lost, gd_sim_stats.busy);
+    printf("relay pulses:     %u\n", gd_sim_stats.pulses);
+    /* UART bytes of the text and binary log backends (at debug level) */
+    printf("log:              %u entries, text %u bytes, binary %u bytes\n",
+           hs.log_entries, hs.log_text_bytes, hs.log_bin_bytes);
+    uint32_t rejects = gd_metric_get(GD_METRIC_PKT_REJECTED);
+    printf("reports/s:        %.1f (rejects/s %.1f)\n",
+           seconds > 0 ? hs.reports / seconds : 0, seconds > 0 ? rejects / seconds : 0);
+    if (n > 0) {
+        uint64_t sum = 0;
+        qsort(gd_sim_latency_us, n, sizeof(uint32_t), gd_sim_cmp);
+        for (uint32_t i = 0; i < n; i++) {
+            sum += gd_sim_latency_us[i];
+        }
+        printf("ack latency [ms]: min %.1f, avg %.1f, p50 %.1f, p99 %.1f, max %.1f\n",
+               gd_sim_latency_us[0] / 1e3, sum / 1e3 / n,
+               gd_sim_latency_us[n / 2] / 1e3, gd_sim_latency_us[(n - 1) * 99 / 100] / 1e3,
+               gd_sim_latency_us[n - 1] / 1e3);
+    }
+    for (unsigned stage = 0; stage < GD_TRACE_STAGES; stage++) {
+        gd_trace_summary_t ts;
+        gd_trace_get_summary(stage, &ts);
+        printf("trace %-11s n %u, p50 %u us, p99 %u us, max %u us\n",
+               gd_trace_stage_name(stage), ts.count, ts.p50_us, ts.p99_us, ts.max_us);
+    }
+    uint8_t record[GD_TRACE_RECORD_SIZE];
+    size_t len = gd_trace_encode(record, sizeof(record));
+    printf("trace record:     ");
+    for (size_t i = 0; i < len; i++) {
+        printf("%02x", record[i]);
+    }
+    printf("\n");
+    gds_flash_stats_t fs;
+    gds_flash_get_stats(&fs);
+    printf("flash erase:      %u pages, %u slices\n", fs.pages, fs.slices);
+    if (fs.act_count > 0) {
+        printf("erase actuations: %u (max. latency %.1f ms)\n", fs.act_count,
+               fs.act_max_us / 1e3);
+    }
+}
+
+static void gd_sim_usage(const char *name) {
+    printf("usage: %s [options]\n"
+           "  -s, --seed N             random seed (default: 1)\n"
+           "  -d, --duration S         simulated time in seconds (%u)\n"
+           "  -t, --tx N               number of transmitters (%u)\n"
+           "  -p, --press-interval MS  mean time between presses per transmitter (%u)\n"
+           "  -r, --repeat-interval MS advertising interval of the transmitters (%u)\n"
+           "  -n, --repeats N          advertising events per press (%u)\n"
+           "  -N, --noise N            packets of other devices per second (%u)\n"
+           "  -f, --forged N           forged commands per second (%u)\n"
+           "  -c, --cpu-scale X        host CPU speed relative to the nRF52 (40)\n"
+           "  -i, --scan-interval MS   (50)\n"
+           "  -w, --scan-window MS     (30)\n"
+           "  -v, --verbose            firmware log (repeat for debug messages)\n",
+           name, gd_sim_config.duration_s, gd_sim_config.tx_count,
+           gd_sim_config.press_interval_ms, gd_sim_config.repeat_interval_ms,
+           gd_sim_config.repeats, gd_sim_config.noise_rate, gd_sim_config.forged_rate);
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option options[] = {
+        {"seed", required_argument, NULL, 's'},
+        {"duration", required_argument, NULL, 'd'},
+        {"tx", required_argument, NULL, 't'},
+        {"press-interval", required_argument, NULL, 'p'},
+        {"repeat-interval", required_argument, NULL, 'r'},
+        {"repeats", required_argument, NULL, 'n'},
+        {"noise", required_argument, NULL, 'N'},
+        {"forged", required_argument, NULL, 'f'},
+        {"cpu-scale", required_argument, NULL, 'c'},
+        {"scan-interval", required_argument, NULL, 'i'},
+        {"scan-window", required_argument, NULL, 'w'},
+        {"verbose", no_argument, NULL, 'v'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+    gd_host_config_t host_config = {
+        .cpu_scale = 40,
+        .scan_interval_us = 50000,
+        .scan_window_us = 30000,
+        .log_level = GD_HOST_LOG_WARNING};
+    long seed = 1;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "s:d:t:p:r:n:N:f:c:i:w:vh", options, NULL)) != -1) {
+        switch (c) {
+            case 's': seed = atol(optarg); break;
+            case 'd': gd_sim_config.duration_s = atoi(optarg); break;
+            case 't': gd_sim_config.tx_count = atoi(optarg); break;
+            case 'p': gd_sim_config.press_interval_ms = atoi(optarg); break;
+            case 'r': gd_sim_config.repeat_interval_ms = atoi(optarg); break;
+            case 'n': gd_sim_config.repeats = atoi(optarg); break;
+            case 'N': gd_sim_config.noise_rate = atoi(optarg); break;
+            case 'f': gd_sim_config.forged_rate = atoi(optarg); break;
+            case 'c': host_config.cpu_scale = atof(optarg); break;
+            case 'i': host_config.scan_interval_us = atoi(optarg) * 1000; break;
+            case 'w': host_config.scan_window_us = atoi(optarg) * 1000; break;
+            case 'v': gd_sim_config.verbose++; break;
+            case 'h':
+                gd_sim_usage(argv[0]);
+                return 0;
+            default:
+                gd_sim_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (gd_sim_config.tx_count == 0 || gd_sim_config.press_interval_ms == 0 ||
+        host_config.scan_window_us > host_config.scan_interval_us) {
+        fprintf(stderr, "invalid parameters\n");
+        return 1;
+    }
+    if (gd_sim_config.verbose > 0) {
+        host_config.log_level = gd_sim_config.verbose > 1 ? GD_HOST_LOG_DEBUG
+                                                          : GD_HOST_LOG_INFO;
+    }
+    srand48(seed);
+
+    gd_host_init(&host_config);
+    gd_host_set_gpio_handler(gd_sim_gpio_handler);
+
+    /* same order as in main.c */
+    gd_sched_init(gd_time_ticks);
+    gd_sched_register(GD_EVT_ACCEPT, GD_PRIO_ACTUATION, "accept", gd_rx_accept_evt_handler);
+    gd_sched_register(GD_EVT_ADV, GD_PRIO_VERIFY, "adv", gd_rx_adv_evt_handler);
+    gd_sched_register(GD_EVT_GC, GD_PRIO_MAINT, "gc", gds_tasks);
+    gd_time_init();
+    gd_prof_init();
+    gd_stall_init();
+    gd_trace_init();
+    gd_act_init(&gd_relay_gpio_driver, gd_sim_act_state_handler);
+    gd_relay_gpio_init();
+    APP_ERROR_CHECK(gds_init());
+    gd_rl_init();
+    gd_txs_init();
+    gd_hal_radio_init(gd_rx_adv_report);
+
+    /* the transmitters are learned beforehand */
+    gd_sim_tx = calloc(gd_sim_config.tx_count, sizeof(gd_sim_tx_t));
+    APP_ERROR_CHECK_BOOL(gd_sim_tx != NULL);
+    for (unsigned i = 0; i < gd_sim_config.tx_count; i++) {
+        gd_sim_tx_t *tx = &gd_sim_tx[i];
+        gd_sim_random_uuid(&tx->uuid);
+        gd_sim_random_addr(tx->addr);
+        gd_calculate_tx_key(&tx->uuid, tx->key);
+        tx->cmd = GD_CMD_TRIGGER + i % GD_RELAY_CHANNELS;
+        APP_ERROR_CHECK_BOOL(gds_create_tx_record(&tx->uuid, gd_act_get_outputs(tx->cmd)));
+        gd_host_post(gd_host_now_us() +
+                         gd_sim_exp_us(gd_sim_config.press_interval_ms * 1000ULL),
+                     GD_HOST_EVT_SIM, gd_sim_press, tx);
+    }
+    if (gd_sim_config.noise_rate > 0) {
+        gd_host_post(gd_host_now_us(), GD_HOST_EVT_SIM, gd_sim_noise, NULL);
+    }
+    if (gd_sim_config.forged_rate > 0) {
+        gd_host_post(gd_host_now_us(), GD_HOST_EVT_SIM, gd_sim_forged, NULL);
+    }
+    gd_host_post(gd_host_now_us() + gd_sim_config.duration_s * 1000000ULL,
+                 GD_HOST_EVT_SIM, gd_sim_end, NULL);
+
+    gd_rx_init();
+    gd_sched_post(GD_EVT_GC);
+
+    while (!gd_sim_done) {
+        gd_stall_iter_begin();
+        gd_sched_execute();
+        gd_stall_iter_end();
+        gd_sched_sleep();
+    }
+
+    gd_host_set_log_level(gd_sim_config.verbose > 1 ? GD_HOST_LOG_DEBUG : GD_HOST_LOG_INFO);
+    gd_sched_log_stats();
+    gd_prof_log();
+    gd_stall_log();
+    gd_metrics_log();
+    gd_txs_log();
+    gds_dump_to_log();
+    gd_sim_summary();
+    return 0;
+}
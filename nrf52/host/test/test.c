@@ -0,0 +1,67 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Minimal test support for host tests
+ */
+
+#include "test.h"
+#include <hal_host.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static unsigned gd_test_checks;
+static unsigned gd_test_failures;
+static bool gd_test_reached;
+
+void gd_test_init(void) {
+    const gd_host_config_t config = {
+        .cpu_scale = 0,
+        .scan_interval_us = 50000,
+        .scan_window_us = 30000,
+        .log_level = GD_HOST_LOG_ERROR};
+    gd_host_init(&config);
+}
+
+bool gd_test_check(bool ok, const char *expr, const char *file, int line) {
+    gd_test_checks++;
+    if (!ok) {
+        gd_test_failures++;
+        printf("%s:%d: check failed: %s\n", file, line, expr);
+    }
+    return ok;
+}
+
+bool gd_test_check_eq(long long a, long long b, const char *expr, const char *file,
+                      int line) {
+    if (!gd_test_check(a == b, expr, file, line)) {
+        printf("    %lld != %lld\n", a, b);
+        return false;
+    }
+    return true;
+}
+
+static void gd_test_reached_handler(void *context) {
+    gd_test_reached = true;
+}
+
+void gd_test_run_until(uint64_t time_us) {
+    gd_test_reached = false;
+    gd_host_post(time_us, GD_HOST_EVT_SIM, gd_test_reached_handler, NULL);
+    while (!gd_test_reached) {
+        gd_hal_sleep();
+    }
+}
+
+void gd_test_run_ms(uint32_t ms) {
+    gd_test_run_until(gd_host_now_us() + ms * 1000ULL);
+}
+
+int gd_test_result(const char *name) {
+    printf("%s: %u checks, %u failed\n", name, gd_test_checks, gd_test_failures);
+    return gd_test_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
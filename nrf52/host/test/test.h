@@ -0,0 +1,48 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Minimal test support for host tests
+ *
+ * Tests run on the host HAL (hal_host.c) with cpu_scale = 0: the simulated
+ * time only advances while waiting for events, so timings are exact and
+ * results do not depend on the host.
+ */
+
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define GD_TEST_CHECK(cond) gd_test_check((cond), #cond, __FILE__, __LINE__)
+
+#define GD_TEST_CHECK_EQ(a, b)                                                 \
+    gd_test_check_eq((long long)(a), (long long)(b), #a " == " #b, __FILE__, \
+                     __LINE__)
+
+/** Initialize the host HAL for a test program
+ */
+void gd_test_init(void);
+
+bool gd_test_check(bool ok, const char *expr, const char *file, int line);
+
+bool gd_test_check_eq(long long a, long long b, const char *expr, const char *file,
+                      int line);
+
+/** Deliver all events up to the given simulated time (microseconds)
+ */
+void gd_test_run_until(uint64_t time_us);
+
+/** Deliver all events for the given number of milliseconds
+ */
+void gd_test_run_ms(uint32_t ms);
+
+/** Print the result; returns the exit status of the test program
+ */
+int gd_test_result(const char *name);
+
+#endif
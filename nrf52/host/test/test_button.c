@@ -0,0 +1,73 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Host tests of the button handling (button.c on the HAL input and timers)
+ */
+
+#include "test.h"
+#include <button.h>
+#include <gd_config.h>
+#include <hal_host.h>
+#include <scheduler.h>
+#include <systime.h>
+
+/* contact bounce: edges 1 ms apart */
+static void gd_test_bounce(bool level) {
+    for (unsigned i = 0; i < 3; i++) {
+        gd_host_gpio_input(GD_PINNO_BUTTON, level);
+        gd_test_run_ms(1);
+        gd_host_gpio_input(GD_PINNO_BUTTON, !level);
+        gd_test_run_ms(1);
+    }
+    gd_host_gpio_input(GD_PINNO_BUTTON, level);
+}
+
+static gd_button_cmd_t gd_test_press(uint32_t ms) {
+    gd_test_bounce(true);
+    gd_test_run_ms(ms);
+    gd_test_bounce(false);
+    gd_test_run_ms(GD_BUTTON_DEBOUNCE_MS + 10);
+    return gd_get_button();
+}
+
+/* a press of at least GD_BUTTON_SHORT_MS is reported once */
+static void gd_test_short(void) {
+    GD_TEST_CHECK_EQ(gd_test_press(GD_BUTTON_SHORT_MS + 50), GD_BUTCMD_LEARN);
+    GD_TEST_CHECK_EQ(gd_get_button(), GD_BUTCMD_NONE);
+}
+
+/* shorter presses and bouncing alone are ignored */
+static void gd_test_too_short(void) {
+    GD_TEST_CHECK_EQ(gd_test_press(GD_BUTTON_SHORT_MS / 2), GD_BUTCMD_NONE);
+    gd_test_bounce(false);
+    gd_test_run_ms(GD_BUTTON_DEBOUNCE_MS + 10);
+    GD_TEST_CHECK_EQ(gd_get_button(), GD_BUTCMD_NONE);
+}
+
+/* a long press is reported while the button is held; the release does not
+ * generate another command */
+static void gd_test_long(void) {
+    gd_test_bounce(true);
+    gd_test_run_ms(GD_BUTTON_LONG_MS + 100);
+    GD_TEST_CHECK_EQ(gd_get_button(), GD_BUTCMD_CLEAR);
+    GD_TEST_CHECK_EQ(gd_get_button(), GD_BUTCMD_NONE);
+    gd_test_bounce(false);
+    gd_test_run_ms(GD_BUTTON_DEBOUNCE_MS + 10);
+    GD_TEST_CHECK_EQ(gd_get_button(), GD_BUTCMD_NONE);
+}
+
+int main(void) {
+    gd_test_init();
+    gd_time_init();
+    gd_sched_init(gd_time_ticks);
+    gd_button_init();
+
+    gd_test_short();
+    gd_test_too_short();
+    gd_test_long();
+    return gd_test_result("test_button");
+}
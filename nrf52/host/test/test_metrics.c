@@ -0,0 +1,166 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Round trip test of the metrics frame encoder and metrics_decode.py
+ *
+ * A snapshot is written as hex dump in the format of the firmware log and
+ * decoded by metrics_decode.py; its output must match the metric values.
+ */
+
+#include "test.h"
+#include <metrics.h>
+#include <systime.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define GD_TEST_DECODER "python3 " GD_TEST_SRC_DIR "/metrics_decode.py"
+#define GD_TEST_HEADER  GD_TEST_SRC_DIR "/include/metrics.h"
+
+/* bytes per line of NRF_LOG_HEXDUMP */
+#define GD_TEST_HEXDUMP_WIDTH 8
+
+#define GD_TEST_UPTIME_S 5
+
+static const char *const gd_test_names[GD_METRIC_COUNT] = {
+#define GD_TEST_NAME(id, kind, name) [GD_METRIC_##id] = name,
+    GD_METRICS(GD_TEST_NAME)
+#undef GD_TEST_NAME
+};
+
+static const gd_metric_type_t gd_test_types[GD_METRIC_COUNT] = {
+#define GD_TEST_TYPE(id, kind, name) [GD_METRIC_##id] = GD_METRIC_TYPE_##kind,
+    GD_METRICS(GD_TEST_TYPE)
+#undef GD_TEST_TYPE
+};
+
+static const char *const gd_test_type_names[] = {
+    [GD_METRIC_TYPE_COUNTER] = "counter",
+    [GD_METRIC_TYPE_GAUGE] = "gauge",
+    [GD_METRIC_TYPE_HISTOGRAM] = "histogram"};
+
+/* observations of each histogram: one value per bin, value n times */
+static uint32_t gd_test_bins[GD_METRIC_COUNT][GD_METRIC_HIST_BINS];
+
+static void gd_test_fill(void) {
+    for (unsigned id = 0; id < GD_METRIC_COUNT; id++) {
+        switch (gd_test_types[id]) {
+        case GD_METRIC_TYPE_COUNTER:
+            /* all bytes of the value differ to detect byte order errors */
+            gd_metric_add(id, 0x04030201 + 0x10 * id);
+            break;
+        case GD_METRIC_TYPE_GAUGE:
+            gd_metric_set(id, 1000 + id);
+            break;
+        case GD_METRIC_TYPE_HISTOGRAM:
+            for (unsigned bin = 0; bin < GD_METRIC_HIST_BINS; bin++) {
+                /* smallest value of the bin (bin n counts values < 2^n) */
+                uint32_t value = bin == 0 ? 0 : 1U << (bin - 1);
+                gd_test_bins[id][bin] = bin + id;
+                for (unsigned n = 0; n < bin + id; n++) {
+                    gd_metric_observe(id, value);
+                }
+            }
+            /* values beyond the last bin */
+            gd_metric_observe(id, 1U << 20);
+            gd_test_bins[id][GD_METRIC_HIST_BINS - 1]++;
+            break;
+        }
+    }
+}
+
+static void gd_test_write_frame(FILE *f, const uint8_t *frame, size_t len) {
+    fprintf(f, "<info> app: metrics frame:\n");
+    for (size_t i = 0; i < len; i += GD_TEST_HEXDUMP_WIDTH) {
+        fprintf(f, "<info> app: ");
+        for (size_t j = i; j < i + GD_TEST_HEXDUMP_WIDTH; j++) {
+            if (j < len) {
+                fprintf(f, " %02X", frame[j]);
+            } else {
+                fprintf(f, "   ");
+            }
+        }
+        fprintf(f, "|");
+        for (size_t j = i; j < i + GD_TEST_HEXDUMP_WIDTH && j < len; j++) {
+            fputc(frame[j] >= 0x20 && frame[j] < 0x7f ? frame[j] : '.', f);
+        }
+        fprintf(f, "\n");
+    }
+}
+
+/* the line metrics_decode.py prints for a metric */
+static void gd_test_expected_line(unsigned id, char *line, size_t size) {
+    int n = snprintf(line, size, "  %-20s", gd_test_names[id]);
+    if (gd_test_types[id] == GD_METRIC_TYPE_HISTOGRAM) {
+        for (unsigned bin = 0; bin < GD_METRIC_HIST_BINS; bin++) {
+            if (bin < GD_METRIC_HIST_BINS - 1) {
+                n += snprintf(line + n, size - n, " <%u:%u", 1U << bin, gd_test_bins[id][bin]);
+            } else {
+                n += snprintf(line + n, size - n, " >=%u:%u", 1U << (bin - 1),
+                              gd_test_bins[id][bin]);
+            }
+        }
+    } else {
+        snprintf(line + n, size - n, " %u (%s)", gd_metric_get(id),
+                 gd_test_type_names[gd_test_types[id]]);
+    }
+}
+
+static void gd_test_round_trip(void) {
+    static uint8_t frame[512];
+    size_t len = gd_metrics_encode(frame, sizeof(frame));
+    GD_TEST_CHECK(len > 0);
+    GD_TEST_CHECK_EQ(gd_metrics_encode(frame, 16), 0);
+    len = gd_metrics_encode(frame, sizeof(frame));
+
+    char log_name[] = "/tmp/gd_test_metrics_XXXXXX";
+    int fd = mkstemp(log_name);
+    GD_TEST_CHECK(fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+    FILE *log = fdopen(fd, "w");
+    fprintf(log, "<info> app: unrelated 12 34 56\n");
+    gd_test_write_frame(log, frame, len);
+    fclose(log);
+
+    char cmd[512];
+    snprintf(cmd, sizeof(cmd), GD_TEST_DECODER " --header " GD_TEST_HEADER " %s", log_name);
+    FILE *out = popen(cmd, "r");
+    GD_TEST_CHECK(out != NULL);
+    if (out == NULL) {
+        unlink(log_name);
+        return;
+    }
+    char line[256], expected[256];
+    /* second snapshot of this test */
+    snprintf(expected, sizeof(expected), "snapshot 1, uptime %u s\n", GD_TEST_UPTIME_S);
+    GD_TEST_CHECK(fgets(line, sizeof(line), out) != NULL && strcmp(line, expected) == 0);
+    for (unsigned id = 0; id < GD_METRIC_COUNT; id++) {
+        gd_test_expected_line(id, expected, sizeof(expected) - 1);
+        strcat(expected, "\n");
+        if (!GD_TEST_CHECK(fgets(line, sizeof(line), out) != NULL &&
+                           strcmp(line, expected) == 0)) {
+            printf("    got: %s    expected: %s", line, expected);
+        }
+    }
+    /* nothing else */
+    GD_TEST_CHECK(fgets(line, sizeof(line), out) == NULL);
+    GD_TEST_CHECK_EQ(pclose(out), 0);
+    unlink(log_name);
+}
+
+int main(void) {
+    gd_test_init();
+    gd_time_init();
+    gd_test_run_ms(GD_TEST_UPTIME_S * 1000 + 500);
+    gd_test_fill();
+    gd_test_round_trip();
+    return gd_test_result("test_metrics");
+}
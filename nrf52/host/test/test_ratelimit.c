@@ -0,0 +1,88 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Host tests of the rate limiter of digest verification attempts
+ */
+
+#include "test.h"
+#include <ratelimit.h>
+
+#include <string.h>
+
+static const ble_uuid128_t gd_test_uuid = {.uuid128 = {1, 2, 3, 4}};
+
+static void gd_test_addr(uint8_t *addr, unsigned n) {
+    memset(addr, 0, GD_HAL_ADDR_LEN);
+    addr[0] = n;
+    addr[1] = n >> 8;
+    addr[GD_HAL_ADDR_LEN - 1] = 0xc0;
+}
+
+/* one verification attempt with a wrong digest; returns whether it was
+ * verified at all */
+static bool gd_test_forge(unsigned source, uint32_t now_ms) {
+    uint8_t addr[GD_HAL_ADDR_LEN];
+    gd_test_addr(addr, source);
+    if (!gd_rl_allow(&gd_test_uuid, addr, now_ms)) {
+        return false;
+    }
+    gd_rl_report_failure(&gd_test_uuid, addr, now_ms);
+    return true;
+}
+
+/* a tracked source is blocked after its failure, others are not */
+static void gd_test_per_source(void) {
+    uint8_t addr[GD_HAL_ADDR_LEN];
+    gd_rl_init();
+    GD_TEST_CHECK(gd_test_forge(1, 1000));
+    GD_TEST_CHECK(!gd_test_forge(1, 1000 + GD_RL_BACKOFF_BASE_MS - 1));
+    gd_test_addr(addr, 2);
+    GD_TEST_CHECK(gd_rl_allow(&gd_test_uuid, addr, 1000));
+    /* back-off expired */
+    GD_TEST_CHECK(gd_test_forge(1, 1000 + GD_RL_BACKOFF_BASE_MS));
+}
+
+/* an attacker changing its address for each guess gets GD_RL_GLOBAL_BURST
+ * guesses and then one per GD_RL_GLOBAL_REFILL_MS */
+static void gd_test_rotating_addr(void) {
+    gd_rl_stats_t stats;
+    unsigned source = 100;
+    unsigned verified = 0;
+    gd_rl_init();
+    for (unsigned i = 0; i < 100; i++) {
+        verified += gd_test_forge(source++, 1000);
+    }
+    GD_TEST_CHECK_EQ(verified, GD_RL_GLOBAL_BURST);
+    verified = 0;
+    for (uint32_t t = 1000; t < 1000 + 10 * GD_RL_GLOBAL_REFILL_MS; t += 10) {
+        verified += gd_test_forge(source++, t);
+    }
+    GD_TEST_CHECK_EQ(verified, 9);
+    gd_rl_get_stats(&stats);
+    GD_TEST_CHECK(stats.global_throttled > 0);
+}
+
+/* valid commands of untracked sources do not use up the budget */
+static void gd_test_valid(void) {
+    uint8_t addr[GD_HAL_ADDR_LEN];
+    gd_rl_init();
+    gd_test_addr(addr, 7);
+    for (unsigned i = 0; i < 2 * GD_RL_GLOBAL_BURST; i++) {
+        GD_TEST_CHECK(gd_rl_allow(&gd_test_uuid, addr, 1000));
+        gd_rl_report_success(&gd_test_uuid, addr);
+    }
+    GD_TEST_CHECK(gd_test_forge(8, 1000));
+}
+
+int main(void) {
+    gd_test_init();
+
+    gd_test_per_source();
+    gd_test_rotating_addr();
+    gd_test_valid();
+    return gd_test_result("test_ratelimit");
+}
@@ -0,0 +1,195 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Host tests of the receiver pipeline (receiver.c and storage.c on the host
+ * FDS)
+ *
+ * Commands are sent over the simulated radio and handled by the scheduler
+ * like in main.c. Relay pulses and acknowledgements are counted.
+ */
+
+#include "test.h"
+#include <actuator.h>
+#include <adv_data.h>
+#include <auth.h>
+#include <gd_config.h>
+#include <hal_host.h>
+#include <ratelimit.h>
+#include <receiver.h>
+#include <relay.h>
+#include <scheduler.h>
+#include <storage.h>
+#include <systime.h>
+#include <trace.h>
+#include <txstats.h>
+
+#include <app_error.h>
+#include <fds.h>
+#include <mbedtls/md.h>
+#include <string.h>
+
+/* advertising events per press */
+#define GD_TEST_REPEATS        10
+#define GD_TEST_REPEAT_US      20000
+
+static const uint32_t gd_test_pin[GD_RELAY_CHANNELS] = GD_PINNO_RELAYS;
+static const uint8_t gd_test_addr[GD_HAL_ADDR_LEN] = {0x01, 0x02, 0x03, 0x04, 0x05, 0xc0};
+
+static ble_uuid128_t gd_test_uuid = {.uuid128 = {0x10, 0x32, 0x54, 0x76}};
+static uint8_t gd_test_key[GD_TX_KEY_SIZE];
+static unsigned gd_test_pulses;
+static unsigned gd_test_acks;
+static bool gd_test_reached;
+static uint32_t gd_test_clear_seq_no; /* command received during the clear */
+
+/* replaces ack.c */
+void gd_ack_send(const ble_uuid128_t *uuid,
+                 const uint8_t key[GD_TX_KEY_SIZE],
+                 const gd_message_t *msg) {
+    gd_test_acks++;
+}
+
+static void gd_test_gpio_handler(uint32_t pin, bool level) {
+    for (unsigned ch = 0; ch < GD_RELAY_CHANNELS; ch++) {
+        if (pin == gd_test_pin[ch] && level) {
+            gd_test_pulses++;
+        }
+    }
+}
+
+static void gd_test_act_state_handler(bool active) {
+}
+
+/* advertising data of a command (see gd_ad_service_data_t) */
+static size_t gd_test_command(uint8_t *buf, uint32_t seq_no) {
+    gd_ad_service_data_t sd;
+    uint8_t digest[32];
+    sd.uuid = gd_test_uuid;
+    sd.msg.cmd = GD_CMD_TRIGGER;
+    sd.msg.seq_no[0] = seq_no >> 16;
+    sd.msg.seq_no[1] = seq_no >> 8;
+    sd.msg.seq_no[2] = seq_no;
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                    gd_test_key, sizeof(gd_test_key), &sd.msg.cmd, 4, digest);
+    memcpy(sd.msg.digest, digest, sizeof(sd.msg.digest));
+    buf[0] = GD_AD_SERVICE_DATA_LEN;
+    buf[1] = AD_TYPE_SERVICE_DATA128;
+    memcpy(&buf[2], &sd, sizeof(sd));
+    return 2 + sizeof(sd);
+}
+
+/* advertise a press from now on like a transmitter */
+static void gd_test_press(uint32_t seq_no) {
+    uint8_t buf[31];
+    size_t len = gd_test_command(buf, seq_no);
+    uint64_t now = gd_host_now_us();
+    for (unsigned i = 0; i < GD_TEST_REPEATS; i++) {
+        gd_host_radio_send(now + i * GD_TEST_REPEAT_US, gd_test_addr, buf, len, -60);
+    }
+}
+
+static void gd_test_reached_handler(void *context) {
+    gd_test_reached = true;
+}
+
+/* run the main loop for the given number of milliseconds */
+static void gd_test_run_main_ms(uint32_t ms) {
+    gd_test_reached = false;
+    gd_host_post(gd_host_now_us() + ms * 1000ULL, GD_HOST_EVT_SIM, gd_test_reached_handler,
+                 NULL);
+    while (!gd_test_reached) {
+        gd_sched_execute();
+        gd_sched_sleep();
+    }
+}
+
+/* the button handler clears the transmitters; a command is reported right
+ * before, so it is verified while the deletion is pending */
+static void gd_test_button_handler(void) {
+    uint8_t buf[31];
+    gd_rx_adv_report(gd_test_addr, buf, gd_test_command(buf, gd_test_clear_seq_no), -60);
+    gds_clear();
+}
+
+static void gd_test_begin(void) {
+    gd_test_run_main_ms(GD_ACT_PULSE_US / 1000 + GD_ACT_MIN_GAP_MS + GD_ACT_COALESCE_MS + 1000);
+    gd_test_pulses = 0;
+    gd_test_acks = 0;
+}
+
+/* a fresh command is executed and acknowledged */
+static void gd_test_accept(void) {
+    gd_test_begin();
+    gd_test_press(1);
+    gd_test_run_main_ms(1000);
+    GD_TEST_CHECK_EQ(gd_test_pulses, 1);
+    GD_TEST_CHECK_EQ(gd_test_acks, 1);
+}
+
+/* a command whose sequence number cannot be written is neither executed nor
+ * acknowledged; the next press works again */
+static void gd_test_persist_failure(void) {
+    uint32_t seq_no;
+    gd_test_begin();
+    GD_TEST_CHECK(gds_get_seq_no(&gd_test_uuid, &seq_no));
+    fds_host_fail_writes(1);
+    gd_test_press(seq_no + 1);
+    gd_test_run_main_ms(1000);
+    GD_TEST_CHECK_EQ(gd_test_pulses, 0);
+    GD_TEST_CHECK_EQ(gd_test_acks, 0);
+    gd_test_press(seq_no + 2);
+    gd_test_run_main_ms(1000);
+    GD_TEST_CHECK_EQ(gd_test_pulses, 1);
+    GD_TEST_CHECK_EQ(gd_test_acks, 1);
+}
+
+/* a command received during the clear is rejected and the transmitter
+ * remains unknown afterwards */
+static void gd_test_clear(void) {
+    uint32_t seq_no;
+    gd_test_begin();
+    GD_TEST_CHECK(gds_get_seq_no(&gd_test_uuid, &seq_no));
+    gd_test_clear_seq_no = seq_no + 1;
+    gd_sched_post(GD_EVT_BUTTON);
+    gd_test_run_main_ms(1000);
+    GD_TEST_CHECK_EQ(gd_test_pulses, 0);
+    GD_TEST_CHECK_EQ(gd_test_acks, 0);
+    GD_TEST_CHECK(!gds_get_seq_no(&gd_test_uuid, &seq_no));
+    gd_test_press(gd_test_clear_seq_no + 1);
+    gd_test_run_main_ms(1000);
+    GD_TEST_CHECK_EQ(gd_test_pulses, 0);
+    GD_TEST_CHECK_EQ(gd_test_acks, 0);
+}
+
+int main(void) {
+    gd_test_init();
+    gd_host_set_gpio_handler(gd_test_gpio_handler);
+
+    /* same order as in main.c */
+    gd_sched_init(gd_time_ticks);
+    gd_sched_register(GD_EVT_ACCEPT, GD_PRIO_ACTUATION, "accept", gd_rx_accept_evt_handler);
+    gd_sched_register(GD_EVT_ADV, GD_PRIO_VERIFY, "adv", gd_rx_adv_evt_handler);
+    gd_sched_register(GD_EVT_BUTTON, GD_PRIO_STORAGE, "button", gd_test_button_handler);
+    gd_sched_register(GD_EVT_GC, GD_PRIO_MAINT, "gc", gds_tasks);
+    gd_time_init();
+    gd_trace_init();
+    gd_act_init(&gd_relay_gpio_driver, gd_test_act_state_handler);
+    gd_relay_gpio_init();
+    APP_ERROR_CHECK(gds_init());
+    gd_rl_init();
+    gd_txs_init();
+    gd_hal_radio_init(gd_rx_adv_report);
+    gd_rx_init();
+
+    gd_calculate_tx_key(&gd_test_uuid, gd_test_key);
+    GD_TEST_CHECK(gds_create_tx_record(&gd_test_uuid, gd_act_get_outputs(GD_CMD_TRIGGER)));
+
+    gd_test_accept();
+    gd_test_persist_failure();
+    gd_test_clear();
+    return gd_test_result("test_receiver");
+}
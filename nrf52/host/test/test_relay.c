@@ -0,0 +1,214 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Host tests of the actuator and the relay driver interface
+ *
+ * The actuator drives the HAL GPIO driver (relay_gpio.c) through a wrapper
+ * that can report the relay as busy. The pin edges are recorded with their
+ * simulated time.
+ */
+
+#include "test.h"
+#include <actuator.h>
+#include <gd_config.h>
+#include <hal_host.h>
+#include <relay.h>
+#include <systime.h>
+#include <trace.h>
+
+#include <nrf_gpio.h>
+#include <string.h>
+
+#define GD_TEST_MAX_EDGES 16
+
+typedef struct {
+    unsigned channel;
+    bool level;
+    uint64_t time_us;
+} gd_test_edge_t;
+
+static const uint32_t gd_test_pin[GD_RELAY_CHANNELS] = GD_PINNO_RELAYS;
+
+static gd_test_edge_t gd_test_edges[GD_TEST_MAX_EDGES];
+static unsigned gd_test_edge_count;
+static unsigned gd_test_busy;      /* pulse starts to be refused */
+static unsigned gd_test_active;    /* state handler calls with active = true */
+static unsigned gd_test_inactive;  /* and with active = false */
+
+static void gd_test_gpio_handler(uint32_t pin, bool level) {
+    for (unsigned ch = 0; ch < GD_RELAY_CHANNELS; ch++) {
+        if (pin == gd_test_pin[ch] && gd_test_edge_count < GD_TEST_MAX_EDGES) {
+            gd_test_edges[gd_test_edge_count++] = (gd_test_edge_t){
+                .channel = ch, .level = level, .time_us = gd_host_now_us()};
+        }
+    }
+}
+
+static bool gd_test_pulse(unsigned channel, uint32_t width_us) {
+    if (gd_test_busy > 0) {
+        gd_test_busy--;
+        return false;
+    }
+    return gd_relay_gpio_driver.pulse(channel, width_us);
+}
+
+static bool gd_test_is_on(unsigned channel) {
+    return gd_relay_gpio_driver.is_on(channel);
+}
+
+static const gd_relay_driver_t gd_test_driver = {
+    .pulse = gd_test_pulse,
+    .is_on = gd_test_is_on};
+
+static void gd_test_state_handler(bool active) {
+    if (active) {
+        gd_test_active++;
+    } else {
+        gd_test_inactive++;
+    }
+}
+
+/* start a test case after all previous pulses, gaps and coalescing windows */
+static uint64_t gd_test_begin(void) {
+    gd_test_run_ms(GD_ACT_PULSE_US / 1000 + GD_ACT_MIN_GAP_MS + GD_ACT_COALESCE_MS + 1000);
+    gd_test_edge_count = 0;
+    gd_test_active = 0;
+    gd_test_inactive = 0;
+    return gd_host_now_us();
+}
+
+static void gd_test_check_pulse(unsigned ndx, unsigned channel, uint64_t start_us) {
+    GD_TEST_CHECK(gd_test_edge_count >= ndx + 2);
+    gd_test_edge_t *rise = &gd_test_edges[ndx];
+    gd_test_edge_t *fall = &gd_test_edges[ndx + 1];
+    GD_TEST_CHECK_EQ(rise->channel, channel);
+    GD_TEST_CHECK(rise->level);
+    GD_TEST_CHECK_EQ(rise->time_us, start_us);
+    GD_TEST_CHECK_EQ(fall->channel, channel);
+    GD_TEST_CHECK(!fall->level);
+    GD_TEST_CHECK_EQ(fall->time_us - rise->time_us, GD_ACT_PULSE_US);
+}
+
+static void gd_test_single_pulse(void) {
+    uint64_t t0 = gd_test_begin();
+    gd_act_submit(GD_CMD_TRIGGER, gd_hal_counter());
+    GD_TEST_CHECK(gd_act_is_active());
+    gd_test_run_ms(GD_ACT_PULSE_US / 1000 + 10);
+    GD_TEST_CHECK(!gd_act_is_active());
+    GD_TEST_CHECK_EQ(gd_test_edge_count, 2);
+    gd_test_check_pulse(0, 0, t0);
+    GD_TEST_CHECK_EQ(gd_test_active, 1);
+    GD_TEST_CHECK_EQ(gd_test_inactive, 1);
+}
+
+/* presses within the coalescing window result in a single pulse */
+static void gd_test_coalesce(void) {
+    gd_act_stats_t before, after;
+    gd_trace_summary_t trace_before, trace_after;
+    gd_act_get_stats(&before);
+    gd_trace_get_summary(GD_TRACE_ACTUATE, &trace_before);
+    uint64_t t0 = gd_test_begin();
+    gd_act_submit(GD_CMD_TRIGGER, gd_hal_counter());
+    gd_test_run_ms(500);
+    gd_act_submit(GD_CMD_TRIGGER, gd_hal_counter());
+    gd_test_run_ms(GD_ACT_COALESCE_MS - 600);
+    gd_act_submit(GD_CMD_TRIGGER, gd_hal_counter());
+    gd_test_run_ms(GD_ACT_MIN_GAP_MS + GD_ACT_PULSE_US / 1000);
+    GD_TEST_CHECK_EQ(gd_test_edge_count, 2);
+    gd_test_check_pulse(0, 0, t0);
+    gd_act_get_stats(&after);
+    GD_TEST_CHECK_EQ(after.coalesced - before.coalesced, 2);
+    GD_TEST_CHECK_EQ(after.executed - before.executed, 1);
+    /* traced at the pulse start only */
+    gd_trace_get_summary(GD_TRACE_ACTUATE, &trace_after);
+    GD_TEST_CHECK_EQ(trace_after.count - trace_before.count, 1);
+}
+
+/* a press after the coalescing window starts a new pulse, but not before
+ * the minimum gap has elapsed */
+static void gd_test_repeat(void) {
+    uint64_t t0 = gd_test_begin();
+    gd_act_submit(GD_CMD_TRIGGER, gd_hal_counter());
+    gd_test_run_ms(GD_ACT_COALESCE_MS + 1);
+    uint64_t t1 = gd_host_now_us();
+    gd_act_submit(GD_CMD_TRIGGER, gd_hal_counter());
+    gd_test_run_ms(GD_ACT_MIN_GAP_MS + 2 * GD_ACT_PULSE_US / 1000);
+    GD_TEST_CHECK_EQ(gd_test_edge_count, 4);
+    gd_test_check_pulse(0, 0, t0);
+    uint64_t earliest = t0 + GD_ACT_PULSE_US + GD_ACT_MIN_GAP_MS * 1000ULL;
+    gd_test_check_pulse(2, 0, t1 > earliest ? t1 : earliest);
+}
+
+/* outputs run independently */
+static void gd_test_channels(void) {
+#if GD_RELAY_CHANNELS > 1
+    uint64_t t0 = gd_test_begin();
+    gd_act_submit(GD_CMD_TRIGGER, gd_hal_counter());
+    gd_act_submit(GD_CMD_TRIGGER_1, gd_hal_counter());
+    GD_TEST_CHECK_EQ(gd_act_get_outputs(GD_CMD_TRIGGER_1), 1 << 1);
+    gd_test_run_ms(GD_ACT_PULSE_US / 1000 + 10);
+    GD_TEST_CHECK_EQ(gd_test_edge_count, 4);
+    GD_TEST_CHECK_EQ(gd_test_edges[0].channel, 0);
+    GD_TEST_CHECK_EQ(gd_test_edges[1].channel, 1);
+    GD_TEST_CHECK_EQ(gd_test_edges[0].time_us, t0);
+    GD_TEST_CHECK_EQ(gd_test_edges[1].time_us, t0);
+    GD_TEST_CHECK_EQ(gd_test_active, 1);
+    GD_TEST_CHECK_EQ(gd_test_inactive, 1);
+#endif
+}
+
+/* unknown commands trigger output 0 */
+static void gd_test_unknown(void) {
+    gd_act_stats_t before, after;
+    gd_act_get_stats(&before);
+    uint64_t t0 = gd_test_begin();
+    GD_TEST_CHECK_EQ(gd_act_get_outputs(0x7f), 1 << 0);
+    gd_act_submit(0x7f, gd_hal_counter());
+    gd_test_run_ms(GD_ACT_PULSE_US / 1000 + 10);
+    GD_TEST_CHECK_EQ(gd_test_edge_count, 2);
+    gd_test_check_pulse(0, 0, t0);
+    gd_act_get_stats(&after);
+    GD_TEST_CHECK_EQ(after.unknown - before.unknown, 1);
+}
+
+/* a press is kept and retried while the relay is busy */
+static void gd_test_busy_retry(void) {
+    gd_act_stats_t before, after;
+    gd_act_get_stats(&before);
+    uint64_t t0 = gd_test_begin();
+    gd_test_busy = 3;
+    gd_act_submit(GD_CMD_TRIGGER, gd_hal_counter());
+    GD_TEST_CHECK_EQ(gd_test_edge_count, 0);
+    gd_test_run_ms(3 * GD_ACT_BUSY_RETRY_MS + GD_ACT_PULSE_US / 1000 + 10);
+    GD_TEST_CHECK_EQ(gd_test_edge_count, 2);
+    gd_test_check_pulse(0, 0, t0 + 3 * GD_ACT_BUSY_RETRY_MS * 1000ULL);
+    gd_act_get_stats(&after);
+    GD_TEST_CHECK_EQ(after.busy - before.busy, 3);
+    GD_TEST_CHECK_EQ(after.executed - before.executed, 1);
+    GD_TEST_CHECK_EQ(after.dropped, before.dropped);
+    /* the trace includes the retries (resolution of one RTC tick) */
+    gd_trace_summary_t trace;
+    gd_trace_get_summary(GD_TRACE_ACTUATE, &trace);
+    GD_TEST_CHECK(trace.max_us + 1000000 / GD_HAL_COUNTER_FREQ >= 3 * GD_ACT_BUSY_RETRY_MS * 1000);
+}
+
+int main(void) {
+    gd_test_init();
+    gd_time_init();
+    gd_trace_init();
+    gd_host_set_gpio_handler(gd_test_gpio_handler);
+    gd_relay_gpio_init();
+    gd_act_init(&gd_test_driver, gd_test_state_handler);
+
+    gd_test_single_pulse();
+    gd_test_coalesce();
+    gd_test_repeat();
+    gd_test_channels();
+    gd_test_unknown();
+    gd_test_busy_retry();
+    return gd_test_result("test_relay");
+}
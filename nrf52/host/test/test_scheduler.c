@@ -0,0 +1,174 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Host tests of the priority scheduler
+ *
+ * The scheduler runs on a clock of its own that is advanced by the handlers,
+ * so latencies are exact.
+ */
+
+#include "test.h"
+#include <scheduler.h>
+
+#include <string.h>
+
+#define GD_TEST_MAX_RUNS 16
+
+static uint64_t gd_test_ticks;
+static gd_evt_t gd_test_runs[GD_TEST_MAX_RUNS];
+static unsigned gd_test_run_count;
+static unsigned gd_test_adv_reposts;
+static bool gd_test_yielded;
+
+static uint64_t gd_test_clock(void) {
+    return gd_test_ticks;
+}
+
+static void gd_test_record(gd_evt_t evt) {
+    if (gd_test_run_count < GD_TEST_MAX_RUNS) {
+        gd_test_runs[gd_test_run_count++] = evt;
+    }
+}
+
+static void gd_test_accept_handler(void) {
+    gd_test_record(GD_EVT_ACCEPT);
+    gd_test_ticks += 1;
+}
+
+static void gd_test_adv_handler(void) {
+    gd_test_record(GD_EVT_ADV);
+    gd_test_ticks += 10;
+    if (gd_test_adv_reposts > 0) {
+        gd_test_adv_reposts--;
+        gd_sched_post(GD_EVT_ADV);
+    }
+}
+
+/* waits like a flash operation: higher classes posted meanwhile run first */
+static void gd_test_button_handler(void) {
+    gd_test_record(GD_EVT_BUTTON);
+    gd_sched_post(GD_EVT_GC);
+    gd_sched_post(GD_EVT_ACCEPT);
+    gd_sched_post(GD_EVT_ADV);
+    gd_test_ticks += 100;
+    gd_test_yielded = gd_sched_yield();
+    gd_test_record(GD_EVT_BUTTON);
+}
+
+static void gd_test_maint_handler(void) {
+    gd_test_record(GD_EVT_GC);
+}
+
+static void gd_test_begin(void) {
+    gd_test_ticks = 0;
+    gd_sched_init(gd_test_clock);
+    gd_sched_register(GD_EVT_ACCEPT, GD_PRIO_ACTUATION, "accept", gd_test_accept_handler);
+    gd_sched_register(GD_EVT_ADV, GD_PRIO_VERIFY, "adv", gd_test_adv_handler);
+    gd_sched_register(GD_EVT_BUTTON, GD_PRIO_STORAGE, "button", gd_test_button_handler);
+    gd_sched_register(GD_EVT_GC, GD_PRIO_MAINT, "gc", gd_test_maint_handler);
+    gd_test_run_count = 0;
+    gd_test_adv_reposts = 0;
+    gd_test_yielded = false;
+}
+
+static void gd_test_check_runs(const gd_evt_t *expected, unsigned count) {
+    GD_TEST_CHECK_EQ(gd_test_run_count, count);
+    for (unsigned i = 0; i < count && i < gd_test_run_count; i++) {
+        GD_TEST_CHECK_EQ(gd_test_runs[i], expected[i]);
+    }
+}
+
+/* the highest class runs first, independent of the posting order */
+static void gd_test_priority(void) {
+    gd_test_begin();
+    gd_sched_post(GD_EVT_GC);
+    gd_sched_post(GD_EVT_ADV);
+    gd_sched_post(GD_EVT_ACCEPT);
+    gd_sched_execute();
+    const gd_evt_t expected[] = {GD_EVT_ACCEPT, GD_EVT_ADV, GD_EVT_GC};
+    gd_test_check_runs(expected, 3);
+}
+
+/* an event posted several times while pending runs once */
+static void gd_test_coalesce(void) {
+    gd_test_begin();
+    gd_sched_post(GD_EVT_ADV);
+    gd_sched_post(GD_EVT_ADV);
+    gd_sched_execute();
+    const gd_evt_t expected[] = {GD_EVT_ADV};
+    gd_test_check_runs(expected, 1);
+}
+
+/* a handler reposting itself gives way to higher classes posted meanwhile */
+static void gd_test_repost(void) {
+    gd_test_begin();
+    gd_test_adv_reposts = 1;
+    gd_sched_post(GD_EVT_ADV);
+    gd_sched_post(GD_EVT_GC);
+    gd_sched_execute();
+    const gd_evt_t expected[] = {GD_EVT_ADV, GD_EVT_ADV, GD_EVT_GC};
+    gd_test_check_runs(expected, 3);
+}
+
+/* yield runs the higher classes only; lower ones wait for the handler */
+static void gd_test_yield(void) {
+    gd_test_begin();
+    gd_sched_post(GD_EVT_BUTTON);
+    gd_sched_execute();
+    const gd_evt_t expected[] = {GD_EVT_BUTTON, GD_EVT_ACCEPT, GD_EVT_ADV,
+                                 GD_EVT_BUTTON, GD_EVT_GC};
+    gd_test_check_runs(expected, 5);
+    GD_TEST_CHECK(gd_test_yielded);
+    GD_TEST_CHECK_EQ(gd_sched_last_event(), GD_EVT_GC);
+}
+
+/* outside of a handler, yield must not run anything (e.g. a flash wait
+ * during initialization must not start handlers) */
+static void gd_test_yield_outside(void) {
+    gd_test_begin();
+    gd_sched_post(GD_EVT_ACCEPT);
+    GD_TEST_CHECK(!gd_sched_yield());
+    GD_TEST_CHECK_EQ(gd_test_run_count, 0);
+    gd_sched_execute();
+    GD_TEST_CHECK_EQ(gd_test_run_count, 1);
+}
+
+/* latency from the first post to the start of the handler, per class */
+static void gd_test_latency(void) {
+    gd_sched_class_stats_t cs;
+    gd_sched_handler_stats_t hs;
+    gd_test_begin();
+    gd_sched_post(GD_EVT_BUTTON);
+    gd_sched_execute();
+    /* ACCEPT and ADV were posted 100 ticks before the yield, ADV ran after
+     * ACCEPT (1 tick) */
+    gd_sched_get_class_stats(GD_PRIO_ACTUATION, &cs);
+    GD_TEST_CHECK_EQ(cs.runs, 1);
+    GD_TEST_CHECK_EQ(cs.max_latency_ticks, 100);
+    gd_sched_get_class_stats(GD_PRIO_VERIFY, &cs);
+    GD_TEST_CHECK_EQ(cs.max_latency_ticks, 101);
+    gd_sched_get_class_stats(GD_PRIO_STORAGE, &cs);
+    GD_TEST_CHECK_EQ(cs.max_latency_ticks, 0);
+    gd_sched_get_class_stats(GD_PRIO_MAINT, &cs);
+    GD_TEST_CHECK_EQ(cs.max_latency_ticks, 111);
+    /* the time of the handlers run by yield is included */
+    gd_sched_get_handler_stats(GD_EVT_BUTTON, &hs);
+    GD_TEST_CHECK_EQ(hs.runs, 1);
+    GD_TEST_CHECK_EQ(hs.max_ticks, 111);
+}
+
+int main(void) {
+    gd_test_init();
+
+    gd_test_priority();
+    gd_test_coalesce();
+    gd_test_repost();
+    gd_test_yield();
+    gd_test_yield_outside();
+    gd_test_latency();
+    return gd_test_result("test_scheduler");
+}
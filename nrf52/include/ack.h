@@ -0,0 +1,63 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Acknowledgement beacon
+ *
+ * After a command has been accepted, the receiver advertises a short
+ * non-connectable acknowledgement so that the transmitter can stop
+ * advertising early. The acknowledgement is a Service Data - 128-bit UUID
+ * AD structure with the transmitter UUID, the sequence number and a digest
+ * (see gd_ack_calc_digest()). It is one octet shorter than a command, so
+ * receivers never take it for one.
+ *
+ * The SoftDevice supports a single advertising set, which is owned by this
+ * module. Low priority beacons (see health.h) use it while no
+ * acknowledgement is running; an acknowledgement stops a running beacon.
+ */
+
+#ifndef __ACK_H__
+#define __ACK_H__
+
+#include <auth.h>
+
+#include <stdint.h>
+
+/* advertising interval and duration of an acknowledgement */
+#ifndef GD_ACK_INTERVAL_MS
+#define GD_ACK_INTERVAL_MS 20
+#endif
+#ifndef GD_ACK_DURATION_MS
+#define GD_ACK_DURATION_MS 300
+#endif
+
+typedef struct {
+    uint32_t acks;          /* acknowledgements started */
+    uint32_t adv_events;    /* completed advertising events */
+    uint32_t adv_time_ms;   /* total advertising time */
+    uint32_t beacons;       /* beacons started */
+    uint32_t beacon_events; /* completed advertising events of beacons */
+} gd_ack_stats_t;
+
+void gd_ack_init(void);
+
+/** Acknowledge the message of a transmitter. A running acknowledgement of
+ * another message is replaced.
+ */
+void gd_ack_send(const ble_uuid128_t *uuid,
+                 const uint8_t key[GD_TX_KEY_SIZE],
+                 const gd_message_t *msg);
+
+/** Advertise a beacon with the given number of advertising events if no
+ * acknowledgement is running. The data must remain valid until the beacon
+ * has ended.
+ * Returns false if the advertising set is in use.
+ */
+bool gd_ack_beacon(const uint8_t *data, uint8_t len, uint32_t interval_ms, uint8_t adv_events);
+
+void gd_ack_get_stats(gd_ack_stats_t *stats);
+
+#endif
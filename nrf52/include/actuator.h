@@ -0,0 +1,97 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Actuation queues between command reception and the relay outputs
+ *
+ * A command table maps each command to one or more output channels. Every
+ * output has its own queue, pulse timing and state, so pulses of different
+ * outputs run concurrently.
+ *
+ * Garage door drives toggle on pulse edges. To get a predictable behaviour
+ * when several transmitters send commands at the same time, presses of the
+ * same command within a coalescing window are merged into one pulse, and
+ * consecutive pulses are separated by a minimum gap.
+ */
+
+#ifndef __ACTUATOR_H__
+#define __ACTUATOR_H__
+
+#include <relay.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* commands (gd_message_t.cmd) */
+#define GD_CMD_TRIGGER   0x00 /* toggle the door drive at output 0 */
+#define GD_CMD_TRIGGER_1 0x01 /* toggle the drive at output 1 */
+#define GD_CMD_TRIGGER_2 0x02 /* toggle the drive at output 2 */
+
+/* further presses of a command within that time after an accepted press are
+ * merged into the pending or running pulse */
+#ifndef GD_ACT_COALESCE_MS
+#define GD_ACT_COALESCE_MS 2000
+#endif
+
+/* minimum time between the end of a pulse and the start of the next one */
+#ifndef GD_ACT_MIN_GAP_MS
+#define GD_ACT_MIN_GAP_MS 1000
+#endif
+
+/* default width of the relay pulse */
+#ifndef GD_ACT_PULSE_US
+#define GD_ACT_PULSE_US 1000000
+#endif
+
+/* retry interval of a pulse start while the relay is still busy */
+#ifndef GD_ACT_BUSY_RETRY_MS
+#define GD_ACT_BUSY_RETRY_MS 10
+#endif
+
+/* queue size per output */
+#ifndef GD_ACT_QUEUE_SIZE
+#define GD_ACT_QUEUE_SIZE 4
+#endif
+
+typedef struct {
+    uint32_t queued;       /* actuations put into an output queue */
+    uint32_t coalesced;    /* presses merged into another actuation */
+    uint32_t executed;     /* pulses generated */
+    uint32_t dropped;      /* presses dropped due to a full queue */
+    uint32_t busy;         /* pulse starts retried due to a busy relay */
+    uint32_t unknown;      /* unknown commands (executed as GD_CMD_TRIGGER) */
+    uint32_t max_delay_ms; /* worst-case time from queueing to pulse start */
+    uint64_t pulse_us;     /* total pulse width (relay on time) */
+    uint64_t active_us;    /* time with at least one pulse running */
+} gd_act_stats_t;
+
+/** Initialize the actuation queues.
+ * relay is the driver generating the pulses (called from main or interrupt
+ * context). state_handler is called with active = true when the first
+ * output starts a pulse and with active = false when no pulse is running
+ * anymore.
+ */
+void gd_act_init(const gd_relay_driver_t *relay, void (*state_handler)(bool active));
+
+/** Get the output channels of a command (bit n: channel n). Unknown commands
+ * are treated as GD_CMD_TRIGGER.
+ */
+uint32_t gd_act_get_outputs(uint8_t cmd);
+
+/** Submit a command received from a transmitter. Unknown commands are
+ * treated as GD_CMD_TRIGGER. t_rx is the gd_hal_counter() value of the
+ * advertising report; the latency to the start of each pulse is traced
+ * (GD_TRACE_ACTUATE).
+ */
+void gd_act_submit(uint8_t cmd, uint32_t t_rx);
+
+/** Check whether a pulse is being generated at any output
+ */
+bool gd_act_is_active(void);
+
+void gd_act_get_stats(gd_act_stats_t *stats);
+
+#endif
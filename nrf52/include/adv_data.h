@@ -0,0 +1,108 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Advertising Data (AD) parsing
+ * see Supplement to Core Spec. (CSS Version 7)
+ * see Assigned Numbers for GAP
+ * (https://www.bluetooth.com/specifications/assigned-numbers/generic-access-profile/)
+ */
+
+#ifndef __ADV_DATA_H__
+#define __ADV_DATA_H__
+
+#include <ble.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AD_TYPE_SERVICE_DATA128 0x21
+#define AD_TYPE_MANUFACTURER_DATA 0xff
+
+typedef struct {
+    uint8_t cmd;       /* command byte */
+    uint8_t seq_no[3]; /* sequence number (big endian) */
+    uint8_t digest[4]; /* first four octets of HMAC-SHA256 */
+} gd_message_t;
+
+/* Payload of a Service Data - 128-bit UUID AD structure as sent by the
+ * transmitters. All members are octet arrays, so a pointer into the
+ * advertising report can be used as is (no alignment requirements).
+ */
+typedef struct {
+    ble_uuid128_t uuid; /* transmitter UUID (little endian) */
+    gd_message_t msg;
+} gd_ad_service_data_t;
+
+/* Payload of an acknowledgement sent by the receiver (see ack.h) */
+typedef struct {
+    ble_uuid128_t uuid;
+    uint8_t seq_no[3];
+    uint8_t digest[4];
+} gd_ad_ack_data_t;
+
+/* Payload of the health beacon sent by the receiver (see health.h), a
+ * Manufacturer Specific Data AD structure. Multi-octet fields are little
+ * endian. */
+typedef struct {
+    uint8_t company[2];        /* GD_HEALTH_COMPANY_ID */
+    uint8_t marker;            /* GD_HEALTH_MARKER */
+    uint8_t version;           /* GD_HEALTH_VERSION */
+    uint8_t uptime_s[4];
+    uint8_t reset_reason;      /* GD_HEALTH_RESET_* flags */
+    uint8_t fds_free_words[2]; /* saturated */
+    uint8_t actuations[4];
+    uint8_t drops[2];          /* ADV/accept FIFO drops (saturated) */
+    uint8_t lockouts[2];       /* rate limiter lockouts (saturated) */
+    uint8_t digest[4];         /* gd_health_calc_digest() of the octets above */
+} gd_ad_health_data_t;
+
+/* value of the length field of our AD structure (type octet + payload) */
+#define GD_AD_SERVICE_DATA_LEN (1 + sizeof(gd_ad_service_data_t))
+
+/* View of a single AD structure. The payload points into the report buffer. */
+typedef struct {
+    uint8_t type;
+    uint8_t len; /* payload length, excluding the type octet */
+    const uint8_t *payload;
+} gd_ad_struct_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t ndx;
+    bool malformed; /* set if iteration stopped at an invalid length field */
+} gd_ad_iter_t;
+
+static inline void gd_ad_iter_init(gd_ad_iter_t *it, const uint8_t *data, size_t len) {
+    it->data = data;
+    it->len = len;
+    it->ndx = 0;
+    it->malformed = false;
+}
+
+/** Get the next AD structure.
+ * The length field is validated against the report length, so the returned
+ * payload can be accessed without further bounds checks.
+ * Returns false at the end of the data or at the first invalid length field.
+ */
+bool gd_ad_iter_next(gd_ad_iter_t *it, gd_ad_struct_t *ads);
+
+/** Typed view of a Service Data - 128-bit UUID structure.
+ * Returns NULL if the structure is not of that type or has another length.
+ * Type and length are checked first, so the other structures of a report
+ * are skipped at the cost of one comparison each.
+ */
+static inline const gd_ad_service_data_t *gd_ad_as_service_data(const gd_ad_struct_t *ads) {
+    if (ads->type == AD_TYPE_SERVICE_DATA128 &&
+        ads->len == sizeof(gd_ad_service_data_t)) {
+        return (const gd_ad_service_data_t *)ads->payload;
+    }
+    return NULL;
+}
+
+#endif
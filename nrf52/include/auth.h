@@ -0,0 +1,51 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Message authentication
+ */
+
+#ifndef __AUTH_H__
+#define __AUTH_H__
+
+#include <adv_data.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define GD_TX_KEY_SIZE 32
+
+/* first octet of the HMAC input of acknowledgements, so that an
+ * acknowledgement digest never equals the digest of a command */
+#define GD_ACK_MARKER 0xac
+
+/* HMAC input for the derivation of the health beacon key; it is shorter
+ * than a UUID, so the key never equals a transmitter key */
+#define GD_HEALTH_KEY_LABEL "health"
+
+/* calculate transmitter key from transmitter UUID */
+void gd_calculate_tx_key(const ble_uuid128_t *tx_uuid, uint8_t key[GD_TX_KEY_SIZE]);
+
+/* check the digest of a message using the transmitter key */
+bool gd_msg_check_digest(const uint8_t key[GD_TX_KEY_SIZE], const gd_message_t *msg);
+
+/* calculate the digest of an acknowledgement (first four octets of
+ * HMAC-SHA256(key, GD_ACK_MARKER || seq_no)) */
+void gd_ack_calc_digest(const uint8_t key[GD_TX_KEY_SIZE],
+                        const uint8_t seq_no[3],
+                        uint8_t digest[4]);
+
+/* calculate the key of the health beacon
+ * (HMAC-SHA256(rxm_key, GD_HEALTH_KEY_LABEL)) */
+void gd_calculate_health_key(uint8_t key[GD_TX_KEY_SIZE]);
+
+/* calculate the digest of a health beacon (first four octets of
+ * HMAC-SHA256(key, data)) */
+void gd_health_calc_digest(const uint8_t key[GD_TX_KEY_SIZE],
+                           const uint8_t *data, size_t len,
+                           uint8_t digest[4]);
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Interrupt driven button handling
+ */
+
+#ifndef __BUTTON_H__
+#define __BUTTON_H__
+
+#ifndef GD_BUTTON_DEBOUNCE_MS
+#define GD_BUTTON_DEBOUNCE_MS 20
+#endif
+
+/* minimum press duration for GD_BUTCMD_LEARN */
+#ifndef GD_BUTTON_SHORT_MS
+#define GD_BUTTON_SHORT_MS 100
+#endif
+
+/* press duration for GD_BUTCMD_CLEAR */
+#ifndef GD_BUTTON_LONG_MS
+#define GD_BUTTON_LONG_MS 5000
+#endif
+
+typedef enum {
+    GD_BUTCMD_NONE,
+    GD_BUTCMD_LEARN,
+    GD_BUTCMD_CLEAR,
+    GD_BUTCMD_CONSUMED, /* to indicate that command value was read */
+} gd_button_cmd_t;
+
+/** Initialize the button. The HAL timers (app_timer) must be initialized
+ * before.
+ */
+void gd_button_init(void);
+
+/** Get a button command. Each command is returned once. No further command
+ * is generated until the button has been released.
+ */
+gd_button_cmd_t gd_get_button(void);
+
+#endif
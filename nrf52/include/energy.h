@@ -0,0 +1,54 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Activity accounting for the energy model
+ *
+ * Collects the time spent in each power relevant state since startup:
+ * CPU sleeping and active, scanner enabled (the radio receives for
+ * window / interval of that time), flash write (words written) and erase,
+ * relay on, HFXO running for the relay pulse timers and advertising events.
+ * energy_model.py turns a snapshot into an average current and a projected
+ * battery life.
+ */
+
+#ifndef __ENERGY_H__
+#define __ENERGY_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    uint64_t uptime_us;
+    uint64_t sleep_us;         /* CPU sleeping (System ON idle) */
+    uint64_t scan_us;          /* scanner enabled */
+    uint32_t scan_interval_us; /* configured scan interval */
+    uint32_t scan_window_us;   /* configured scan window */
+    uint32_t flash_words;      /* words written to flash */
+    uint64_t flash_erase_us;   /* partial page erases */
+    uint64_t relay_us;         /* relay on (sum over all outputs) */
+    uint64_t hfxo_us;          /* HFXO requested by the relay driver (a pulse is running) */
+    uint32_t adv_events;       /* advertising events (acknowledgements and beacons) */
+} gd_energy_t;
+
+void gd_energy_init(void);
+
+/** Set the scan parameters (in units of 0.625 ms)
+ */
+void gd_energy_scan_config(uint16_t interval, uint16_t window);
+
+/** Record that the scanner has been started or stopped (may be called
+ * from interrupt context)
+ */
+void gd_energy_scan(bool on);
+
+void gd_energy_get(gd_energy_t *energy);
+
+/** Log a snapshot (parsed by energy_model.py)
+ */
+void gd_energy_log(void);
+
+#endif
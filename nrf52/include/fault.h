@@ -0,0 +1,79 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Fault recording and recovery
+ *
+ * On a fatal error the system is reset immediately instead of waiting for
+ * the watchdog. A compact fault record is kept in a RAM section that is not
+ * initialized by the startup code, reported after the reset and aggregated
+ * into crash counters. The retained data survive resets but not a power
+ * loss.
+ */
+
+#ifndef __FAULT_H__
+#define __FAULT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* fault ID for hard faults (the other IDs are NRF_FAULT_ID_*) */
+#define GD_FAULT_ID_HARDFAULT 0x8001
+
+/* reset reasons (gd_fault_get_reset_reason()) */
+#define GD_FAULT_RESET_PIN    0x01
+#define GD_FAULT_RESET_DOG    0x02
+#define GD_FAULT_RESET_SREQ   0x04
+#define GD_FAULT_RESET_LOCKUP 0x08
+#define GD_FAULT_RESET_WAKEUP 0x10 /* wakeup from System OFF */
+
+typedef struct {
+    uint32_t id;       /* NRF_FAULT_ID_* or GD_FAULT_ID_* */
+    uint32_t pc;
+    uint32_t info;     /* error info or LR for hard faults */
+    uint32_t uptime_s; /* time since startup */
+    uint8_t last_evt;  /* last scheduler event started (gd_evt_t) */
+} gd_fault_t;
+
+typedef struct {
+    uint32_t sd_asserts;      /* NRF_FAULT_ID_SD_ASSERT */
+    uint32_t app_errors;      /* NRF_FAULT_ID_SDK_ERROR and NRF_FAULT_ID_SDK_ASSERT */
+    uint32_t hardfaults;      /* GD_FAULT_ID_HARDFAULT */
+    uint32_t other;           /* other fault IDs */
+    uint32_t watchdog;        /* watchdog resets */
+    uint32_t recovery_max_us; /* longest time from a fault reset to scanning */
+} gd_fault_counters_t;
+
+/** Evaluate the reset reason and the retained fault record. Must be called
+ * before the SoftDevice is enabled.
+ */
+void gd_fault_init(void);
+
+/** Get the fault record of the last reset.
+ * Returns false if the last reset was not caused by a fault.
+ */
+bool gd_fault_get_last(gd_fault_t *fault);
+
+void gd_fault_get_counters(gd_fault_counters_t *counters);
+
+/** Get the reasons of the last reset (GD_FAULT_RESET_*)
+ */
+uint32_t gd_fault_get_reset_reason(void);
+
+/** To be called when the system is operational again (scanning). Records
+ * the recovery time after a fault reset.
+ */
+void gd_fault_recovered(void);
+
+/** Log the fault record of the last reset and the crash counters
+ */
+void gd_fault_log(void);
+
+/** Record a fault and reset the system
+ */
+void gd_fault_reset(uint32_t id, uint32_t pc, uint32_t info) __attribute__((noreturn));
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * fstorage backend with sliced page erase
+ *
+ * A page erase stalls the CPU for about 85 ms on the nRF52832. This backend
+ * replaces nrf_fstorage_sd (and provides the nrf_fstorage_sd symbol used by
+ * FDS). Writes are passed to the SoftDevice. Pages are erased by a sequence
+ * of NVMC partial erases (ERASEPAGEPARTIAL), each executed in its own radio
+ * timeslot, so radio and application work can run between the slices.
+ */
+
+#ifndef __FLASH_H__
+#define __FLASH_H__
+
+#include <stdint.h>
+
+/* duration of a single partial erase */
+#ifndef GDS_ERASE_SLICE_MS
+#define GDS_ERASE_SLICE_MS 10
+#endif
+
+/* accumulated partial erase time required to erase a page
+ * (tERASEPAGEPARTIAL,acc of the nRF52832) */
+#define GDS_ERASE_TIME_MS 85
+
+/* bin n counts durations shorter than 2^n ms, the last bin all longer ones */
+#define GDS_STALL_HIST_BINS 8
+
+typedef struct {
+    uint32_t pages;        /* pages erased */
+    uint32_t slices;       /* partial erases executed */
+    uint32_t blocked;      /* timeslot requests blocked or cancelled */
+    uint32_t stall_max_us; /* longest partial erase */
+    uint32_t words_written;
+    uint64_t erase_us;     /* total partial erase time */
+    uint32_t stall_hist[GDS_STALL_HIST_BINS];
+    /* latency from the advertising report to the actuation of commands
+     * during which partial erases ran */
+    uint32_t act_count;
+    uint32_t act_max_us;
+    uint32_t act_hist[GDS_STALL_HIST_BINS];
+} gds_flash_stats_t;
+
+/** Get the number of partial erases executed so far
+ */
+uint32_t gds_flash_erase_count(void);
+
+/** Record the latency of an actuation. erase_count is the value of
+ * gds_flash_erase_count() at the time of the advertising report; the latency
+ * is only recorded if partial erases ran in between.
+ */
+void gds_flash_record_actuation(uint32_t latency_us, uint32_t erase_count);
+
+/** Get erase statistics
+ */
+void gds_flash_get_stats(gds_flash_stats_t *stats);
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Hardware abstraction layer
+ *
+ * The receiver pipeline (receiver.c, storage.c, actuator.c, scheduler.c,
+ * systime.c) and the LED, button, health and energy modules use the hardware
+ * through these functions only, so that they can be built for the nRF52
+ * (hal_nrf52.c) and for a Linux host (host/hal_host.c, see host/sim.c).
+ * Flash is accessed through the FDS API, which the host build implements in
+ * RAM (host/sdk/fds.c).
+ *
+ * Errors of the underlying drivers are fatal (APP_ERROR_CHECK).
+ */
+
+#ifndef __HAL_H__
+#define __HAL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* low frequency counter (RTC1 of app_timer, prescaler 1; checked against
+ * APP_TIMER_CONFIG_RTC_FREQUENCY in hal_nrf52.c) */
+#define GD_HAL_COUNTER_FREQ 16384
+#define GD_HAL_COUNTER_MASK 0x00ffffff
+
+/* number of timers that can be created */
+#ifndef GD_HAL_TIMER_COUNT
+#define GD_HAL_TIMER_COUNT 12
+#endif
+
+/* number of input pins with an edge handler */
+#ifndef GD_HAL_GPIO_INPUT_COUNT
+#define GD_HAL_GPIO_INPUT_COUNT 1
+#endif
+
+typedef unsigned gd_hal_timer_t;
+typedef void (*gd_hal_timer_handler_t)(void *context);
+
+typedef enum {
+    GD_HAL_PULL_NONE,
+    GD_HAL_PULL_DOWN,
+    GD_HAL_PULL_UP,
+} gd_hal_pull_t;
+
+/* edge handler of an input pin (interrupt context) */
+typedef void (*gd_hal_gpio_handler_t)(uint32_t pin);
+
+/* length of a device address */
+#define GD_HAL_ADDR_LEN 6
+
+/* advertising report handler (interrupt context), addr is the advertiser's
+ * device address (GD_HAL_ADDR_LEN bytes) */
+typedef void (*gd_hal_radio_handler_t)(const uint8_t *addr, const uint8_t *data, size_t len,
+                                       int8_t rssi);
+
+/** Get the counter value (GD_HAL_COUNTER_MASK bits, wraps around)
+ */
+uint32_t gd_hal_counter(void);
+
+/** Enter a critical region (nestable). Returns the state to be passed to
+ * gd_hal_critical_exit().
+ */
+uint32_t gd_hal_critical_enter(void);
+void gd_hal_critical_exit(uint32_t state);
+
+#define GD_HAL_CRITICAL_ENTER() \
+    {                           \
+        uint32_t gd_hal_critical_state = gd_hal_critical_enter();
+
+#define GD_HAL_CRITICAL_EXIT()                      \
+        gd_hal_critical_exit(gd_hal_critical_state); \
+    }
+
+/** Create a timer. The handler is called from interrupt context.
+ */
+void gd_hal_timer_create(gd_hal_timer_t *timer, bool repeated,
+                         gd_hal_timer_handler_t handler);
+
+/** Start a timer; the context is passed to the handler. A running timer is
+ * not restarted.
+ */
+void gd_hal_timer_start(gd_hal_timer_t timer, uint32_t ms, void *context);
+
+void gd_hal_timer_stop(gd_hal_timer_t timer);
+
+/** Configure a pin as output and set its level
+ */
+void gd_hal_gpio_output(uint32_t pin, bool level);
+
+/** Same as gd_hal_gpio_output() with high drive strength (e.g. for an LED)
+ */
+void gd_hal_gpio_output_high_drive(uint32_t pin, bool level);
+
+void gd_hal_gpio_write(uint32_t pin, bool level);
+
+bool gd_hal_gpio_get_output(uint32_t pin);
+
+/** Configure a pin as input. The handler is called on both edges; the edges
+ * are detected by the low power sense mechanism, so the handler has to read
+ * the level (debouncing).
+ */
+void gd_hal_gpio_input(uint32_t pin, gd_hal_pull_t pull, gd_hal_gpio_handler_t handler);
+
+bool gd_hal_gpio_read(uint32_t pin);
+
+/** Sleep until an interrupt occurred
+ */
+void gd_hal_sleep(void);
+
+/** Initialize the radio. The handler is called for each advertising report
+ * while scanning.
+ */
+void gd_hal_radio_init(gd_hal_radio_handler_t handler);
+
+/** Start scanning. Scanning continues after each report until
+ * gd_hal_scan_stop() is called. May be called from interrupt context.
+ */
+void gd_hal_scan_start(void);
+
+void gd_hal_scan_stop(void);
+
+#endif
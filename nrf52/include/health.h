@@ -0,0 +1,82 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Health telemetry beacon
+ *
+ * Every GD_HEALTH_INTERVAL_MS the receiver advertises a short burst of
+ * non-connectable advertisements with a health summary (gd_ad_health_data_t):
+ * uptime, reset reason, free FDS words, actuation, drop and lockout
+ * counters. The summary is authenticated with a key derived from the
+ * Receiver Master Key (gd_calculate_health_key()); health_decode.py verifies
+ * and decodes it.
+ *
+ * The burst is deferred while transmitters are active (garage door
+ * advertisements received within GD_HEALTH_QUIET_MS) or an acknowledgement
+ * is running, so it does not take radio time from the scanner when it
+ * matters. A burst of GD_HEALTH_ADV_EVENTS takes about 1 ms of airtime per
+ * advertising event.
+ */
+
+#ifndef __HEALTH_H__
+#define __HEALTH_H__
+
+#include <stdint.h>
+
+#ifndef GD_HEALTH_INTERVAL_MS
+#define GD_HEALTH_INTERVAL_MS (60 * 1000)
+#endif
+
+/* advertising events per burst and their interval */
+#ifndef GD_HEALTH_ADV_EVENTS
+#define GD_HEALTH_ADV_EVENTS 3
+#endif
+#ifndef GD_HEALTH_ADV_INTERVAL_MS
+#define GD_HEALTH_ADV_INTERVAL_MS 100
+#endif
+
+/* the burst is deferred until no garage door advertisement was received
+ * for that time, but at most GD_HEALTH_MAX_DEFER times */
+#ifndef GD_HEALTH_QUIET_MS
+#define GD_HEALTH_QUIET_MS 2000
+#endif
+#ifndef GD_HEALTH_MAX_DEFER
+#define GD_HEALTH_MAX_DEFER 10
+#endif
+
+/* company ID 0xffff is reserved for tests and never assigned */
+#define GD_HEALTH_COMPANY_ID 0xffff
+#define GD_HEALTH_MARKER     0x67
+#define GD_HEALTH_VERSION    1
+
+/* reset reason flags */
+#define GD_HEALTH_RESET_PIN    0x01
+#define GD_HEALTH_RESET_DOG    0x02
+#define GD_HEALTH_RESET_SREQ   0x04
+#define GD_HEALTH_RESET_LOCKUP 0x08
+#define GD_HEALTH_RESET_WAKEUP 0x10 /* wakeup from System OFF */
+#define GD_HEALTH_RESET_FAULT  0x80 /* fault record present (see fault.h) */
+
+typedef struct {
+    uint32_t beacons;    /* bursts started */
+    uint32_t deferred;   /* bursts deferred due to activity */
+    uint32_t adv_events; /* completed advertising events */
+    uint32_t airtime_us; /* radio transmit time of the completed events */
+} gd_health_stats_t;
+
+/** Derive the key and start the beacon timer. Posts GD_EVT_HEALTH.
+ */
+void gd_health_init(void);
+
+/** Handler of GD_EVT_HEALTH
+ */
+void gd_health_evt_handler(void);
+
+void gd_health_get_stats(gd_health_stats_t *stats);
+
+void gd_health_log(void);
+
+#endif
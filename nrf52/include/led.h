@@ -0,0 +1,46 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Non-blocking LED pattern sequencer
+ *
+ * A pattern is played by a single shot timer, so the main loop is never
+ * blocked. When no pattern is playing, the LED shows a base state.
+ */
+
+#ifndef __LED_H__
+#define __LED_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    uint16_t on_ms;
+    uint16_t off_ms;
+    uint16_t count; /* number of on/off periods, 0: until stopped */
+} gd_led_pattern_t;
+
+void gd_led_init(void);
+
+/** Play a pattern, replacing the currently playing one.
+ */
+void gd_led_play(const gd_led_pattern_t *pattern);
+
+/** Stop the pattern and show the base state
+ */
+void gd_led_stop(void);
+
+/** Stop the pattern only if it is still playing (and has not been replaced)
+ */
+void gd_led_stop_pattern(const gd_led_pattern_t *pattern);
+
+bool gd_led_is_playing(void);
+
+/** Set the state shown while no pattern is playing
+ */
+void gd_led_set_base(bool on);
+
+#endif
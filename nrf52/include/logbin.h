@@ -0,0 +1,84 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Binary dictionary based log backend
+ *
+ * Alternative to the text UART backend of nrf_log. Instead of formatting a log
+ * entry, the address of its format string and the raw arguments are sent as
+ * a compact binary frame. The format strings are taken from the ELF file at
+ * build time (logdict.py extract) and the host tool (logdict.py decode)
+ * reconstructs the text output. Frames are sent from a transmit ring buffer
+ * by non-blocking nrf_drv_uart_tx() calls, so the log call does not wait for
+ * the UART. With this sdk_config.h (UART_EASY_DMA_SUPPORT 0), the driver uses
+ * the legacy UART with one interrupt per byte; the CPU time thus still grows
+ * with the number of bytes sent.
+ *
+ * The UART output of both backends is counted by the host simulation (log
+ * line of gd_sim). This is a byte count, not CPU time: the CPU time spent in
+ * NRF_LOG_PROCESS() is reported by prof "log" on the target and has not been
+ * measured yet.
+ *
+ * Frame (COBS encoded, terminated by a zero byte):
+ *
+ *     u8  type << 6 | severity << 3 | nargs
+ *     u8  module ID
+ *     std:     u24 format string address, nargs * u32 arguments; a string
+ *              argument not located in flash is followed by its characters
+ *              (NUL terminated)
+ *     hexdump: u8 length, data
+ *     dropped: u16 number of entries dropped by nrf_log
+ */
+
+#ifndef __LOGBIN_H__
+#define __LOGBIN_H__
+
+#include <stdint.h>
+
+/* off by default; enabled by make LOGBIN=1, which also builds the
+ * dictionary (logdict.py extract) */
+#ifndef GD_LOGBIN_ENABLED
+#define GD_LOGBIN_ENABLED 0
+#endif
+
+#ifndef GD_LOGBIN_TX_BUFSIZE
+#define GD_LOGBIN_TX_BUFSIZE 512
+#endif
+
+/* longest string argument copied into a frame */
+#define GD_LOGBIN_MAX_STR 32
+
+/* largest hexdump chunk per frame */
+#define GD_LOGBIN_HEXDUMP_CHUNK 64
+
+#define GD_LOGBIN_TYPE_STD     1
+#define GD_LOGBIN_TYPE_HEXDUMP 2
+#define GD_LOGBIN_TYPE_DROPPED 3
+
+typedef struct {
+    uint32_t frames;  /* frames queued */
+    uint32_t bytes;   /* bytes queued (after encoding) */
+    uint32_t overrun; /* frames dropped because the transmit buffer was full */
+} gd_logbin_stats_t;
+
+#if GD_LOGBIN_ENABLED
+
+/** Initialize the UART and register the backend (instead of
+ * NRF_LOG_DEFAULT_BACKENDS_INIT())
+ */
+void gd_logbin_init(void);
+
+void gd_logbin_get_stats(gd_logbin_stats_t *stats);
+
+void gd_logbin_log(void);
+
+#else
+
+static inline void gd_logbin_log(void) {}
+
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * RAM usage and stack high-water mark
+ *
+ * The unused part of the stack is painted with a pattern at startup. The
+ * high-water mark is the deepest word that no longer holds the pattern; it
+ * includes the interrupt handlers and the SoftDevice, which share the main
+ * stack. The heap high-water mark is the extent of the heap break. The RAM
+ * reserved for the SoftDevice by the linker script is compared with the
+ * minimum that sd_ble_enable() reports for the configuration. The
+ * breakdown of the static RAM per module is given by ram_report.py from the
+ * linker map.
+ */
+
+#ifndef __MEMSTAT_H__
+#define __MEMSTAT_H__
+
+#include <stdint.h>
+
+/* a stack reserve below this is reported as a warning */
+#ifndef GD_MEM_STACK_WARN_BYTES
+#define GD_MEM_STACK_WARN_BYTES 1024
+#endif
+
+typedef struct {
+    uint32_t sd_bytes;     /* reserved for the SoftDevice */
+    uint32_t sd_required;  /* needed by the SoftDevice (0 if not enabled yet) */
+    uint32_t static_bytes; /* .data, .bss and the other static sections */
+    uint32_t heap_size;
+    uint32_t heap_used;    /* high-water mark */
+    uint32_t stack_size;
+    uint32_t stack_used;   /* high-water mark */
+} gd_mem_stats_t;
+
+/** Paint the unused stack. Must be called first in main().
+ */
+void gd_mem_init(void);
+
+/** Record the application RAM start required by the SoftDevice as returned
+ * by sd_ble_enable()
+ */
+void gd_mem_set_sd_ram_start(uint32_t ram_start);
+
+void gd_mem_get_stats(gd_mem_stats_t *stats);
+
+void gd_mem_log(void);
+
+#endif
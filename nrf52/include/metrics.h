@@ -0,0 +1,97 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Metrics registry
+ *
+ * All metrics are defined at compile time by GD_METRICS below and stored in
+ * a static array. Updates are atomic and may be done from interrupt or main
+ * context. A snapshot of all metrics is encoded into a binary frame that is
+ * written to the log as hex dump; metrics_decode.py decodes it on the host
+ * (it reads the metric definitions from this file).
+ *
+ * Frame (little endian):
+ *   u8  GD_METRICS_FRAME_TYPE
+ *   u8  GD_METRICS_FRAME_VERSION
+ *   u16 frame length in bytes
+ *   u16 snapshot sequence number
+ *   u32 uptime in s
+ *   u8  number of metrics
+ *   per metric: u8 id, u8 type, then
+ *       counter, gauge: u32 value
+ *       histogram:      u8 number of bins, u32 count per bin
+ */
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* histogram bin n counts values < 2^n, the last bin all larger ones */
+#define GD_METRIC_HIST_BINS 8
+
+#define GD_METRICS_FRAME_TYPE    0x4d
+#define GD_METRICS_FRAME_VERSION 1
+
+/* X(id, kind, name) */
+#define GD_METRICS(X)                                   \
+    X(PKT_PARSED,       COUNTER,   "packets_parsed")    \
+    X(PKT_REJECTED,     COUNTER,   "packets_rejected")  \
+    X(FIFO_DROPS,       COUNTER,   "fifo_drops")        \
+    X(THROTTLED,        COUNTER,   "throttled")         \
+    X(DIGEST_FAILURES,  COUNTER,   "digest_failures")   \
+    X(REPLAYS_REJECTED, COUNTER,   "replays_rejected")  \
+    X(NOT_PERMITTED,    COUNTER,   "not_permitted")     \
+    X(ACTUATIONS,       COUNTER,   "actuations")        \
+    X(FLASH_OPS,        COUNTER,   "flash_ops")         \
+    X(FLASH_FAILURES,   COUNTER,   "flash_failures")    \
+    X(GC_RUNS,          COUNTER,   "gc_runs")           \
+    X(LOCKOUTS,         COUNTER,   "lockouts")          \
+    X(FLASH_PENDING,    GAUGE,     "flash_pending")     \
+    X(FLASH_LATENCY_MS, HISTOGRAM, "flash_latency_ms")  \
+    X(ACT_DELAY_MS,     HISTOGRAM, "act_delay_ms")
+
+typedef enum {
+    GD_METRIC_TYPE_COUNTER,
+    GD_METRIC_TYPE_GAUGE,
+    GD_METRIC_TYPE_HISTOGRAM,
+} gd_metric_type_t;
+
+typedef enum {
+#define GD_METRIC_ID(id, kind, name) GD_METRIC_##id,
+    GD_METRICS(GD_METRIC_ID)
+#undef GD_METRIC_ID
+    GD_METRIC_COUNT,
+} gd_metric_t;
+
+/** Increment a counter
+ */
+void gd_metric_inc(gd_metric_t id);
+
+void gd_metric_add(gd_metric_t id, uint32_t n);
+
+/** Set a gauge
+ */
+void gd_metric_set(gd_metric_t id, uint32_t value);
+
+/** Add a value to a histogram
+ */
+void gd_metric_observe(gd_metric_t id, uint32_t value);
+
+/** Get the value of a counter or gauge
+ */
+uint32_t gd_metric_get(gd_metric_t id);
+
+/** Encode a snapshot. Returns the frame length or 0 if buf is too small.
+ */
+size_t gd_metrics_encode(uint8_t *buf, size_t size);
+
+/** Write a snapshot frame to the log
+ */
+void gd_metrics_log(void);
+
+#endif
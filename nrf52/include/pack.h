@@ -0,0 +1,32 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Little endian encoding of binary frames (metrics, trace, binary log)
+ *
+ * Each function stores a value at p and returns the position after it.
+ */
+
+#ifndef __PACK_H__
+#define __PACK_H__
+
+#include <stdint.h>
+
+static inline uint8_t *gd_put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static inline uint8_t *gd_put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Profiling of hot paths
+ *
+ * GD_PROF_SCOPE(id) at the beginning of a function measures the time until
+ * the function returns (by any path). On the target, the time is measured in
+ * CPU cycles by the DWT cycle counter, on other hosts in nanoseconds by the
+ * monotonic clock. Each ID must be used from one execution context only
+ * (main loop or one interrupt priority); the statistics are not locked.
+ */
+
+#ifndef __PROF_H__
+#define __PROF_H__
+
+#include <stdint.h>
+
+#ifndef GD_PROF_ENABLED
+#define GD_PROF_ENABLED 1
+#endif
+
+typedef enum {
+    GD_PROF_TX_KEY,     /* gd_calculate_tx_key() */
+    GD_PROF_DIGEST,     /* gd_msg_check_digest() */
+    GD_PROF_ADV_REPORT, /* handle_adv_report() */
+    GD_PROF_TX_REC,     /* gds_get_tx_rec() */
+    GD_PROF_SET_SEQ_NO, /* gds_set_seq_no() */
+    GD_PROF_LOG,        /* NRF_LOG_PROCESS() */
+    GD_PROF_HEALTH,     /* building the health beacon */
+    GD_PROF_COUNT,
+} gd_prof_id_t;
+
+typedef struct {
+    uint32_t calls;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+} gd_prof_stats_t;
+
+#if GD_PROF_ENABLED
+
+typedef struct {
+    gd_prof_id_t id;
+    uint32_t start;
+} gd_prof_scope_t;
+
+#define GD_PROF_SCOPE(id)                                                    \
+    gd_prof_scope_t gd_prof_scope __attribute__((cleanup(gd_prof_scope_end))) \
+        = {(id), gd_prof_now()}
+
+void gd_prof_init(void);
+
+/** Get the current time in profiling units (cycles or ns)
+ */
+uint32_t gd_prof_now(void);
+
+void gd_prof_scope_end(gd_prof_scope_t *scope);
+
+void gd_prof_get_stats(gd_prof_id_t id, gd_prof_stats_t *stats);
+
+void gd_prof_reset(void);
+
+/** Log the statistics of all IDs
+ */
+void gd_prof_log(void);
+
+#else
+
+#define GD_PROF_SCOPE(id) do {} while (0)
+
+static inline void gd_prof_init(void) {}
+static inline void gd_prof_log(void) {}
+
+#endif
+
+#endif
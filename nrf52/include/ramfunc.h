@@ -0,0 +1,35 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Code and constants executed from RAM
+ *
+ * Functions of the critical path (reception of advertising reports,
+ * actuation, relay control and the state timers of the actuator) are placed
+ * in the .ramfunc section. The linker script locates it in RAM between .data
+ * and .bss, so the startup code loads it together with .data. Calls between
+ * RAM and flash exceed the branch range; the linker inserts veneers for them.
+ *
+ * This does not remove the CPU stall of a flash page erase: the vector table,
+ * the SDK (app_timer, nrfx_timer, nrf_atfifo) and the SoftDevice execute from
+ * flash, so an interrupt raised during an erase is still served after it. It
+ * only keeps flash accesses off the path once it runs (no wait states or
+ * cache misses) and lets a handler that is already running finish.
+ */
+
+#ifndef __RAMFUNC_H__
+#define __RAMFUNC_H__
+
+#if defined(__arm__)
+#define GD_RAMFUNC __attribute__((section(".ramfunc")))
+#define GD_RAMDATA __attribute__((section(".ramdata")))
+#else
+/* host build (see host/Makefile) */
+#define GD_RAMFUNC
+#define GD_RAMDATA
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Per-transmitter rate limiting of digest verification attempts
+ *
+ * Sources are only tracked after a failed digest check, so legitimate
+ * transmitters are never throttled. A source is the claimed UUID together with
+ * the advertiser address: forged commands for a UUID sent from another address
+ * do not throttle the transmitter owning the UUID. A tracked source gets a
+ * token bucket limiting its verification attempts and is blocked completely
+ * for a back-off time that doubles with each further failure.
+ *
+ * An attacker can rotate its random address, so each forged command may come
+ * from a new source. Digest failures of untracked sources therefore draw
+ * from a global token bucket; while it is empty, messages of untracked
+ * sources are dropped before verification. This bounds the guesses (and
+ * HMAC computations) to one per GD_RL_GLOBAL_REFILL_MS like the former
+ * global lockout, but only while failures occur.
+ */
+
+#ifndef __RATELIMIT_H__
+#define __RATELIMIT_H__
+
+#include <hal.h>
+
+#include <ble.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* number of sources that can be tracked at the same time */
+#ifndef GD_RL_TABLE_SIZE
+#define GD_RL_TABLE_SIZE 16
+#endif
+
+/* token bucket: burst size and refill interval (one token per interval) */
+#ifndef GD_RL_BURST
+#define GD_RL_BURST 4
+#endif
+#ifndef GD_RL_REFILL_MS
+#define GD_RL_REFILL_MS 1000
+#endif
+
+/* global token bucket for digest failures of untracked sources */
+#ifndef GD_RL_GLOBAL_BURST
+#define GD_RL_GLOBAL_BURST 8
+#endif
+#ifndef GD_RL_GLOBAL_REFILL_MS
+#define GD_RL_GLOBAL_REFILL_MS 1000
+#endif
+
+/* back-off after a failure: GD_RL_BACKOFF_BASE_MS << (failures - 1) */
+#ifndef GD_RL_BACKOFF_BASE_MS
+#define GD_RL_BACKOFF_BASE_MS 1000
+#endif
+#ifndef GD_RL_BACKOFF_MAX_SHIFT
+#define GD_RL_BACKOFF_MAX_SHIFT 6
+#endif
+
+/* sources not seen for that time may be evicted */
+#ifndef GD_RL_STALE_MS
+#define GD_RL_STALE_MS (10 * 60 * 1000)
+#endif
+
+typedef struct {
+    uint32_t throttled_packets; /* packets dropped before verification */
+    uint32_t throttled_sources; /* number of sources that became tracked */
+    uint32_t tracked_sources;   /* sources currently in the table */
+    uint32_t evictions;         /* non-stale entries evicted from a full table */
+    uint32_t global_throttled;  /* packets of untracked sources dropped (global
+                                   budget exhausted) */
+} gd_rl_stats_t;
+
+void gd_rl_init(void);
+
+/** Check whether a message of a source may be verified.
+ * Returns false if the message is to be dropped.
+ */
+bool gd_rl_allow(const ble_uuid128_t *uuid, const uint8_t *addr, uint32_t now_ms);
+
+/** Report a failed digest check of a source
+ */
+void gd_rl_report_failure(const ble_uuid128_t *uuid, const uint8_t *addr, uint32_t now_ms);
+
+/** Report a fresh command of a source (digest and sequence number valid)
+ */
+void gd_rl_report_success(const ble_uuid128_t *uuid, const uint8_t *addr);
+
+void gd_rl_get_stats(gd_rl_stats_t *stats);
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Receiver pipeline: advertising reports are queued in interrupt context
+ * (gd_rx_adv_report()) and verified, executed and persisted by the scheduler
+ * event handlers below. Hardware independent (see hal.h).
+ */
+
+#ifndef __RECEIVER_H__
+#define __RECEIVER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Stop scanning while a flash operation is pending so that the SoftDevice
+ * finds radio idle time to execute it. The scanner is restarted after the
+ * operation is completed or after GD_SCAN_GAP_MAX_MS at the latest. */
+#ifndef GD_SCAN_FLASH_GAP
+#define GD_SCAN_FLASH_GAP         1
+#endif
+#define GD_SCAN_GAP_MAX_MS        2000
+
+/** Initialize the receiver and start scanning. The radio (see
+ * gd_hal_radio_init()) and the storage must be initialized before.
+ */
+void gd_rx_init(void);
+
+/** Radio handler (gd_hal_radio_handler_t): queue an advertising report
+ */
+void gd_rx_adv_report(const uint8_t *addr, const uint8_t *data, size_t len, int8_t rssi);
+
+/** Enable or disable learning of new transmitters and outputs
+ */
+void gd_rx_set_learning(bool learning);
+
+/* scheduler event handlers */
+
+/** GD_EVT_ACCEPT: execute verified commands */
+void gd_rx_accept_evt_handler(void);
+
+/** GD_EVT_ADV: verify a queued report */
+void gd_rx_adv_evt_handler(void);
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Relay driver
+ *
+ * The relay pulse is generated in hardware: TIMER compare events are routed
+ * via PPI to the GPIOTE SET and CLR tasks of the relay pin. The CPU only
+ * starts the timer, so the pulse width does neither depend on interrupt
+ * latency nor on SoftDevice or flash activity. Each output channel has its
+ * own timer, so pulses on different channels may overlap.
+ */
+
+#ifndef __RELAY_H__
+#define __RELAY_H__
+
+#include <gd_config.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Output channel n uses TIMER n + 1 (TIMER0 is used by the SoftDevice and
+ * TIMER4 is left to the application), so up to three channels are
+ * supported */
+#if GD_RELAY_CHANNELS < 1 || GD_RELAY_CHANNELS > 3
+#error "GD_RELAY_CHANNELS must be between 1 and 3"
+#endif
+
+/* Output channel n uses the PPI channels GD_RELAY_PPI_CH_BASE + 2 * n and
+ * GD_RELAY_PPI_CH_BASE + 2 * n + 1 (the SoftDevice reserves channels 17 to
+ * 31) */
+#ifndef GD_RELAY_PPI_CH_BASE
+#define GD_RELAY_PPI_CH_BASE 0
+#endif
+
+/* Operations used by the actuator. Allows to replace the hardware driver
+ * by a simulation.
+ */
+typedef struct {
+    /* start a pulse of the given width on an output channel; returns false
+     * if a pulse is running on that channel */
+    bool (*pulse)(unsigned channel, uint32_t width_us);
+    /* check whether the relay of an output channel is switched on */
+    bool (*is_on)(unsigned channel);
+} gd_relay_driver_t;
+
+/* TIMER/PPI/GPIOTE based driver */
+extern const gd_relay_driver_t gd_relay_ppi_driver;
+
+/** Initialize the TIMER/PPI/GPIOTE driver. The SoftDevice must be enabled.
+ */
+void gd_relay_init(void);
+
+/* GPIO driver based on the HAL (see hal.h), used by the host simulator. The
+ * pulse width has the resolution of the HAL timers (1 ms). */
+extern const gd_relay_driver_t gd_relay_gpio_driver;
+
+void gd_relay_gpio_init(void);
+
+#endif
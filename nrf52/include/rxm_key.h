@@ -18,6 +18,6 @@
 
 #define GD_RXM_KEY_SIZE 20
 
-const uint8_t gd_rxm_key[GD_RXM_KEY_SIZE];
+extern const uint8_t gd_rxm_key[GD_RXM_KEY_SIZE];
 
 #endif
@@ -0,0 +1,101 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Cooperative priority scheduler for the main loop
+ *
+ * Interrupt handlers post events; the main loop runs the handlers of the
+ * pending events only and sleeps otherwise. Each event belongs to a priority
+ * class and the pending event of the highest class is run first. Handlers
+ * that wait for something (e.g. flash operations) call gd_sched_yield(),
+ * which runs pending events of higher classes in the meantime.
+ *
+ * The execution time of each handler, the worst-case latency (post to
+ * start) of each class and the idle time are recorded.
+ */
+
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* priority classes, highest first */
+typedef enum {
+    GD_PRIO_ACTUATION,
+    GD_PRIO_VERIFY,
+    GD_PRIO_STORAGE,
+    GD_PRIO_MAINT,
+    GD_PRIO_COUNT,
+} gd_prio_t;
+
+typedef enum {
+    GD_EVT_ACCEPT,  /* accepted command to be executed */
+    GD_EVT_ADV,     /* advertising data queued */
+    GD_EVT_BUTTON,  /* button command available */
+    GD_EVT_GC,      /* flash operation completed, check for garbage collection */
+    GD_EVT_STATS,   /* statistics interval elapsed */
+    GD_EVT_HEALTH,  /* health beacon due */
+    GD_EVT_COUNT,
+} gd_evt_t;
+
+typedef void (*gd_sched_handler_t)(void);
+
+/* time source in RTC ticks, replaceable by a simulated clock */
+typedef uint64_t (*gd_sched_clock_t)(void);
+
+typedef struct {
+    uint32_t runs;
+    uint32_t max_ticks; /* including higher classes run by gd_sched_yield() */
+    uint64_t total_ticks;
+} gd_sched_handler_stats_t;
+
+typedef struct {
+    uint32_t runs;
+    uint32_t max_latency_ticks; /* time from posting to the start of the handler */
+} gd_sched_class_stats_t;
+
+void gd_sched_init(gd_sched_clock_t clock);
+
+void gd_sched_register(gd_evt_t evt, gd_prio_t prio, const char *name,
+                       gd_sched_handler_t handler);
+
+/** Post an event (may be called from interrupt context)
+ */
+void gd_sched_post(gd_evt_t evt);
+
+/** Run the handlers of all pending events, highest class first
+ */
+void gd_sched_execute(void);
+
+/** Preemption point: run pending events of classes higher than the class of
+ * the calling handler. Nothing is run if called outside of a handler (e.g.
+ * during initialization). Returns false if no event was run.
+ */
+bool gd_sched_yield(void);
+
+/** Get the event whose handler was started last (GD_EVT_COUNT if none)
+ */
+gd_evt_t gd_sched_last_event(void);
+
+/** Sleep until the next interrupt
+ */
+void gd_sched_sleep(void);
+
+/** Get the total time spent sleeping since initialization
+ */
+uint64_t gd_sched_get_sleep_ticks(void);
+
+void gd_sched_get_handler_stats(gd_evt_t evt, gd_sched_handler_stats_t *stats);
+
+void gd_sched_get_class_stats(gd_prio_t prio, gd_sched_class_stats_t *stats);
+
+/** Log handler and class statistics, wakeups and idle time and start a new
+ * interval
+ */
+void gd_sched_log_stats(void);
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Main loop stall detector
+ *
+ * The duration of each main loop iteration (from wakeup to sleep) is
+ * recorded in a histogram. Blocking sections are marked by
+ * GD_STALL_SECTION(site); an iteration exceeding the stall budget is
+ * attributed to the section that took most of its time, or to the event
+ * handlers if no section dominates. Advertising reports received during the
+ * iteration are counted as delayed (queued) or dropped (FIFO full).
+ */
+
+#ifndef __STALL_H__
+#define __STALL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef GD_STALL_BUDGET_MS
+#define GD_STALL_BUDGET_MS 20
+#endif
+
+/* bin n counts iterations shorter than 2^n ms, the last bin all longer ones */
+#define GD_STALL_HIST_BINS 8
+
+typedef enum {
+    GD_STALL_SITE_HANDLER,    /* event handlers outside of marked sections */
+    GD_STALL_SITE_FLASH_WAIT, /* waiting for a flash operation */
+    GD_STALL_SITE_CLEAR,      /* clearing all transmitters */
+    GD_STALL_SITE_LOG,        /* log processing */
+    GD_STALL_SITE_COUNT,
+} gd_stall_site_t;
+
+typedef struct {
+    uint32_t stalls; /* over-budget iterations attributed to the site */
+    uint32_t max_us; /* longest time spent in the site within an iteration */
+} gd_stall_site_stats_t;
+
+typedef struct {
+    uint32_t iterations;
+    uint32_t stalls;           /* iterations exceeding the budget */
+    uint32_t max_us;           /* longest iteration */
+    uint32_t hist[GD_STALL_HIST_BINS];
+    uint32_t reports_delayed;  /* reports queued during stalls */
+    uint32_t reports_dropped;  /* reports dropped during stalls */
+    uint32_t reports_expected; /* reports expected during stalls at the mean rate */
+    gd_stall_site_stats_t sites[GD_STALL_SITE_COUNT];
+} gd_stall_stats_t;
+
+typedef struct {
+    gd_stall_site_t site;
+    uint64_t start;
+} gd_stall_section_t;
+
+#define GD_STALL_SECTION(site)                                                      \
+    gd_stall_section_t gd_stall_section __attribute__((cleanup(gd_stall_section_end))) \
+        = {(site), gd_stall_section_begin()}
+
+void gd_stall_init(void);
+
+/** Mark the beginning and the end of a main loop iteration
+ */
+void gd_stall_iter_begin(void);
+void gd_stall_iter_end(void);
+
+uint64_t gd_stall_section_begin(void);
+void gd_stall_section_end(gd_stall_section_t *section);
+
+/** Count an advertising report (called from interrupt context)
+ */
+void gd_stall_report(bool dropped);
+
+void gd_stall_get_stats(gd_stall_stats_t *stats);
+
+void gd_stall_log(void);
+
+#endif
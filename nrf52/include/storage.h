@@ -14,12 +14,36 @@
 #include <fds.h>
 #include <ble.h>
 
+/* number of transmitter records kept in RAM */
+#ifndef GDS_TX_CACHE_SIZE
+#define GDS_TX_CACHE_SIZE 16
+#endif
+
+typedef struct {
+    uint32_t ops;            /* completed flash operations */
+    uint32_t failures;       /* flash operations that failed or could not be queued */
+    uint32_t retries;        /* SoftDevice flash operations retried by the backend */
+    uint32_t latency_max_us; /* time from queueing to completion */
+    uint64_t latency_sum_us;
+} gds_stats_t;
+
+/* Called with busy = true before a flash operation is queued and with
+ * busy = false when it is completed. May be called from interrupt context.
+ */
+typedef void (*gds_busy_handler_t)(bool busy);
+
 ret_code_t gds_init(void);
 
-/* create a new TX record if it does not exist.
+/* create a new TX record if it does not exist or add output permissions
+ * (bit n: output channel n) to an existing one.
  * returns true on success (i.e. record exists or was successfully created)
  */
-bool gds_create_tx_record(const ble_uuid128_t *uuid);
+bool gds_create_tx_record(const ble_uuid128_t *uuid, uint32_t outputs);
+
+/** Get the output channels a transmitter is permitted to use
+ * Returns false if transmitter is unknown
+ */
+bool gds_get_tx_outputs(const ble_uuid128_t *uuid, uint32_t *outputs);
 
 /** Get stored sequence number of a specific transmitter
  * Sets *seq_no to zero if no sequence number record exists.
@@ -27,12 +51,13 @@ bool gds_create_tx_record(const ble_uuid128_t *uuid);
  */
 bool gds_get_seq_no(const ble_uuid128_t *uuid, uint32_t *seq_no);
 
-/** Set sequence number of specific transmitter.
- * returns false if transmitter is unknown
+/** Set sequence number of specific transmitter and wait until it is
+ * written to flash.
+ * returns false if transmitter is unknown or the write failed
  */
 bool gds_set_seq_no(const ble_uuid128_t *uuid, uint32_t seq_no);
 
-/** Run tasks (currently used for garbage collection)
+/** Run tasks (currently used for starting garbage collection)
  */
 void gds_tasks();
 
@@ -40,6 +65,20 @@ void gds_tasks();
  */
 void gds_clear(void);
 
+/** Set a handler to be notified about pending flash operations, e.g. to
+ * make room for the SoftDevice to schedule them.
+ */
+void gds_set_busy_handler(gds_busy_handler_t handler);
+
+/** Get flash operation statistics
+ */
+void gds_get_stats(gds_stats_t *stats);
+
+/** Get the number of flash words that can be written before a garbage
+ * collection is required
+ */
+bool gds_get_free_words(uint32_t *words);
+
 /** Dump the storage content to the debug log
  */
 void gds_dump_to_log(void);
@@ -0,0 +1,41 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * System time based on the low frequency counter of the HAL
+ */
+
+#ifndef __SYSTIME_H__
+#define __SYSTIME_H__
+
+#include <hal.h>
+
+#include <stdint.h>
+
+#define GD_TIME_TICKS_TO_MS(t) ((uint64_t)(t) * 1000 / GD_HAL_COUNTER_FREQ)
+#define GD_TIME_TICKS_TO_US(t) ((uint64_t)(t) * 1000000 / GD_HAL_COUNTER_FREQ)
+
+/** Initialize the system time. The HAL timers (app_timer) must be
+ * initialized before.
+ */
+void gd_time_init(void);
+
+/** Get counter ticks (GD_HAL_COUNTER_FREQ) since the counter was started
+ */
+uint64_t gd_time_ticks(void);
+
+/** Same as gd_time_ticks() for callers that have disabled interrupts, e.g.
+ * fault handlers (the critical region of gd_time_ticks() requires a
+ * SoftDevice call)
+ */
+uint64_t gd_time_ticks_locked(void);
+
+/** Get milliseconds since the RTC was started. Wraps around after 49 days, so
+ * compare time stamps by means of differences only.
+ */
+uint32_t gd_time_ms(void);
+
+#endif
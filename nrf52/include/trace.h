@@ -0,0 +1,84 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * End-to-end command latency tracing
+ *
+ * Each advertising report is time stamped on entry of the BLE event handler
+ * (the origin). The time stamp travels with the report through the
+ * pipeline, and each stage records its latency relative to the origin in a
+ * histogram. Time stamps are taken from the RTC (gd_hal_counter()), which
+ * runs anyway, so the resolution is one tick (about 61 us). The host
+ * simulator records the same stages and record.
+ *
+ * Binary record (little endian):
+ *   u8  GD_TRACE_RECORD_TYPE
+ *   u8  number of stages
+ *   per stage: u32 count, u32 p50_us, u32 p99_us, u32 max_us
+ * Percentiles are upper bounds of histogram bins (4 bins per octave).
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef GD_TRACE_ENABLED
+#define GD_TRACE_ENABLED 1
+#endif
+
+#define GD_TRACE_RECORD_TYPE 0x54
+
+typedef enum {
+    GD_TRACE_ENQUEUE,  /* put into the advertising report FIFO */
+    GD_TRACE_DEQUEUE,  /* taken from the FIFO by the verification handler */
+    GD_TRACE_VERIFIED, /* digest verified */
+    GD_TRACE_SEQ_NO,   /* stored sequence number looked up */
+    GD_TRACE_ACTUATE,  /* relay pulse started (not for coalesced presses) */
+    GD_TRACE_PERSIST,  /* sequence number written to flash */
+    GD_TRACE_STAGES,
+} gd_trace_stage_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+} gd_trace_summary_t;
+
+#define GD_TRACE_RECORD_SIZE (2 + GD_TRACE_STAGES * 4 * sizeof(uint32_t))
+
+#if GD_TRACE_ENABLED
+
+void gd_trace_init(void);
+
+/** Record the latency of a stage relative to an origin time stamp
+ * (gd_hal_counter() value)
+ */
+void gd_trace_mark(gd_trace_stage_t stage, uint32_t origin);
+
+void gd_trace_get_summary(gd_trace_stage_t stage, gd_trace_summary_t *summary);
+
+const char *gd_trace_stage_name(gd_trace_stage_t stage);
+
+/** Encode the binary record. Returns the length or 0 if buf is too small.
+ */
+size_t gd_trace_encode(uint8_t *buf, size_t size);
+
+/** Log the stage summaries and the binary record
+ */
+void gd_trace_log(void);
+
+#else
+
+static inline void gd_trace_init(void) {}
+static inline void gd_trace_mark(gd_trace_stage_t stage, uint32_t origin) {}
+static inline void gd_trace_log(void) {}
+
+#endif
+
+#endif
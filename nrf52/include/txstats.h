@@ -0,0 +1,86 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Per-transmitter activity statistics
+ *
+ * A RAM table with an entry per enrolled transmitter that was recently
+ * active. Entries are only allocated for transmitters having a record in
+ * flash; digest failures and dropped packets are only counted for
+ * transmitters that are already in the table. If the table is full, the
+ * entry seen least recently is replaced.
+ */
+
+#ifndef __TXSTATS_H__
+#define __TXSTATS_H__
+
+#include <ble.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef GD_TXS_TABLE_SIZE
+#define GD_TXS_TABLE_SIZE 16
+#endif
+
+/* weight of a new RSSI sample in the moving average: 2^-GD_TXS_EWMA_SHIFT */
+#define GD_TXS_EWMA_SHIFT 3
+
+typedef enum {
+    GD_TXS_DROPPED,        /* not verified (throttled) */
+    GD_TXS_DIGEST_FAILURE, /* digest check failed */
+    GD_TXS_ACCEPTED,       /* new sequence number */
+    GD_TXS_DUPLICATE,      /* repetition of the last accepted message */
+    GD_TXS_REPLAY,         /* sequence number older than the stored one */
+    GD_TXS_REJECTED,       /* command not permitted */
+} gd_txs_outcome_t;
+
+typedef struct {
+    ble_uuid128_t uuid;
+    uint32_t packets;         /* packets seen */
+    uint32_t accepted;
+    uint32_t duplicates;
+    uint32_t replays;
+    uint32_t digest_failures;
+    uint32_t rejected;
+    uint32_t last_gap;        /* last sequence number gap (1 if no press was lost) */
+    uint32_t last_seen;       /* ms */
+    int16_t rssi_avg;         /* moving average of the RSSI in 1/16 dBm */
+    int8_t rssi;              /* last RSSI (dBm) */
+} gd_txs_entry_t;
+
+typedef struct {
+    uint32_t entries;   /* entries in use */
+    uint32_t evictions; /* entries replaced in a full table */
+} gd_txs_stats_t;
+
+void gd_txs_init(void);
+
+/** Record the outcome of a packet of a transmitter
+ *
+ * seq_gap is the difference between the received and the stored sequence
+ * number and only used for accepted packets.
+ */
+void gd_txs_update(const ble_uuid128_t *uuid, gd_txs_outcome_t outcome, int8_t rssi,
+                   uint32_t seq_gap, uint32_t now_ms);
+
+/** Remove all entries (all transmitters deleted)
+ */
+void gd_txs_clear(void);
+
+/** Get the entry at the given table index
+ *
+ * Returns false if the index is out of range or the slot is unused.
+ */
+bool gd_txs_get(unsigned index, gd_txs_entry_t *entry);
+
+void gd_txs_get_stats(gd_txs_stats_t *stats);
+
+/** Log all entries in a single pass over the table
+ */
+void gd_txs_log(void);
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Non-blocking LED pattern sequencer
+ */
+
+#include <led.h>
+#include <gd_config.h>
+#include <hal.h>
+#include <ramfunc.h>
+
+static gd_hal_timer_t gd_led_timer;
+static const gd_led_pattern_t *volatile gd_led_pattern = NULL;
+static uint16_t gd_led_remaining; /* periods left including the current one */
+static bool gd_led_phase_on;
+static bool gd_led_base = false;
+
+GD_RAMFUNC static void gd_led_output(bool on) {
+    gd_hal_gpio_write(GD_PINNO_LED, on);
+}
+
+static void gd_led_start_timer(uint16_t ms) {
+    gd_hal_timer_start(gd_led_timer, ms, NULL);
+}
+
+static void gd_led_timer_handler(void *dummy) {
+    GD_HAL_CRITICAL_ENTER();
+    if (gd_led_pattern == NULL) {
+        /* stopped after the timer expired */
+    } else if (gd_led_phase_on) {
+        gd_led_phase_on = false;
+        gd_led_output(false);
+        gd_led_start_timer(gd_led_pattern->off_ms);
+    } else if (gd_led_pattern->count != 0 && --gd_led_remaining == 0) {
+        gd_led_pattern = NULL;
+        gd_led_output(gd_led_base);
+    } else {
+        gd_led_phase_on = true;
+        gd_led_output(true);
+        gd_led_start_timer(gd_led_pattern->on_ms);
+    }
+    GD_HAL_CRITICAL_EXIT();
+}
+
+void gd_led_init(void) {
+    gd_hal_gpio_output_high_drive(GD_PINNO_LED, false);
+    gd_hal_timer_create(&gd_led_timer, false, gd_led_timer_handler);
+}
+
+void gd_led_play(const gd_led_pattern_t *pattern) {
+    GD_HAL_CRITICAL_ENTER();
+    gd_hal_timer_stop(gd_led_timer);
+    gd_led_pattern = pattern;
+    gd_led_remaining = pattern->count;
+    gd_led_phase_on = true;
+    gd_led_output(true);
+    gd_led_start_timer(pattern->on_ms);
+    GD_HAL_CRITICAL_EXIT();
+}
+
+void gd_led_stop(void) {
+    GD_HAL_CRITICAL_ENTER();
+    gd_hal_timer_stop(gd_led_timer);
+    gd_led_pattern = NULL;
+    gd_led_output(gd_led_base);
+    GD_HAL_CRITICAL_EXIT();
+}
+
+void gd_led_stop_pattern(const gd_led_pattern_t *pattern) {
+    GD_HAL_CRITICAL_ENTER();
+    if (gd_led_pattern == pattern) {
+        gd_hal_timer_stop(gd_led_timer);
+        gd_led_pattern = NULL;
+        gd_led_output(gd_led_base);
+    }
+    GD_HAL_CRITICAL_EXIT();
+}
+
+bool gd_led_is_playing(void) {
+    return gd_led_pattern != NULL;
+}
+
+/* called by the actuator state timers, so kept in RAM */
+GD_RAMFUNC void gd_led_set_base(bool on) {
+    GD_HAL_CRITICAL_ENTER();
+    if (on != gd_led_base) {
+        gd_led_base = on;
+        if (gd_led_pattern == NULL) {
+            gd_led_output(on);
+        }
+    }
+    GD_HAL_CRITICAL_EXIT();
+}
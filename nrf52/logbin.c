@@ -0,0 +1,286 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Binary dictionary based log backend
+ */
+
+#include <logbin.h>
+#include <pack.h>
+
+#if GD_LOGBIN_ENABLED
+
+#include <app_error.h>
+#include <app_util_platform.h>
+#include <nrf_drv_uart.h>
+#include <nrf_log.h>
+#include <nrf_log_backend_interface.h>
+#include <nrf_log_internal.h>
+#include <nrf_memobj.h>
+#include <sdk_config.h>
+#include <string.h>
+
+/* strings below this address are in flash and resolved by the host */
+#define GD_LOGBIN_CODE_END 0x20000000UL
+
+#define GD_LOGBIN_RAW_MAX \
+    (5 + NRF_LOG_MAX_NUM_OF_ARGS * (sizeof(uint32_t) + GD_LOGBIN_MAX_STR + 1))
+/* COBS overhead: one byte per 254 bytes, the first code byte and the
+ * delimiter */
+#define GD_LOGBIN_FRAME_MAX (GD_LOGBIN_RAW_MAX + GD_LOGBIN_RAW_MAX / 254 + 2)
+
+static const nrf_drv_uart_t gd_logbin_uart = NRF_DRV_UART_INSTANCE(0);
+
+/* transmit ring; head is written by put(), tail by the UART interrupt */
+static uint8_t gd_logbin_ring[GD_LOGBIN_TX_BUFSIZE];
+static volatile uint16_t gd_logbin_head;
+static volatile uint16_t gd_logbin_tail;
+static volatile uint16_t gd_logbin_tx_len;
+static volatile bool gd_logbin_tx_busy;
+static bool gd_logbin_panic;
+
+static gd_logbin_stats_t gd_logbin_stats;
+
+static uint8_t gd_logbin_raw[GD_LOGBIN_RAW_MAX];
+static uint8_t gd_logbin_frame[GD_LOGBIN_FRAME_MAX];
+
+static void gd_logbin_uart_handler(nrf_drv_uart_event_t *p_event, void *p_context);
+
+static void gd_logbin_uart_init(bool async) {
+    nrf_drv_uart_config_t config = NRF_DRV_UART_DEFAULT_CONFIG;
+    config.pseltxd = NRF_LOG_BACKEND_UART_TX_PIN;
+    config.pselrxd = NRF_UART_PSEL_DISCONNECTED;
+    config.pselcts = NRF_UART_PSEL_DISCONNECTED;
+    config.pselrts = NRF_UART_PSEL_DISCONNECTED;
+    config.baudrate = (nrf_uart_baudrate_t)NRF_LOG_BACKEND_UART_BAUDRATE;
+    APP_ERROR_CHECK(nrf_drv_uart_init(&gd_logbin_uart, &config,
+                                      async ? gd_logbin_uart_handler : NULL));
+}
+
+/* Start the transfer of the next contiguous part of the ring. To be called
+ * from the UART interrupt or with interrupts disabled. */
+static void gd_logbin_start_tx(void) {
+    uint16_t head = gd_logbin_head;
+    uint16_t tail = gd_logbin_tail;
+    if (gd_logbin_tx_busy || head == tail) {
+        return;
+    }
+    uint16_t len = head > tail ? head - tail : GD_LOGBIN_TX_BUFSIZE - tail;
+    if (len > UINT8_MAX) {
+        len = UINT8_MAX;
+    }
+    gd_logbin_tx_busy = true;
+    gd_logbin_tx_len = len;
+    APP_ERROR_CHECK(nrf_drv_uart_tx(&gd_logbin_uart, &gd_logbin_ring[tail], len));
+}
+
+static void gd_logbin_uart_handler(nrf_drv_uart_event_t *p_event, void *p_context) {
+    if (p_event->type == NRF_DRV_UART_EVT_TX_DONE) {
+        gd_logbin_tail = (gd_logbin_tail + gd_logbin_tx_len) % GD_LOGBIN_TX_BUFSIZE;
+        gd_logbin_tx_busy = false;
+        gd_logbin_start_tx();
+    }
+}
+
+static void gd_logbin_send(const uint8_t *data, size_t len) {
+    if (gd_logbin_panic) {
+        /* blocking transfer */
+        while (len > 0) {
+            uint8_t n = len > UINT8_MAX ? UINT8_MAX : len;
+            nrf_drv_uart_tx(&gd_logbin_uart, data, n);
+            data += n;
+            len -= n;
+        }
+        return;
+    }
+    uint16_t head = gd_logbin_head;
+    size_t used = (head - gd_logbin_tail + GD_LOGBIN_TX_BUFSIZE) % GD_LOGBIN_TX_BUFSIZE;
+    if (len > GD_LOGBIN_TX_BUFSIZE - 1 - used) {
+        gd_logbin_stats.overrun++;
+        return;
+    }
+    size_t first = GD_LOGBIN_TX_BUFSIZE - head;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&gd_logbin_ring[head], data, first);
+    memcpy(gd_logbin_ring, data + first, len - first);
+    gd_logbin_stats.frames++;
+    gd_logbin_stats.bytes += len;
+    CRITICAL_REGION_ENTER();
+    gd_logbin_head = (head + len) % GD_LOGBIN_TX_BUFSIZE;
+    gd_logbin_start_tx();
+    CRITICAL_REGION_EXIT();
+}
+
+/* COBS encode and send a raw frame */
+static void gd_logbin_send_frame(size_t len) {
+    const uint8_t *in = gd_logbin_raw;
+    uint8_t *out = gd_logbin_frame;
+    size_t code_pos = 0;
+    size_t o = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] == 0) {
+            out[code_pos] = code;
+            code_pos = o++;
+            code = 1;
+        } else {
+            out[o++] = in[i];
+            if (++code == 0xff) {
+                out[code_pos] = code;
+                code_pos = o++;
+                code = 1;
+            }
+        }
+    }
+    out[code_pos] = code;
+    out[o++] = 0;
+    gd_logbin_send(out, o);
+}
+
+/* Get the conversion character of the next argument of a format string.
+ * Returns 0 if there are no further conversions. */
+static char gd_logbin_next_conv(const char **fmt) {
+    const char *s = *fmt;
+    for (;;) {
+        while (*s != '\0' && *s != '%') {
+            s++;
+        }
+        if (*s == '\0') {
+            *fmt = s;
+            return 0;
+        }
+        s++;
+        while (*s != '\0' && strchr("-+ #0123456789.*hlLqjzt", *s) != NULL) {
+            s++;
+        }
+        if (*s == '\0') {
+            *fmt = s;
+            return 0;
+        }
+        if (*s != '%') {
+            *fmt = s + 1;
+            return *s;
+        }
+        s++;
+    }
+}
+
+static void gd_logbin_put_std(const nrf_log_header_t *header, nrf_log_entry_t *p_msg,
+                              size_t offset) {
+    const char *fmt = (const char *)(uintptr_t)header->base.std.addr;
+    uint32_t nargs = header->base.std.nargs;
+    uint32_t args[NRF_LOG_MAX_NUM_OF_ARGS];
+    nrf_memobj_read(p_msg, args, nargs * sizeof(uint32_t), offset);
+
+    uint8_t *p = gd_logbin_raw;
+    *p++ = (GD_LOGBIN_TYPE_STD << 6) | (header->base.std.severity << 3) | nargs;
+    *p++ = header->module_id;
+    *p++ = header->base.std.addr;
+    *p++ = header->base.std.addr >> 8;
+    *p++ = header->base.std.addr >> 16;
+    for (uint32_t i = 0; i < nargs; i++) {
+        p = gd_put_u32(p, args[i]);
+        if (gd_logbin_next_conv(&fmt) == 's' && args[i] >= GD_LOGBIN_CODE_END) {
+            /* RAM string, may be gone when the host decodes the frame */
+            const char *str = (const char *)(uintptr_t)args[i];
+            size_t len = strnlen(str, GD_LOGBIN_MAX_STR);
+            memcpy(p, str, len);
+            p += len;
+            *p++ = '\0';
+        }
+    }
+    gd_logbin_send_frame(p - gd_logbin_raw);
+}
+
+static void gd_logbin_put_hexdump(const nrf_log_header_t *header, nrf_log_entry_t *p_msg,
+                                  size_t offset) {
+    uint32_t len = header->base.hexdump.len;
+    do {
+        uint32_t n = len > GD_LOGBIN_HEXDUMP_CHUNK ? GD_LOGBIN_HEXDUMP_CHUNK : len;
+        uint8_t *p = gd_logbin_raw;
+        *p++ = (GD_LOGBIN_TYPE_HEXDUMP << 6) | (header->base.hexdump.severity << 3);
+        *p++ = header->module_id;
+        *p++ = n;
+        nrf_memobj_read(p_msg, p, n, offset);
+        gd_logbin_send_frame(3 + n);
+        offset += n;
+        len -= n;
+    } while (len > 0);
+}
+
+static void gd_logbin_put(nrf_log_backend_t const *p_backend, nrf_log_entry_t *p_msg) {
+    nrf_log_header_t header;
+    size_t offset = HEADER_SIZE * sizeof(uint32_t);
+
+    nrf_memobj_get(p_msg);
+    nrf_memobj_read(p_msg, &header, offset, 0);
+    if (header.dropped != 0) {
+        gd_logbin_raw[0] = GD_LOGBIN_TYPE_DROPPED << 6;
+        gd_logbin_raw[1] = 0;
+        gd_logbin_raw[2] = header.dropped;
+        gd_logbin_raw[3] = header.dropped >> 8;
+        gd_logbin_send_frame(4);
+    }
+    if (header.base.generic.type == HEADER_TYPE_STD) {
+        gd_logbin_put_std(&header, p_msg, offset);
+    } else if (header.base.generic.type == HEADER_TYPE_HEXDUMP) {
+        gd_logbin_put_hexdump(&header, p_msg, offset);
+    }
+    nrf_memobj_put(p_msg);
+}
+
+static void gd_logbin_panic_set(nrf_log_backend_t const *p_backend) {
+    /* interrupts may be disabled, so the running transfer is aborted and
+     * repeated in blocking mode (the host resynchronizes at the next frame
+     * delimiter) */
+    nrf_drv_uart_tx_abort(&gd_logbin_uart);
+    gd_logbin_tx_busy = false;
+    nrf_drv_uart_uninit(&gd_logbin_uart);
+    gd_logbin_uart_init(false);
+    gd_logbin_panic = true;
+    uint16_t tail = gd_logbin_tail;
+    uint16_t head = gd_logbin_head;
+    if (head < tail) {
+        gd_logbin_send(&gd_logbin_ring[tail], GD_LOGBIN_TX_BUFSIZE - tail);
+        tail = 0;
+    }
+    gd_logbin_send(&gd_logbin_ring[tail], head - tail);
+    gd_logbin_tail = head;
+}
+
+static void gd_logbin_flush(nrf_log_backend_t const *p_backend) {
+}
+
+static const nrf_log_backend_api_t gd_logbin_api = {
+    .put = gd_logbin_put,
+    .panic_set = gd_logbin_panic_set,
+    .flush = gd_logbin_flush,
+};
+
+NRF_LOG_BACKEND_DEF(gd_logbin_backend, gd_logbin_api, NULL);
+
+void gd_logbin_init(void) {
+    gd_logbin_uart_init(true);
+    int32_t backend_id = nrf_log_backend_add(&gd_logbin_backend, NRF_LOG_SEVERITY_DEBUG);
+    APP_ERROR_CHECK_BOOL(backend_id >= 0);
+    nrf_log_backend_enable(&gd_logbin_backend);
+}
+
+void gd_logbin_get_stats(gd_logbin_stats_t *stats) {
+    CRITICAL_REGION_ENTER();
+    *stats = gd_logbin_stats;
+    CRITICAL_REGION_EXIT();
+}
+
+void gd_logbin_log(void) {
+    gd_logbin_stats_t s;
+    gd_logbin_get_stats(&s);
+    NRF_LOG_INFO("log: %u frames, %u bytes, %u overruns", s.frames, s.bytes, s.overrun);
+}
+
+#endif
@@ -0,0 +1,229 @@
+#!/usr/bin/python3
+#
+# BLE garage door opener remote control
+#
+# Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+#
+# Dictionary for the binary log backend (see include/logbin.h)
+#
+#   logdict.py extract firmware.out firmware.logdict
+#       extract the strings and log module names from the ELF file
+#
+#   logdict.py decode firmware.logdict [capture]
+#       decode binary log frames from a capture file, a serial device
+#       (configured with stty) or stdin
+#
+
+import argparse
+import bisect
+import json
+import re
+import struct
+import sys
+
+CODE_END = 0x20000000
+SEVERITIES = {1: 'error', 2: 'warning', 3: 'info', 4: 'debug'}
+TYPE_STD, TYPE_HEXDUMP, TYPE_DROPPED = 1, 2, 3
+HEXDUMP_BYTES_IN_LINE = 8
+
+SHT_PROGBITS, SHT_SYMTAB = 1, 2
+SHF_WRITE, SHF_ALLOC = 0x1, 0x2
+
+MODULE_SYM = re.compile(r'^m_nrf_log_(\w+)_logs_data_const$')
+CONV = re.compile(r'%([-+ #0-9.*hlLqjzt]*)([^-+ #0-9.*hlLqjzt])')
+
+
+def read_elf(path):
+    """sections (name, type, flags, addr, data) and symbols (name, value, shndx)"""
+    with open(path, 'rb') as f:
+        elf = f.read()
+    if elf[:4] != b'\x7fELF' or elf[4] != 1 or elf[5] != 1:
+        raise ValueError('%s is not a little-endian ELF32 file' % path)
+    shoff, = struct.unpack_from('<I', elf, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from('<HHH', elf, 0x2e)
+    headers = [struct.unpack_from('<IIIIIIIIII', elf, shoff + i * shentsize)
+               for i in range(shnum)]
+
+    def cstr(data, offset):
+        return data[offset:data.index(b'\0', offset)].decode()
+
+    shstr = headers[shstrndx]
+    shstrtab = elf[shstr[4]:shstr[4] + shstr[5]]
+    sections = []
+    symbols = []
+    for h in headers:
+        name, typ, flags, addr, offset, size, link = h[:7]
+        data = elf[offset:offset + size]
+        sections.append((cstr(shstrtab, name), typ, flags, addr, data))
+        if typ == SHT_SYMTAB:
+            strtab = elf[headers[link][4]:headers[link][4] + headers[link][5]]
+            for pos in range(0, size, 16):
+                st_name, value, _, _, _, shndx = struct.unpack_from('<IIIBBH', data, pos)
+                symbols.append((cstr(strtab, st_name), value, shndx))
+    return sections, symbols
+
+
+def extract(elf_path, dict_path):
+    sections, symbols = read_elf(elf_path)
+    strings = {}
+    for name, typ, flags, addr, data in sections:
+        if typ != SHT_PROGBITS or not flags & SHF_ALLOC or flags & SHF_WRITE:
+            continue
+        if addr >= CODE_END:
+            continue
+        # printable NUL terminated runs
+        for m in re.finditer(rb'[\t\n\r\x20-\x7e]+(?=\0)', data):
+            strings['%x' % (addr + m.start())] = m.group().decode()
+    # log modules in the order of the log_const_data section
+    modules = []
+    const_idx = [i for i, s in enumerate(sections) if s[0] == 'log_const_data']
+    if const_idx:
+        entries = sorted((value, name) for name, value, shndx in symbols
+                         if shndx == const_idx[0] and name and not name.startswith('$'))
+        for _, name in entries:
+            m = MODULE_SYM.match(name)
+            modules.append(m.group(1) if m else name)
+    with open(dict_path, 'w') as f:
+        json.dump({'modules': modules, 'strings': strings}, f)
+    print('%s: %u strings, %u modules' % (dict_path, len(strings), len(modules)))
+
+
+class Dictionary:
+    def __init__(self, path):
+        with open(path) as f:
+            d = json.load(f)
+        self.modules = d['modules']
+        items = sorted((int(a, 16), s) for a, s in d['strings'].items())
+        self.addrs = [a for a, _ in items]
+        self.strings = [s for _, s in items]
+
+    def string(self, addr):
+        """string at an address (also within a string due to tail merging)"""
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        if i >= 0 and addr - self.addrs[i] <= len(self.strings[i]):
+            return self.strings[i][addr - self.addrs[i]:]
+        return None
+
+    def module(self, module_id):
+        if module_id < len(self.modules):
+            return self.modules[module_id]
+        return 'module%u' % module_id
+
+
+def cobs_decode(data):
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        code = data[pos]
+        if code == 0 or pos + code > len(data) + 1:
+            raise ValueError('invalid COBS data')
+        out += data[pos + 1:pos + code]
+        pos += code
+        if code < 0xff and pos < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def format_std(d, fmt, frame, nargs):
+    pos = 5
+    out = []
+    last = 0
+    for i, m in enumerate(m for m in CONV.finditer(fmt) if m.group(2) != '%'):
+        if i >= nargs:
+            break
+        arg, = struct.unpack_from('<I', frame, pos)
+        pos += 4
+        flags, conv = m.groups()
+        flags = re.sub(r'[hlLqjzt]', '', flags)
+        if conv == 's':
+            if arg >= CODE_END:
+                end = frame.index(b'\0', pos)
+                value = frame[pos:end].decode(errors='replace')
+                pos = end + 1
+            else:
+                value = d.string(arg)
+                if value is None:
+                    value = '<string %08x>' % arg
+            text = ('%' + flags + 's') % value
+        elif conv in 'di':
+            text = ('%' + flags + 'd') % (arg - (1 << 32) if arg & 0x80000000 else arg)
+        elif conv in 'uoxX':
+            text = ('%' + flags + ('d' if conv == 'u' else conv)) % arg
+        elif conv == 'c':
+            text = chr(arg & 0xff)
+        elif conv == 'p':
+            text = '0x%08x' % arg
+        else:
+            text = m.group()
+        out.append(fmt[last:m.start()].replace('%%', '%'))
+        out.append(text)
+        last = m.end()
+    out.append(fmt[last:].replace('%%', '%'))
+    return ''.join(out)
+
+
+def decode_frame(d, frame):
+    typ = frame[0] >> 6
+    severity = SEVERITIES.get((frame[0] >> 3) & 7, '?')
+    prefix = '<%s> %s:' % (severity, d.module(frame[1]))
+    if typ == TYPE_STD:
+        addr = frame[2] | (frame[3] << 8) | (frame[4] << 16)
+        fmt = d.string(addr)
+        if fmt is None:
+            return ['%s <unknown format string %06x>' % (prefix, addr)]
+        return ['%s %s' % (prefix, format_std(d, fmt, frame, frame[0] & 7))]
+    if typ == TYPE_HEXDUMP:
+        data = frame[3:3 + frame[2]]
+        lines = []
+        for pos in range(0, len(data), HEXDUMP_BYTES_IN_LINE):
+            chunk = data[pos:pos + HEXDUMP_BYTES_IN_LINE]
+            hexstr = ' '.join('%02X' % b for b in chunk)
+            text = ''.join(chr(b) if 0x20 <= b < 0x7f else '.' for b in chunk)
+            lines.append('%s  %-*s|%s' % (prefix, 3 * HEXDUMP_BYTES_IN_LINE - 1, hexstr, text))
+        return lines
+    if typ == TYPE_DROPPED:
+        return ['Logs dropped (%u)' % struct.unpack_from('<H', frame, 2)]
+    return ['<unknown frame type %u>' % typ]
+
+
+def decode(dict_path, capture):
+    d = Dictionary(dict_path)
+    f = open(capture, 'rb', buffering=0) if capture else sys.stdin.buffer
+    buf = bytearray()
+    while True:
+        data = f.read(256)
+        if not data:
+            break
+        buf += data
+        while True:
+            end = buf.find(b'\0')
+            if end < 0:
+                break
+            encoded = bytes(buf[:end])
+            del buf[:end + 1]
+            if not encoded:
+                continue
+            try:
+                lines = decode_frame(d, cobs_decode(encoded))
+            except (ValueError, IndexError, struct.error):
+                lines = ['<corrupt frame: %s>' % encoded.hex()]
+            for line in lines:
+                print(line, flush=True)
+
+
+parser = argparse.ArgumentParser()
+sub = parser.add_subparsers(dest='command', required=True)
+p = sub.add_parser('extract', help='extract the dictionary from the ELF file')
+p.add_argument('elf')
+p.add_argument('dict')
+p = sub.add_parser('decode', help='decode a binary log')
+p.add_argument('dict')
+p.add_argument('capture', nargs='?', help='capture file or serial device (default: stdin)')
+args = parser.parse_args()
+
+if args.command == 'extract':
+    extract(args.elf, args.dict)
+else:
+    decode(args.dict, args.capture)
@@ -0,0 +1,79 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * RAM usage and stack high-water mark
+ */
+
+#include <memstat.h>
+
+#include <nrf.h>
+#include <nrf_log.h>
+#include <malloc.h>
+#include <stddef.h>
+
+#define GD_MEM_RAM_BASE 0x20000000UL
+
+#define GD_MEM_PAINT 0x5ca1ab1eUL
+
+/* words below the stack pointer left alone when painting (frame of
+ * gd_mem_init()) */
+#define GD_MEM_PAINT_MARGIN_WORDS 16
+
+/* defined in the linker script */
+extern uint32_t __data_start__[];
+extern uint32_t __HeapBase[];
+extern uint32_t __HeapLimit[];
+extern uint32_t __StackLimit[];
+extern uint32_t __StackTop[];
+
+static uint32_t gd_mem_sd_ram_start;
+
+void __attribute__((noinline)) gd_mem_init(void) {
+    volatile uint32_t *end = (volatile uint32_t *)__get_MSP() - GD_MEM_PAINT_MARGIN_WORDS;
+    for (volatile uint32_t *p = __StackLimit; p < end; p++) {
+        *p = GD_MEM_PAINT;
+    }
+}
+
+void gd_mem_set_sd_ram_start(uint32_t ram_start) {
+    gd_mem_sd_ram_start = ram_start;
+}
+
+static uint32_t gd_mem_stack_used(void) {
+    const uint32_t *p = __StackLimit;
+    while (p < __StackTop && *p == GD_MEM_PAINT) {
+        p++;
+    }
+    return (uint8_t *)__StackTop - (uint8_t *)p;
+}
+
+void gd_mem_get_stats(gd_mem_stats_t *stats) {
+    struct mallinfo mi = mallinfo();
+    stats->sd_bytes = (uintptr_t)__data_start__ - GD_MEM_RAM_BASE;
+    stats->sd_required = gd_mem_sd_ram_start != 0 ? gd_mem_sd_ram_start - GD_MEM_RAM_BASE : 0;
+    stats->static_bytes = (uint8_t *)__HeapBase - (uint8_t *)__data_start__;
+    stats->heap_size = (uint8_t *)__HeapLimit - (uint8_t *)__HeapBase;
+    stats->heap_used = mi.arena;
+    stats->stack_size = (uint8_t *)__StackTop - (uint8_t *)__StackLimit;
+    stats->stack_used = gd_mem_stack_used();
+}
+
+void gd_mem_log(void) {
+    gd_mem_stats_t s;
+    gd_mem_get_stats(&s);
+    NRF_LOG_INFO("ram: softdevice %u/%u, static %u, heap %u/%u, stack %u/%u bytes",
+                 s.sd_required, s.sd_bytes, s.static_bytes, s.heap_used, s.heap_size,
+                 s.stack_used, s.stack_size);
+    if (s.sd_required != 0 && s.sd_required < s.sd_bytes) {
+        /* the RAM origin of the linker script can be lowered */
+        NRF_LOG_INFO("ram: %u bytes reserved for the SoftDevice are unused",
+                     s.sd_bytes - s.sd_required);
+    }
+    if (s.stack_size - s.stack_used < GD_MEM_STACK_WARN_BYTES) {
+        NRF_LOG_WARNING("stack reserve low: %u bytes", s.stack_size - s.stack_used);
+    }
+}
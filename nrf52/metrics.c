@@ -0,0 +1,110 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Metrics registry
+ */
+
+#include <metrics.h>
+#include <pack.h>
+#include <ramfunc.h>
+#include <systime.h>
+
+#include <nrf_atomic.h>
+#include <nrf_log.h>
+
+/* number of u32 slots per metric type */
+#define GD_METRIC_SLOTS_COUNTER   1
+#define GD_METRIC_SLOTS_GAUGE     1
+#define GD_METRIC_SLOTS_HISTOGRAM GD_METRIC_HIST_BINS
+
+/* slot index of each metric */
+enum {
+#define GD_METRIC_SLOT(id, kind, name) \
+    GD_METRIC_SLOT_##id, GD_METRIC_SLOT_END_##id = GD_METRIC_SLOT_##id + GD_METRIC_SLOTS_##kind - 1,
+    GD_METRICS(GD_METRIC_SLOT)
+#undef GD_METRIC_SLOT
+    GD_METRIC_SLOT_COUNT,
+};
+
+typedef struct {
+    uint8_t type;
+    uint8_t slot;
+} gd_metric_def_t;
+
+GD_RAMDATA static const gd_metric_def_t gd_metric_defs[GD_METRIC_COUNT] = {
+#define GD_METRIC_DEF(id, kind, name) \
+    [GD_METRIC_##id] = {.type = GD_METRIC_TYPE_##kind, .slot = GD_METRIC_SLOT_##id},
+    GD_METRICS(GD_METRIC_DEF)
+#undef GD_METRIC_DEF
+};
+
+static nrf_atomic_u32_t gd_metric_slots[GD_METRIC_SLOT_COUNT];
+static uint16_t gd_metrics_seq_no;
+
+#define GD_METRICS_FRAME_HEADER 11
+#define GD_METRICS_FRAME_MAX \
+    (GD_METRICS_FRAME_HEADER + GD_METRIC_COUNT * 3 + GD_METRIC_SLOT_COUNT * sizeof(uint32_t))
+
+GD_RAMFUNC void gd_metric_inc(gd_metric_t id) {
+    nrf_atomic_u32_add(&gd_metric_slots[gd_metric_defs[id].slot], 1);
+}
+
+GD_RAMFUNC void gd_metric_add(gd_metric_t id, uint32_t n) {
+    nrf_atomic_u32_add(&gd_metric_slots[gd_metric_defs[id].slot], n);
+}
+
+GD_RAMFUNC void gd_metric_set(gd_metric_t id, uint32_t value) {
+    gd_metric_slots[gd_metric_defs[id].slot] = value;
+}
+
+GD_RAMFUNC void gd_metric_observe(gd_metric_t id, uint32_t value) {
+    unsigned bin = 0;
+    while (bin < GD_METRIC_HIST_BINS - 1 && value >= (1U << bin)) {
+        bin++;
+    }
+    nrf_atomic_u32_add(&gd_metric_slots[gd_metric_defs[id].slot + bin], 1);
+}
+
+uint32_t gd_metric_get(gd_metric_t id) {
+    return gd_metric_slots[gd_metric_defs[id].slot];
+}
+
+size_t gd_metrics_encode(uint8_t *buf, size_t size) {
+    if (size < GD_METRICS_FRAME_MAX) {
+        return 0;
+    }
+    uint8_t *p = buf;
+    *p++ = GD_METRICS_FRAME_TYPE;
+    *p++ = GD_METRICS_FRAME_VERSION;
+    uint8_t *len = p;
+    p += 2;
+    p = gd_put_u16(p, gd_metrics_seq_no++);
+    p = gd_put_u32(p, GD_TIME_TICKS_TO_MS(gd_time_ticks()) / 1000);
+    *p++ = GD_METRIC_COUNT;
+    for (unsigned id = 0; id < GD_METRIC_COUNT; id++) {
+        const gd_metric_def_t *d = &gd_metric_defs[id];
+        *p++ = id;
+        *p++ = d->type;
+        if (d->type == GD_METRIC_TYPE_HISTOGRAM) {
+            *p++ = GD_METRIC_HIST_BINS;
+            for (unsigned bin = 0; bin < GD_METRIC_HIST_BINS; bin++) {
+                p = gd_put_u32(p, gd_metric_slots[d->slot + bin]);
+            }
+        } else {
+            p = gd_put_u32(p, gd_metric_slots[d->slot]);
+        }
+    }
+    gd_put_u16(len, p - buf);
+    return p - buf;
+}
+
+void gd_metrics_log(void) {
+    static uint8_t frame[GD_METRICS_FRAME_MAX];
+    size_t len = gd_metrics_encode(frame, sizeof(frame));
+    NRF_LOG_INFO("metrics frame:");
+    NRF_LOG_HEXDUMP_INFO(frame, len);
+}
@@ -0,0 +1,85 @@
+#!/usr/bin/python3
+#
+# BLE garage door opener remote control
+#
+# Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+#
+# Decode metrics frames (see include/metrics.h) from a log capture
+#
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+FRAME_TYPE = 0x4d
+FRAME_VERSION = 1
+TYPES = {0: 'counter', 1: 'gauge', 2: 'histogram'}
+
+parser = argparse.ArgumentParser()
+parser.add_argument('log', nargs='?', help='log capture (default: stdin)')
+parser.add_argument('--header',
+                    default=os.path.join(os.path.dirname(__file__), 'include', 'metrics.h'),
+                    help='metrics.h defining the metric names')
+args = parser.parse_args()
+
+
+def read_names(header):
+    """metric names in the order of definition in GD_METRICS"""
+    with open(header) as f:
+        text = f.read()
+    return re.findall(r'X\(\s*\w+\s*,\s*\w+\s*,\s*"(\w+)"\s*\)', text)
+
+
+def hex_bytes(lines):
+    """bytes of a hex dump as printed by NRF_LOG_HEXDUMP"""
+    for line in lines:
+        # strip the time stamp and the "<info> app:" prefix
+        dump = re.sub(r'^.*?<\w+>\s*[\w.]+:', '', line).split('|')[0]
+        for b in re.findall(r'\b([0-9A-Fa-f]{2})\b', dump):
+            yield int(b, 16)
+
+
+def decode(frame, names):
+    typ, ver, length, seq_no, uptime, count = struct.unpack_from('<BBHHIB', frame)
+    if typ != FRAME_TYPE or ver != FRAME_VERSION:
+        raise ValueError('unsupported frame type/version %02x/%u' % (typ, ver))
+    print('snapshot %u, uptime %u s' % (seq_no, uptime))
+    pos = 11
+    for _ in range(count):
+        mid, mtype = struct.unpack_from('<BB', frame, pos)
+        pos += 2
+        name = names[mid] if mid < len(names) else 'metric%u' % mid
+        if TYPES.get(mtype) == 'histogram':
+            nbins = frame[pos]
+            pos += 1
+            bins = struct.unpack_from('<%uI' % nbins, frame, pos)
+            pos += 4 * nbins
+            print('  %-20s %s' % (name, ' '.join(
+                ('<%u:%u' % (1 << i, n)) if i < nbins - 1 else ('>=%u:%u' % (1 << (i - 1), n))
+                for i, n in enumerate(bins))))
+        else:
+            value, = struct.unpack_from('<I', frame, pos)
+            pos += 4
+            print('  %-20s %u (%s)' % (name, value, TYPES.get(mtype, '?')))
+
+
+names = read_names(args.header)
+lines = open(args.log) if args.log else sys.stdin
+frame_lines = None
+for line in lines:
+    if 'metrics frame:' in line:
+        frame_lines = []
+        continue
+    if frame_lines is None:
+        continue
+    frame_lines.append(line)
+    data = bytes(hex_bytes(frame_lines))
+    if len(data) >= 4:
+        length, = struct.unpack_from('<H', data, 2)
+        if len(data) >= length:
+            decode(data[:length], names)
+            frame_lines = None
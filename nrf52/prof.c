@@ -0,0 +1,86 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Profiling of hot paths
+ */
+
+#include <prof.h>
+#include <ramfunc.h>
+
+#if GD_PROF_ENABLED
+
+#include <hal.h>
+#include <nrf_log.h>
+#include <string.h>
+
+#if defined(__arm__)
+#include <nrf.h>
+#define GD_PROF_UNIT "cycles"
+#else
+#include <time.h>
+#define GD_PROF_UNIT "ns"
+#endif
+
+static gd_prof_stats_t gd_prof_stats[GD_PROF_COUNT];
+
+static const char *const gd_prof_names[GD_PROF_COUNT] = {
+    "tx_key", "digest", "adv_report", "tx_rec", "set_seq_no", "log", "health"};
+
+void gd_prof_init(void) {
+#if defined(__arm__)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    gd_prof_reset();
+}
+
+GD_RAMFUNC uint32_t gd_prof_now(void) {
+#if defined(__arm__)
+    return DWT->CYCCNT;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+#endif
+}
+
+GD_RAMFUNC void gd_prof_scope_end(gd_prof_scope_t *scope) {
+    uint32_t t = gd_prof_now() - scope->start;
+    gd_prof_stats_t *s = &gd_prof_stats[scope->id];
+    if (s->calls == 0 || t < s->min) {
+        s->min = t;
+    }
+    if (t > s->max) {
+        s->max = t;
+    }
+    s->total += t;
+    s->calls++;
+}
+
+void gd_prof_get_stats(gd_prof_id_t id, gd_prof_stats_t *stats) {
+    GD_HAL_CRITICAL_ENTER();
+    *stats = gd_prof_stats[id];
+    GD_HAL_CRITICAL_EXIT();
+}
+
+void gd_prof_reset(void) {
+    GD_HAL_CRITICAL_ENTER();
+    memset(gd_prof_stats, 0, sizeof(gd_prof_stats));
+    GD_HAL_CRITICAL_EXIT();
+}
+
+void gd_prof_log(void) {
+    for (unsigned id = 0; id < GD_PROF_COUNT; id++) {
+        gd_prof_stats_t s;
+        gd_prof_get_stats(id, &s);
+        NRF_LOG_INFO("prof %s: n = %u, min = %u, avg = %u, max = %u " GD_PROF_UNIT,
+                     gd_prof_names[id], s.calls, s.min,
+                     s.calls ? (uint32_t)(s.total / s.calls) : 0, s.max);
+    }
+}
+
+#endif
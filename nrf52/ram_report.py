@@ -0,0 +1,138 @@
+#!/usr/bin/python3
+#
+# BLE garage door opener remote control
+#
+# Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+#
+# RAM usage per module from a GNU ld map file (see include/memstat.h)
+#
+#   ram_report.py <map> [--baseline <map>]
+#
+# With --baseline, the differences to an earlier build are shown as well.
+#
+
+import argparse
+import os
+import re
+from collections import defaultdict
+
+RAM_BASE = 0x20000000
+
+# output sections reserving space instead of holding module data
+RESERVED = {'.heap': '(heap)', '.stack_dummy': '(stack)'}
+
+COLUMNS = ('data', 'bss', 'other')
+
+
+def module_name(path):
+    """module of an input file: source name or archive"""
+    m = re.match(r'(.*\.a)\(.*\)$', path)
+    if m:
+        return os.path.basename(m.group(1))
+    name = os.path.basename(path)
+    for suffix in ('.o', '.obj'):
+        if name.endswith(suffix):
+            name = name[:-len(suffix)]
+    return name
+
+
+def column(section):
+    if section == '.data':
+        return 'data'
+    if section == '.bss':
+        return 'bss'
+    return 'other'
+
+
+def parse_map(path):
+    """RAM origin and length, and bytes per module and column"""
+    with open(path) as f:
+        lines = f.read().splitlines()
+    ram = None
+    for line in lines:
+        m = re.match(r'RAM\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)', line)
+        if m:
+            ram = (int(m.group(1), 16), int(m.group(2), 16))
+            break
+    if ram is None:
+        raise SystemExit('%s: no RAM region in the memory configuration' % path)
+    origin, length = ram
+
+    usage = defaultdict(lambda: dict((c, 0) for c in COLUMNS))
+    out_section = None
+    pending = None  # input section name on a line of its own
+    started = False
+    for line in lines:
+        if line.startswith('Linker script and memory map'):
+            started = True
+            continue
+        if not started:
+            continue
+        m = re.match(r'^(\.\S+)', line)
+        if m:
+            out_section = m.group(1)
+            pending = None
+            continue
+        m = re.match(r'^ (\S+)\s*$', line)
+        if m and not line.startswith(' *('):
+            pending = m.group(1)
+            continue
+        m = re.match(r'^ (\S+)?\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s*(\S.*)?$', line)
+        if not m or (m.group(1) is None and pending is None):
+            pending = None
+            continue
+        addr = int(m.group(2), 16)
+        size = int(m.group(3), 16)
+        name = m.group(1) or pending
+        pending = None
+        if not size or not origin <= addr < origin + length:
+            continue
+        if out_section in RESERVED:
+            module = RESERVED[out_section]
+        elif name == '*fill*':
+            module = '(padding)'
+        elif m.group(4):
+            module = module_name(m.group(4).strip())
+        else:
+            continue
+        usage[module][column(out_section)] += size
+    return origin, length, usage
+
+
+def total(u):
+    return sum(u.values())
+
+
+parser = argparse.ArgumentParser()
+parser.add_argument('map', help='linker map file')
+parser.add_argument('--baseline', help='linker map file of an earlier build')
+args = parser.parse_args()
+
+origin, length, usage = parse_map(args.map)
+base = parse_map(args.baseline) if args.baseline else None
+
+header = '%-28s' + ' %8s' * (len(COLUMNS) + 1)
+print(header % (('module',) + COLUMNS + ('total',)) + (' %8s' % 'change' if base else ''))
+for module in sorted(usage, key=lambda m: (m.startswith('('), -total(usage[m]))):
+    u = usage[module]
+    row = '%-28s' % module + ''.join(' %8u' % u[c] for c in COLUMNS) + ' %8u' % total(u)
+    if base:
+        row += ' %+8d' % (total(u) - total(base[2].get(module, {})))
+    print(row)
+if base:
+    for module in sorted(set(base[2]) - set(usage)):
+        print('%-28s' % module + ' %8s' * (len(COLUMNS) + 1) % (('-',) * (len(COLUMNS) + 1)) +
+              ' %+8d' % -total(base[2][module]))
+
+used = sum(total(u) for u in usage.values())
+softdevice = origin - RAM_BASE
+print()
+print('softdevice %6u bytes' % softdevice +
+      (' (%+d)' % (softdevice - (base[0] - RAM_BASE)) if base else ''))
+print('used       %6u bytes' % used +
+      (' (%+d)' % (used - sum(total(u) for u in base[2].values())) if base else ''))
+print('free       %6u bytes' % (length - used) +
+      (' (%+d)' % ((length - used) - (base[1] - sum(total(u) for u in base[2].values())))
+       if base else ''))
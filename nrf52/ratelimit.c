@@ -0,0 +1,164 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Per-transmitter rate limiting of digest verification attempts
+ */
+
+#include <ratelimit.h>
+#include <metrics.h>
+
+#include <nrf_log.h>
+#include <string.h>
+
+typedef struct {
+    ble_uuid128_t uuid;
+    uint8_t addr[GD_HAL_ADDR_LEN];
+    bool used;
+    uint8_t failures;       /* consecutive digest failures */
+    uint8_t tokens;
+    uint32_t refill_ms;     /* time of last token refill */
+    uint32_t blocked_until; /* end of back-off time */
+    uint32_t last_seen;
+} gd_rl_entry_t;
+
+static gd_rl_entry_t gd_rl_table[GD_RL_TABLE_SIZE];
+static gd_rl_stats_t gd_rl_stats;
+
+/* global budget for digest failures of untracked sources */
+static uint8_t gd_rl_global_tokens;
+static uint32_t gd_rl_global_refill_ms;
+
+/* wrap-around safe comparison of time stamps */
+static inline bool gd_rl_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+static gd_rl_entry_t *gd_rl_find(const ble_uuid128_t *uuid, const uint8_t *addr) {
+    for (int i = 0; i < GD_RL_TABLE_SIZE; i++) {
+        gd_rl_entry_t *e = &gd_rl_table[i];
+        if (e->used && memcmp(&e->uuid, uuid, sizeof(ble_uuid128_t)) == 0 &&
+            memcmp(e->addr, addr, sizeof(e->addr)) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/* Get a free entry. If the table is full, a stale entry is evicted or, if
+ * there is none, the least suspicious one that was seen least recently.
+ */
+static gd_rl_entry_t *gd_rl_alloc(uint32_t now_ms) {
+    gd_rl_entry_t *victim = NULL;
+    for (int i = 0; i < GD_RL_TABLE_SIZE; i++) {
+        gd_rl_entry_t *e = &gd_rl_table[i];
+        if (!e->used) {
+            gd_rl_stats.tracked_sources++;
+            return e;
+        }
+        if (now_ms - e->last_seen > GD_RL_STALE_MS &&
+            !gd_rl_before(now_ms, e->blocked_until)) {
+            return e;
+        }
+        if (victim == NULL ||
+            e->failures < victim->failures ||
+            (e->failures == victim->failures &&
+             gd_rl_before(e->last_seen, victim->last_seen))) {
+            victim = e;
+        }
+    }
+    gd_rl_stats.evictions++;
+    return victim;
+}
+
+/* add the tokens accumulated since *refill_ms to a token bucket */
+static void gd_rl_refill(uint8_t *tokens, uint32_t *refill_ms, uint8_t burst,
+                         uint32_t interval_ms, uint32_t now_ms) {
+    uint32_t refill = (now_ms - *refill_ms) / interval_ms;
+    if (refill > 0) {
+        *tokens = refill >= burst - *tokens ? burst : *tokens + refill;
+        *refill_ms += refill * interval_ms;
+    }
+}
+
+void gd_rl_init(void) {
+    memset(gd_rl_table, 0, sizeof(gd_rl_table));
+    memset(&gd_rl_stats, 0, sizeof(gd_rl_stats));
+    gd_rl_global_tokens = GD_RL_GLOBAL_BURST;
+    gd_rl_global_refill_ms = 0;
+}
+
+bool gd_rl_allow(const ble_uuid128_t *uuid, const uint8_t *addr, uint32_t now_ms) {
+    gd_rl_entry_t *e = gd_rl_find(uuid, addr);
+    if (e == NULL) {
+        /* the token is taken by gd_rl_report_failure(), so valid commands
+         * do not use up the budget */
+        gd_rl_refill(&gd_rl_global_tokens, &gd_rl_global_refill_ms, GD_RL_GLOBAL_BURST,
+                     GD_RL_GLOBAL_REFILL_MS, now_ms);
+        if (gd_rl_global_tokens == 0) {
+            gd_rl_stats.throttled_packets++;
+            gd_rl_stats.global_throttled++;
+            return false;
+        }
+        return true;
+    }
+    e->last_seen = now_ms;
+    if (gd_rl_before(now_ms, e->blocked_until)) {
+        gd_rl_stats.throttled_packets++;
+        return false;
+    }
+    gd_rl_refill(&e->tokens, &e->refill_ms, GD_RL_BURST, GD_RL_REFILL_MS, now_ms);
+    if (e->tokens == 0) {
+        gd_rl_stats.throttled_packets++;
+        return false;
+    }
+    e->tokens--;
+    return true;
+}
+
+void gd_rl_report_failure(const ble_uuid128_t *uuid, const uint8_t *addr, uint32_t now_ms) {
+    gd_rl_entry_t *e = gd_rl_find(uuid, addr);
+    if (e == NULL) {
+        if (gd_rl_global_tokens > 0) {
+            gd_rl_global_tokens--;
+        }
+        e = gd_rl_alloc(now_ms);
+        memcpy(&e->uuid, uuid, sizeof(ble_uuid128_t));
+        memcpy(e->addr, addr, sizeof(e->addr));
+        e->used = true;
+        e->failures = 0;
+        e->tokens = GD_RL_BURST - 1; /* this attempt */
+        e->refill_ms = now_ms;
+        e->blocked_until = now_ms;
+        gd_rl_stats.throttled_sources++;
+        /* one lockout per source until it sends a valid command; further
+         * failures only extend the back-off */
+        gd_metric_inc(GD_METRIC_LOCKOUTS);
+    }
+    if (e->failures <= GD_RL_BACKOFF_MAX_SHIFT) {
+        e->failures++;
+    }
+    unsigned shift = e->failures - 1;
+    if (shift > GD_RL_BACKOFF_MAX_SHIFT) {
+        shift = GD_RL_BACKOFF_MAX_SHIFT;
+    }
+    e->blocked_until = now_ms + (GD_RL_BACKOFF_BASE_MS << shift);
+    e->last_seen = now_ms;
+    NRF_LOG_INFO("source throttled for %u ms (failures: %u)",
+                 GD_RL_BACKOFF_BASE_MS << shift, e->failures);
+}
+
+void gd_rl_report_success(const ble_uuid128_t *uuid, const uint8_t *addr) {
+    gd_rl_entry_t *e = gd_rl_find(uuid, addr);
+    if (e != NULL) {
+        e->used = false;
+        gd_rl_stats.tracked_sources--;
+    }
+}
+
+void gd_rl_get_stats(gd_rl_stats_t *stats) {
+    *stats = gd_rl_stats;
+}
@@ -0,0 +1,306 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Receiver pipeline
+ */
+
+#include <receiver.h>
+#include <ack.h>
+#include <actuator.h>
+#include <adv_data.h>
+#include <auth.h>
+#include <flash.h>
+#include <hal.h>
+#include <metrics.h>
+#include <prof.h>
+#include <ramfunc.h>
+#include <ratelimit.h>
+#include <scheduler.h>
+#include <stall.h>
+#include <storage.h>
+#include <systime.h>
+#include <trace.h>
+#include <txstats.h>
+
+#include <app_error.h>
+#include <nrf_atfifo.h>
+#include <nrf_log.h>
+#include <string.h>
+
+static gd_hal_timer_t scan_gap_timer;
+static volatile bool scan_paused = false;
+
+static volatile bool gd_learning = false;
+
+typedef struct {
+    ble_uuid128_t uuid;
+    gd_message_t msg;
+    uint8_t addr[GD_HAL_ADDR_LEN]; /* advertiser */
+    int8_t rssi;
+    uint32_t t_rx;        /* gd_hal_counter() of the report, trace origin */
+    uint32_t erase_count; /* gds_flash_erase_count() of the report */
+} gd_adv_data_t;
+
+NRF_ATFIFO_DEF(gd_adv_fifo, gd_adv_data_t, 8);
+
+/* verified command waiting for actuation */
+typedef struct {
+    ble_uuid128_t uuid;
+    gd_message_t msg;
+    uint8_t key[GD_TX_KEY_SIZE];
+    uint32_t t_rx;
+    uint32_t erase_count;
+    bool persisted; /* dropped if the sequence number was not written */
+} gd_accepted_t;
+
+NRF_ATFIFO_DEF(gd_accept_fifo, gd_accepted_t, 4);
+
+static uint32_t gd_msg_get_seqno(const gd_message_t *msg) {
+    return (msg->seq_no[0] << 16) | (msg->seq_no[1] << 8) | msg->seq_no[2];
+}
+
+static bool gd_is_learning(void) {
+    return gd_learning;
+}
+
+void gd_rx_set_learning(bool learning) {
+    gd_learning = learning;
+}
+
+static void handle_adv_data(const gd_adv_data_t *ad) {
+    uint32_t now = gd_time_ms();
+    if (!gd_rl_allow(&ad->uuid, ad->addr, now)) {
+        NRF_LOG_DEBUG("dropping data of throttled transmitter");
+        gd_metric_inc(GD_METRIC_THROTTLED);
+        gd_txs_update(&ad->uuid, GD_TXS_DROPPED, ad->rssi, 0, now);
+        return;
+    }
+    uint32_t seq_no = gd_msg_get_seqno(&ad->msg);
+    uint8_t key[GD_TX_KEY_SIZE];
+    gd_calculate_tx_key(&ad->uuid, key);
+    bool digest_ok = gd_msg_check_digest(key, &ad->msg);
+    NRF_LOG_DEBUG("UUID"); NRF_LOG_HEXDUMP_DEBUG(ad->uuid.uuid128, 16);
+    NRF_LOG_DEBUG("Message"); NRF_LOG_HEXDUMP_DEBUG(&ad->msg, 8);
+    NRF_LOG_DEBUG("Sequence number: %u", seq_no);
+    NRF_LOG_DEBUG("Digest check: %d", digest_ok);
+    if (!digest_ok) {
+        /* throttle this source (UUID and advertiser address) for security
+         * reasons to prevent brute force attacks (most probably not needed
+         * due to the low throughput of the BLE advertising procedures). Other
+         * transmitters are not affected, nor is the transmitter owning the
+         * UUID if the forged commands are sent from another address. */
+        gd_metric_inc(GD_METRIC_DIGEST_FAILURES);
+        gd_txs_update(&ad->uuid, GD_TXS_DIGEST_FAILURE, ad->rssi, 0, now);
+        gd_rl_report_failure(&ad->uuid, ad->addr, now);
+        return;
+    }
+    gd_trace_mark(GD_TRACE_VERIFIED, ad->t_rx);
+    uint32_t outputs = gd_act_get_outputs(ad->msg.cmd);
+    uint32_t permitted;
+    uint32_t stored_seq_no;
+    if (gds_get_seq_no(&ad->uuid, &stored_seq_no)) {
+        gd_trace_mark(GD_TRACE_SEQ_NO, ad->t_rx);
+        NRF_LOG_DEBUG("stored_seq_no = %u", stored_seq_no);
+        if (seq_no > stored_seq_no) {
+            NRF_LOG_DEBUG("sequence number is valid");
+            if (!gds_get_tx_outputs(&ad->uuid, &permitted)) {
+                return;
+            }
+            if ((outputs & permitted) != outputs) {
+                if (!gd_is_learning()) {
+                    /* neither acknowledged nor stored, so repetitions are
+                     * rejected as well */
+                    NRF_LOG_INFO("command %02x not permitted", ad->msg.cmd);
+                    gd_metric_inc(GD_METRIC_NOT_PERMITTED);
+                    gd_txs_update(&ad->uuid, GD_TXS_REJECTED, ad->rssi, 0, now);
+                    return;
+                }
+                NRF_LOG_INFO("adding outputs %02x to transmitter", outputs);
+                if (!gds_create_tx_record(&ad->uuid, outputs)) {
+                    return;
+                }
+            }
+            /* the slot is reserved first: a command that cannot be executed
+             * must not consume its sequence number */
+            nrf_atfifo_item_put_t fifo_context;
+            gd_accepted_t *acc = nrf_atfifo_item_alloc(gd_accept_fifo, &fifo_context);
+            if (acc == NULL) {
+                NRF_LOG_INFO("accept FIFO full");
+                gd_metric_inc(GD_METRIC_FIFO_DROPS);
+                return;
+            }
+            /* only a fresh command clears the source; a replayed valid
+             * message proves nothing about its sender */
+            gd_rl_report_success(&ad->uuid, ad->addr);
+            gd_txs_update(&ad->uuid, GD_TXS_ACCEPTED, ad->rssi,
+                          seq_no - stored_seq_no, now);
+            /* The sequence number is written to flash before the command is
+             * executed, so it cannot be replayed after a reset. Commands
+             * accepted earlier are executed while waiting. A command whose
+             * number could not be written is dropped and not acknowledged
+             * (the FIFO slot is released by the actuation handler). The
+             * number stays in the cache, so its repetitions are rejected as
+             * well. */
+            acc->persisted = gds_set_seq_no(&ad->uuid, seq_no);
+            if (!acc->persisted) {
+                NRF_LOG_ERROR("sequence number not stored, dropping command");
+            }
+            gd_trace_mark(GD_TRACE_PERSIST, ad->t_rx);
+            acc->uuid = ad->uuid;
+            acc->msg = ad->msg;
+            memcpy(acc->key, key, sizeof(acc->key));
+            acc->t_rx = ad->t_rx;
+            acc->erase_count = ad->erase_count;
+            nrf_atfifo_item_put(gd_accept_fifo, &fifo_context);
+            gd_sched_post(GD_EVT_ACCEPT);
+        } else if (seq_no == stored_seq_no) {
+            /* repetition of the last accepted message; not acknowledged since
+             * it may as well be replayed by someone else. The acknowledgement
+             * of the accepted message is still running (GD_ACK_DURATION_MS)
+             * while the transmitter repeats it. */
+            gd_txs_update(&ad->uuid, GD_TXS_DUPLICATE, ad->rssi, 0, now);
+        } else {
+            gd_metric_inc(GD_METRIC_REPLAYS_REJECTED);
+            gd_txs_update(&ad->uuid, GD_TXS_REPLAY, ad->rssi, 0, now);
+            NRF_LOG_INFO("invalid sequence number %u <= %d for UUID:",
+                         seq_no, stored_seq_no);
+            NRF_LOG_HEXDUMP_INFO(ad->uuid.uuid128, 16);
+        }
+    } else if (gd_is_learning()) {
+        /* the transmitter is permitted to use the outputs of the command
+         * sent during learning */
+        NRF_LOG_INFO("creating new transmitter record");
+        if (!gds_create_tx_record(&ad->uuid, outputs) ||
+            !gds_set_seq_no(&ad->uuid, seq_no)) {
+            return;
+        }
+        gd_txs_update(&ad->uuid, GD_TXS_ACCEPTED, ad->rssi, 0, now);
+        gd_ack_send(&ad->uuid, key, &ad->msg);
+    } else {
+        NRF_LOG_INFO("unknown transmitter");
+    }
+}
+
+GD_RAMFUNC static void handle_adv_report(const uint8_t *addr, const uint8_t *data, size_t len,
+                                         int8_t rssi, uint32_t t_rx) {
+    GD_PROF_SCOPE(GD_PROF_ADV_REPORT);
+    //NRF_LOG_DEBUG("GAP Advertising report, len=%u, RSSI=%d.", len, rssi);
+    //NRF_LOG_HEXDUMP_DEBUG(data, len);
+
+    gd_ad_iter_t it;
+    gd_ad_struct_t ads;
+    bool found = false;
+    gd_ad_iter_init(&it, data, len);
+    while (gd_ad_iter_next(&it, &ads)) {
+        const gd_ad_service_data_t *sd = gd_ad_as_service_data(&ads);
+        if (sd == NULL) {
+            continue;
+        }
+        found = true;
+        gd_metric_inc(GD_METRIC_PKT_PARSED);
+        nrf_atfifo_item_put_t fifo_context;
+        gd_adv_data_t *ad = nrf_atfifo_item_alloc(gd_adv_fifo, &fifo_context);
+        if (ad != NULL) {
+            ad->uuid = sd->uuid;
+            ad->msg = sd->msg;
+            memcpy(ad->addr, addr, sizeof(ad->addr));
+            ad->rssi = rssi;
+            ad->t_rx = t_rx;
+            ad->erase_count = gds_flash_erase_count();
+            nrf_atfifo_item_put(gd_adv_fifo, &fifo_context);
+            gd_trace_mark(GD_TRACE_ENQUEUE, t_rx);
+            gd_stall_report(false);
+            gd_sched_post(GD_EVT_ADV);
+        } else {
+            NRF_LOG_INFO("ADV FIFO full");
+            gd_metric_inc(GD_METRIC_FIFO_DROPS);
+            gd_stall_report(true);
+        }
+    }
+    if (!found) {
+        gd_metric_inc(GD_METRIC_PKT_REJECTED);
+    }
+    if (it.malformed) {
+        NRF_LOG_INFO("invalid length field in Advertising Data");
+    }
+}
+
+GD_RAMFUNC void gd_rx_adv_report(const uint8_t *addr, const uint8_t *data, size_t len,
+                                 int8_t rssi) {
+    handle_adv_report(addr, data, len, rssi, gd_hal_counter());
+}
+
+/* resume scanning after a scan gap (may be called from interrupt context) */
+static void scan_resume(void) {
+    bool was_paused;
+    GD_HAL_CRITICAL_ENTER();
+    was_paused = scan_paused;
+    scan_paused = false;
+    GD_HAL_CRITICAL_EXIT();
+    if (was_paused) {
+        gd_hal_timer_stop(scan_gap_timer);
+        gd_hal_scan_start();
+    }
+}
+
+static void scan_gap_timeout_handler(void *dummy) {
+    NRF_LOG_WARNING("scan gap timeout");
+    scan_resume();
+}
+
+static void storage_busy_handler(bool busy) {
+    if (!busy) {
+        /* check whether garbage collection is required */
+        gd_sched_post(GD_EVT_GC);
+    }
+#if GD_SCAN_FLASH_GAP
+    /* open a scan gap while the storage layer has a flash operation pending */
+    if (busy) {
+        scan_paused = true;
+        gd_hal_scan_stop();
+        gd_hal_timer_start(scan_gap_timer, GD_SCAN_GAP_MAX_MS, NULL);
+    } else {
+        scan_resume();
+    }
+#endif
+}
+
+void gd_rx_init(void) {
+    APP_ERROR_CHECK(NRF_ATFIFO_INIT(gd_adv_fifo));
+    APP_ERROR_CHECK(NRF_ATFIFO_INIT(gd_accept_fifo));
+    gd_hal_timer_create(&scan_gap_timer, false, scan_gap_timeout_handler);
+    gds_set_busy_handler(storage_busy_handler);
+    gd_hal_scan_start();
+}
+
+/* Actuation class: execute verified commands */
+void gd_rx_accept_evt_handler(void) {
+    nrf_atfifo_item_get_t fifo_context;
+    gd_accepted_t *acc;
+    while ((acc = nrf_atfifo_item_get(gd_accept_fifo, &fifo_context)) != NULL) {
+        if (acc->persisted) {
+            gd_act_submit(acc->msg.cmd, acc->t_rx);
+            uint32_t ticks = (gd_hal_counter() - acc->t_rx) & GD_HAL_COUNTER_MASK;
+            gds_flash_record_actuation(GD_TIME_TICKS_TO_US(ticks), acc->erase_count);
+            gd_ack_send(&acc->uuid, acc->key, &acc->msg);
+        }
+        nrf_atfifo_item_free(gd_accept_fifo, &fifo_context);
+    }
+}
+
+/* Verification class: one report per run so that an accepted command is
+ * executed before the next report is verified */
+void gd_rx_adv_evt_handler(void) {
+    nrf_atfifo_item_get_t fifo_context;
+    gd_adv_data_t *ad = nrf_atfifo_item_get(gd_adv_fifo, &fifo_context);
+    if (ad != NULL) {
+        gd_trace_mark(GD_TRACE_DEQUEUE, ad->t_rx);
+        handle_adv_data(ad);
+        nrf_atfifo_item_free(gd_adv_fifo, &fifo_context);
+        gd_sched_post(GD_EVT_ADV);
+    }
+}
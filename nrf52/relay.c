@@ -0,0 +1,126 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Relay driver (TIMER, PPI and GPIOTE)
+ *
+ * Each timer runs at 1 MHz. Compare channel 0 (1 us after the start) sets
+ * the relay pin, compare channel 1 clears it and stops the timer. The
+ * interrupt of compare channel 1 is only used for bookkeeping.
+ */
+
+#include <relay.h>
+#include <gd_config.h>
+#include <ramfunc.h>
+
+#include <app_error.h>
+#include <app_util.h>
+#include <nrf_soc.h>
+#include <nrfx_gpiote.h>
+#include <nrfx_timer.h>
+
+#define GD_RELAY_CC_SET NRF_TIMER_CC_CHANNEL0
+#define GD_RELAY_CC_CLR NRF_TIMER_CC_CHANNEL1
+
+/* delay between the timer start and the rising edge */
+#define GD_RELAY_START_DELAY_US 1
+
+GD_RAMDATA static const nrfx_timer_t gd_relay_timer[GD_RELAY_CHANNELS] = {
+    NRFX_TIMER_INSTANCE(1),
+#if GD_RELAY_CHANNELS > 1
+    NRFX_TIMER_INSTANCE(2),
+#endif
+#if GD_RELAY_CHANNELS > 2
+    NRFX_TIMER_INSTANCE(3),
+#endif
+};
+
+static const uint32_t gd_relay_pin[GD_RELAY_CHANNELS] = GD_PINNO_RELAYS;
+
+static volatile bool gd_relay_on[GD_RELAY_CHANNELS];
+
+/* the HFCLK is requested while at least one pulse is running */
+static volatile unsigned gd_relay_active;
+
+GD_RAMFUNC static void gd_relay_timer_handler(nrf_timer_event_t event, void *context) {
+    unsigned ch = (unsigned)(uintptr_t)context;
+    if (event == NRF_TIMER_EVENT_COMPARE1) {
+        /* the pin has already been cleared by the PPI */
+        nrfx_timer_disable(&gd_relay_timer[ch]);
+        gd_relay_on[ch] = false;
+        if (--gd_relay_active == 0) {
+            APP_ERROR_CHECK(sd_clock_hfclk_release());
+        }
+    }
+}
+
+GD_RAMFUNC static bool gd_relay_pulse(unsigned ch, uint32_t width_us) {
+    if (ch >= GD_RELAY_CHANNELS || gd_relay_on[ch]) {
+        return false;
+    }
+    const nrfx_timer_t *timer = &gd_relay_timer[ch];
+    gd_relay_on[ch] = true;
+    /* the crystal oscillator improves the accuracy of longer pulses; the
+     * timer starts immediately with the internal oscillator */
+    if (gd_relay_active++ == 0) {
+        APP_ERROR_CHECK(sd_clock_hfclk_request());
+    }
+    nrfx_timer_clear(timer);
+    nrfx_timer_compare(timer,
+                       GD_RELAY_CC_SET,
+                       nrfx_timer_us_to_ticks(timer, GD_RELAY_START_DELAY_US),
+                       false);
+    nrfx_timer_extended_compare(timer,
+                                GD_RELAY_CC_CLR,
+                                nrfx_timer_us_to_ticks(timer,
+                                                       GD_RELAY_START_DELAY_US + width_us),
+                                NRF_TIMER_SHORT_COMPARE1_STOP_MASK,
+                                true);
+    nrfx_timer_enable(timer);
+    return true;
+}
+
+GD_RAMFUNC static bool gd_relay_is_on(unsigned ch) {
+    return ch < GD_RELAY_CHANNELS && gd_relay_on[ch];
+}
+
+GD_RAMDATA const gd_relay_driver_t gd_relay_ppi_driver = {
+    .pulse = gd_relay_pulse,
+    .is_on = gd_relay_is_on,
+};
+
+void gd_relay_init(void) {
+    if (!nrfx_gpiote_is_init()) {
+        APP_ERROR_CHECK(nrfx_gpiote_init());
+    }
+    uint32_t ppi_mask = 0;
+    for (unsigned ch = 0; ch < GD_RELAY_CHANNELS; ch++) {
+        const nrfx_timer_t *timer = &gd_relay_timer[ch];
+        nrfx_timer_config_t timer_config = NRFX_TIMER_DEFAULT_CONFIG;
+        timer_config.frequency = NRF_TIMER_FREQ_1MHz;
+        timer_config.bit_width = NRF_TIMER_BIT_WIDTH_32;
+        timer_config.p_context = (void *)(uintptr_t)ch;
+        APP_ERROR_CHECK(nrfx_timer_init(timer, &timer_config, gd_relay_timer_handler));
+
+        nrfx_gpiote_out_config_t out_config = NRFX_GPIOTE_CONFIG_OUT_TASK_TOGGLE(false);
+        APP_ERROR_CHECK(nrfx_gpiote_out_init(gd_relay_pin[ch], &out_config));
+        nrfx_gpiote_out_task_enable(gd_relay_pin[ch]);
+
+        /* PPI registers are owned by the SoftDevice */
+        uint8_t ppi_set = GD_RELAY_PPI_CH_BASE + 2 * ch;
+        uint8_t ppi_clr = ppi_set + 1;
+        APP_ERROR_CHECK(sd_ppi_channel_assign(
+            ppi_set,
+            (const volatile void *)nrfx_timer_compare_event_address_get(timer, GD_RELAY_CC_SET),
+            (const volatile void *)nrfx_gpiote_set_task_addr_get(gd_relay_pin[ch])));
+        APP_ERROR_CHECK(sd_ppi_channel_assign(
+            ppi_clr,
+            (const volatile void *)nrfx_timer_compare_event_address_get(timer, GD_RELAY_CC_CLR),
+            (const volatile void *)nrfx_gpiote_clr_task_addr_get(gd_relay_pin[ch])));
+        ppi_mask |= (1UL << ppi_set) | (1UL << ppi_clr);
+    }
+    APP_ERROR_CHECK(sd_ppi_channel_enable_set(ppi_mask));
+}
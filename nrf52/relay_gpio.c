@@ -0,0 +1,57 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Relay driver (HAL GPIO and timers)
+ *
+ * The pin is set when the pulse is started and cleared by a timer, so the
+ * pulse width depends on the interrupt latency. Hardware independent
+ * replacement of relay.c for the host simulator.
+ */
+
+#include <relay.h>
+#include <gd_config.h>
+#include <hal.h>
+
+#include <app_util.h>
+#include <nrf_gpio.h>
+
+static const uint32_t gd_relay_gpio_pin[GD_RELAY_CHANNELS] = GD_PINNO_RELAYS;
+
+static gd_hal_timer_t gd_relay_gpio_timer[GD_RELAY_CHANNELS];
+
+static void gd_relay_gpio_timer_handler(void *context) {
+    unsigned ch = (unsigned)(uintptr_t)context;
+    gd_hal_gpio_write(gd_relay_gpio_pin[ch], false);
+}
+
+static bool gd_relay_gpio_is_on(unsigned channel) {
+    return gd_hal_gpio_get_output(gd_relay_gpio_pin[channel]);
+}
+
+static bool gd_relay_gpio_pulse(unsigned channel, uint32_t width_us) {
+    bool started = false;
+    GD_HAL_CRITICAL_ENTER();
+    if (!gd_relay_gpio_is_on(channel)) {
+        gd_hal_gpio_write(gd_relay_gpio_pin[channel], true);
+        gd_hal_timer_start(gd_relay_gpio_timer[channel], CEIL_DIV(width_us, 1000),
+                           (void *)(uintptr_t)channel);
+        started = true;
+    }
+    GD_HAL_CRITICAL_EXIT();
+    return started;
+}
+
+const gd_relay_driver_t gd_relay_gpio_driver = {
+    .pulse = gd_relay_gpio_pulse,
+    .is_on = gd_relay_gpio_is_on};
+
+void gd_relay_gpio_init(void) {
+    for (unsigned ch = 0; ch < GD_RELAY_CHANNELS; ch++) {
+        gd_hal_gpio_output(gd_relay_gpio_pin[ch], false);
+        gd_hal_timer_create(&gd_relay_gpio_timer[ch], false, gd_relay_gpio_timer_handler);
+    }
+}
@@ -0,0 +1,192 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Cooperative priority scheduler for the main loop
+ */
+
+#include <scheduler.h>
+#include <hal.h>
+#include <systime.h>
+
+#include <nrf_log.h>
+#include <string.h>
+
+typedef struct {
+    const char *name;
+    gd_sched_handler_t handler;
+    gd_prio_t prio;
+    uint64_t post_ticks; /* first post while pending */
+    gd_sched_handler_stats_t stats;
+} gd_sched_entry_t;
+
+static const char *const gd_sched_class_names[GD_PRIO_COUNT] = {
+    "actuation", "verify", "storage", "maint"};
+
+static gd_sched_clock_t gd_sched_clock;
+static gd_sched_entry_t gd_sched_table[GD_EVT_COUNT];
+static gd_sched_class_stats_t gd_sched_class_stats[GD_PRIO_COUNT];
+static volatile uint32_t gd_sched_pending;
+static gd_prio_t gd_sched_current; /* class of the running handler */
+static gd_evt_t gd_sched_last;
+
+static uint64_t gd_sched_interval_start;
+static uint64_t gd_sched_sleep_ticks;
+static uint64_t gd_sched_sleep_total;
+static uint32_t gd_sched_wakeups;
+
+void gd_sched_init(gd_sched_clock_t clock) {
+    gd_sched_clock = clock;
+    memset(gd_sched_table, 0, sizeof(gd_sched_table));
+    memset(gd_sched_class_stats, 0, sizeof(gd_sched_class_stats));
+    gd_sched_pending = 0;
+    gd_sched_current = GD_PRIO_COUNT;
+    gd_sched_last = GD_EVT_COUNT;
+    gd_sched_interval_start = clock();
+    gd_sched_sleep_ticks = 0;
+    gd_sched_sleep_total = 0;
+    gd_sched_wakeups = 0;
+}
+
+void gd_sched_register(gd_evt_t evt, gd_prio_t prio, const char *name,
+                       gd_sched_handler_t handler) {
+    gd_sched_table[evt].name = name;
+    gd_sched_table[evt].prio = prio;
+    gd_sched_table[evt].handler = handler;
+}
+
+void gd_sched_post(gd_evt_t evt) {
+    uint32_t mask = 1UL << evt;
+    GD_HAL_CRITICAL_ENTER();
+    if ((gd_sched_pending & mask) == 0) {
+        gd_sched_table[evt].post_ticks = gd_sched_clock();
+        gd_sched_pending |= mask;
+    }
+    GD_HAL_CRITICAL_EXIT();
+}
+
+/* Run the pending event of the highest class above limit.
+ * Returns false if there is none.
+ */
+static bool gd_sched_run_one(gd_prio_t limit) {
+    gd_sched_entry_t *e = NULL;
+    GD_HAL_CRITICAL_ENTER();
+    for (unsigned evt = 0; evt < GD_EVT_COUNT; evt++) {
+        gd_sched_entry_t *c = &gd_sched_table[evt];
+        if ((gd_sched_pending & (1UL << evt)) != 0 &&
+            c->prio < limit &&
+            (e == NULL || c->prio < e->prio)) {
+            e = c;
+        }
+    }
+    if (e != NULL) {
+        gd_sched_pending &= ~(1UL << (e - gd_sched_table));
+    }
+    GD_HAL_CRITICAL_EXIT();
+    if (e == NULL) {
+        return false;
+    }
+
+    uint64_t start = gd_sched_clock();
+    gd_sched_class_stats_t *cs = &gd_sched_class_stats[e->prio];
+    uint32_t latency = start - e->post_ticks;
+    cs->runs++;
+    if (latency > cs->max_latency_ticks) {
+        cs->max_latency_ticks = latency;
+    }
+    if (e->handler != NULL) {
+        gd_prio_t prev = gd_sched_current;
+        gd_sched_current = e->prio;
+        gd_sched_last = e - gd_sched_table;
+        e->handler();
+        gd_sched_current = prev;
+    }
+    uint32_t ticks = gd_sched_clock() - start;
+    e->stats.runs++;
+    e->stats.total_ticks += ticks;
+    if (ticks > e->stats.max_ticks) {
+        e->stats.max_ticks = ticks;
+    }
+    return true;
+}
+
+void gd_sched_execute(void) {
+    while (gd_sched_run_one(GD_PRIO_COUNT)) {}
+}
+
+bool gd_sched_yield(void) {
+    bool ran = false;
+    if (gd_sched_current == GD_PRIO_COUNT) {
+        /* not called by a handler, the caller may be the scheduler itself */
+        return false;
+    }
+    while (gd_sched_run_one(gd_sched_current)) {
+        ran = true;
+    }
+    return ran;
+}
+
+gd_evt_t gd_sched_last_event(void) {
+    return gd_sched_last;
+}
+
+/* Interrupt service routines that run before returning from sleep are
+ * accounted as idle time. */
+void gd_sched_sleep(void) {
+    uint64_t start = gd_sched_clock();
+    gd_hal_sleep();
+    uint64_t ticks = gd_sched_clock() - start;
+    gd_sched_sleep_ticks += ticks;
+    gd_sched_sleep_total += ticks;
+    gd_sched_wakeups++;
+}
+
+uint64_t gd_sched_get_sleep_ticks(void) {
+    return gd_sched_sleep_total;
+}
+
+void gd_sched_get_handler_stats(gd_evt_t evt, gd_sched_handler_stats_t *stats) {
+    *stats = gd_sched_table[evt].stats;
+}
+
+void gd_sched_get_class_stats(gd_prio_t prio, gd_sched_class_stats_t *stats) {
+    *stats = gd_sched_class_stats[prio];
+}
+
+void gd_sched_log_stats(void) {
+    uint64_t now = gd_sched_clock();
+    uint64_t elapsed = now - gd_sched_interval_start;
+    if (GD_TIME_TICKS_TO_MS(elapsed) == 0) {
+        return;
+    }
+    for (unsigned evt = 0; evt < GD_EVT_COUNT; evt++) {
+        gd_sched_entry_t *e = &gd_sched_table[evt];
+        if (e->handler == NULL) {
+            continue;
+        }
+        NRF_LOG_INFO("%s: runs: %u, avg: %u us, max: %u us",
+                     e->name,
+                     e->stats.runs,
+                     e->stats.runs ? (uint32_t)GD_TIME_TICKS_TO_US(e->stats.total_ticks / e->stats.runs) : 0,
+                     (uint32_t)GD_TIME_TICKS_TO_US(e->stats.max_ticks));
+        memset(&e->stats, 0, sizeof(e->stats));
+    }
+    for (unsigned prio = 0; prio < GD_PRIO_COUNT; prio++) {
+        gd_sched_class_stats_t *cs = &gd_sched_class_stats[prio];
+        NRF_LOG_INFO("class %s: runs: %u, max. latency: %u us",
+                     gd_sched_class_names[prio],
+                     cs->runs,
+                     (uint32_t)GD_TIME_TICKS_TO_US(cs->max_latency_ticks));
+        memset(cs, 0, sizeof(*cs));
+    }
+    NRF_LOG_INFO("wakeups per hour: %u, idle: %u.%u %%",
+                 (uint32_t)((uint64_t)gd_sched_wakeups * 3600 * 1000 / GD_TIME_TICKS_TO_MS(elapsed)),
+                 (uint32_t)(gd_sched_sleep_ticks * 100 / elapsed),
+                 (uint32_t)(gd_sched_sleep_ticks * 1000 / elapsed % 10));
+    gd_sched_wakeups = 0;
+    gd_sched_sleep_ticks = 0;
+    gd_sched_interval_start = now;
+}
@@ -0,0 +1,135 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Main loop stall detector
+ */
+
+#include <stall.h>
+#include <ramfunc.h>
+#include <scheduler.h>
+#include <systime.h>
+
+#include <nrf_log.h>
+#include <string.h>
+
+static const char *const gd_stall_site_names[GD_STALL_SITE_COUNT] = {
+    "handler", "flash_wait", "clear", "log"};
+
+static gd_stall_stats_t gd_stall_stats;
+static uint64_t gd_stall_init_ticks;
+
+/* current iteration */
+static uint64_t gd_stall_iter_start;
+static uint64_t gd_stall_site_ticks[GD_STALL_SITE_COUNT];
+static uint32_t gd_stall_iter_reports;
+static uint32_t gd_stall_iter_drops;
+
+/* written in interrupt context only */
+static volatile uint32_t gd_stall_reports;
+static volatile uint32_t gd_stall_drops;
+
+void gd_stall_init(void) {
+    memset(&gd_stall_stats, 0, sizeof(gd_stall_stats));
+    gd_stall_init_ticks = gd_time_ticks();
+}
+
+void gd_stall_iter_begin(void) {
+    memset(gd_stall_site_ticks, 0, sizeof(gd_stall_site_ticks));
+    gd_stall_iter_reports = gd_stall_reports;
+    gd_stall_iter_drops = gd_stall_drops;
+    gd_stall_iter_start = gd_time_ticks();
+}
+
+void gd_stall_iter_end(void) {
+    uint64_t now = gd_time_ticks();
+    uint32_t us = GD_TIME_TICKS_TO_US(now - gd_stall_iter_start);
+    gd_stall_stats_t *s = &gd_stall_stats;
+
+    s->iterations++;
+    if (us > s->max_us) {
+        s->max_us = us;
+    }
+    unsigned bin = 0;
+    while (bin < GD_STALL_HIST_BINS - 1 && us >= (1000U << bin)) {
+        bin++;
+    }
+    s->hist[bin]++;
+
+    /* the sections may be nested, so the handler time is estimated by the
+     * time outside of the longest section */
+    uint64_t longest = 0;
+    gd_stall_site_t site = GD_STALL_SITE_HANDLER;
+    for (unsigned i = GD_STALL_SITE_HANDLER + 1; i < GD_STALL_SITE_COUNT; i++) {
+        if (gd_stall_site_ticks[i] >= longest && gd_stall_site_ticks[i] > 0) {
+            longest = gd_stall_site_ticks[i];
+            site = i;
+        }
+    }
+    gd_stall_site_ticks[GD_STALL_SITE_HANDLER] = now - gd_stall_iter_start - longest;
+    if (gd_stall_site_ticks[GD_STALL_SITE_HANDLER] > longest) {
+        site = GD_STALL_SITE_HANDLER;
+    }
+    for (unsigned i = 0; i < GD_STALL_SITE_COUNT; i++) {
+        uint32_t site_us = GD_TIME_TICKS_TO_US(gd_stall_site_ticks[i]);
+        if (site_us > s->sites[i].max_us) {
+            s->sites[i].max_us = site_us;
+        }
+    }
+
+    if (us <= GD_STALL_BUDGET_MS * 1000) {
+        return;
+    }
+    uint32_t reports = gd_stall_reports - gd_stall_iter_reports;
+    uint32_t drops = gd_stall_drops - gd_stall_iter_drops;
+    uint64_t uptime = now - gd_stall_init_ticks;
+    uint32_t expected = uptime ? (uint64_t)gd_stall_reports * (now - gd_stall_iter_start) / uptime : 0;
+    s->stalls++;
+    s->sites[site].stalls++;
+    s->reports_delayed += reports - drops;
+    s->reports_dropped += drops;
+    s->reports_expected += expected;
+    NRF_LOG_WARNING("stall of %u us in %s (last event %u), reports: %u delayed, %u dropped",
+                    us, gd_stall_site_names[site], gd_sched_last_event(),
+                    reports - drops, drops);
+}
+
+uint64_t gd_stall_section_begin(void) {
+    return gd_time_ticks();
+}
+
+void gd_stall_section_end(gd_stall_section_t *section) {
+    gd_stall_site_ticks[section->site] += gd_time_ticks() - section->start;
+}
+
+GD_RAMFUNC void gd_stall_report(bool dropped) {
+    gd_stall_reports++;
+    if (dropped) {
+        gd_stall_drops++;
+    }
+}
+
+void gd_stall_get_stats(gd_stall_stats_t *stats) {
+    *stats = gd_stall_stats;
+}
+
+void gd_stall_log(void) {
+    const gd_stall_stats_t *s = &gd_stall_stats;
+    NRF_LOG_INFO("main loop: %u iterations, %u stalls > %u ms, max = %u us",
+                 s->iterations, s->stalls, GD_STALL_BUDGET_MS, s->max_us);
+    for (unsigned i = 0; i < GD_STALL_HIST_BINS; i++) {
+        NRF_LOG_INFO("iteration %s%3u ms: %u",
+                     i < GD_STALL_HIST_BINS - 1 ? "< " : ">=",
+                     i < GD_STALL_HIST_BINS - 1 ? 1U << i : 1U << (i - 1),
+                     s->hist[i]);
+    }
+    for (unsigned i = 0; i < GD_STALL_SITE_COUNT; i++) {
+        NRF_LOG_INFO("stall site %s: %u stalls, max = %u us",
+                     gd_stall_site_names[i], s->sites[i].stalls, s->sites[i].max_us);
+    }
+    NRF_LOG_INFO("reports during stalls: %u delayed, %u dropped, %u expected",
+                 s->reports_delayed, s->reports_dropped, s->reports_expected);
+}
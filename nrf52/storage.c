@@ -9,93 +9,267 @@
  */
 
 #include <storage.h>
+#include <flash.h>
+#include <hal.h>
+#include <metrics.h>
+#include <prof.h>
+#include <scheduler.h>
+#include <stall.h>
+#include <systime.h>
 
+#include <app_error.h>
+#include <app_util.h>
 #include <nrf_log.h>
 #include "nrf_log_ctrl.h"
+#if defined(SOFTDEVICE_PRESENT)
+#include <nrf_sdh_soc.h>
+#endif
 #include <string.h>
 
 #define GDS_TXINFO_FILE_ID 0x1000
 #define GDS_TXREC_KEY      0x0001
 #define GDS_SEQNOREC_KEY   0x0002
 
+#define GDS_SOC_OBSERVER_PRIO 1
+
+/* maximum number of flash operations in flight (begun but not completed) */
+#define GDS_MAX_OPS 8
+
+STATIC_ASSERT(GDS_MAX_OPS > GD_PRIO_COUNT);
+
+/* FDS page tag (FDS_PAGE_TAG_SIZE, not exported by FDS) */
+#define GDS_PAGE_TAG_WORDS 2
+
+/* usable words; one virtual page is used for garbage collection */
+#define GDS_CAPACITY_WORDS \
+    ((FDS_VIRTUAL_PAGES - FDS_VIRTUAL_PAGES_RESERVED - 1) * \
+     (FDS_VIRTUAL_PAGE_SIZE - GDS_PAGE_TAG_WORDS))
+
 static volatile bool gds_init_done;
-static volatile bool gds_flash_access_done;
+static volatile bool gds_gc_running;
 
+/* While all records are being deleted, transmitters are unknown. Handlers
+ * run from gd_sched_yield() during the deletion must neither find the
+ * records still in flash nor bring them back into the cache. */
+static bool gds_clearing;
+
+/* Flash operations are completed in the order they are queued. Each one gets
+ * a ticket, so that nested operations (started by handlers run from
+ * gd_sched_yield() while waiting) can wait for their own completion. At most
+ * GDS_MAX_OPS operations are in flight (one waiting per priority class and
+ * garbage collection). */
+static volatile uint32_t gds_ops_begun;
+static volatile uint32_t gds_ops_done;
+static uint64_t gds_op_start[GDS_MAX_OPS];
+static bool gds_op_ok[GDS_MAX_OPS]; /* result of a completed operation */
+
+static gds_busy_handler_t gds_busy_handler;
+static gds_stats_t gds_stats;
+
+/* recently used transmitter records, saves searching all FDS records for
+ * each advertising report. A descriptor remains valid after garbage
+ * collection (FDS finds the record by its ID again). */
 typedef struct {
-    ble_uuid128_t uuid; /* Transmitter UUID (Little Endian) */
+    ble_uuid128_t uuid;
+    fds_record_desc_t desc; /* transmitter record */
+    uint32_t outputs;
+    uint32_t base_seq_no;   /* see gds_transmitter_record_t */
+    uint32_t seq_no;        /* stored sequence number if seq_no_valid */
+    uint32_t last_use;
+    bool seq_no_valid;
+    bool valid;
+} gds_tx_cache_t;
+
+static gds_tx_cache_t gds_tx_cache[GDS_TX_CACHE_SIZE];
+static uint32_t gds_tx_cache_uses;
+
+/* A transmitter record is updated when outputs are added, which assigns a
+ * new record ID. The seq_no record still refers to the old ID then, so the
+ * updated record carries the sequence number itself (base_seq_no). The
+ * update is a single FDS operation; the old seq_no record is deleted
+ * afterwards and never matches again if that is interrupted (record IDs are
+ * not reused). */
+typedef struct {
+    ble_uuid128_t uuid;   /* Transmitter UUID (Little Endian) */
+    uint32_t outputs;     /* permitted output channels (bit n: channel n) */
+    uint32_t base_seq_no; /* stored sequence number when the record was written */
 } gds_transmitter_record_t;
 
+/* Records written before output permissions were introduced contain the
+ * UUID only. These transmitters may use output channel 0. */
+#define GDS_LEGACY_TX_REC_WORDS (sizeof(ble_uuid128_t) / sizeof(uint32_t))
+#define GDS_LEGACY_TX_OUTPUTS   0x00000001
+
 typedef struct {
     uint32_t txrecid; /* record ID of transmitter record */
     uint32_t seq_no;
 } gds_seq_no_record_t;
 
-/* Get record_desc of a transmitter record specified by an UUID
- * Returns true if transmitter exists and record_desc is set accordingly
- */
-static bool gds_get_tx_rec(const ble_uuid128_t *uuid, fds_record_desc_t *record_desc) {
+/* To be called before a flash operation is queued. Sets a ticket for
+ * gds_op_wait(). Returns false if too many operations are in flight. */
+static bool gds_op_begin(uint32_t *ticket) {
+    bool idle;
+    bool full;
+    GD_HAL_CRITICAL_ENTER();
+    full = gds_ops_begun - gds_ops_done >= GDS_MAX_OPS;
+    if (!full) {
+        *ticket = gds_ops_begun++;
+        idle = *ticket == gds_ops_done;
+        gds_op_start[*ticket % GDS_MAX_OPS] = gd_time_ticks();
+        gd_metric_set(GD_METRIC_FLASH_PENDING, gds_ops_begun - gds_ops_done);
+    }
+    GD_HAL_CRITICAL_EXIT();
+    if (full) {
+        NRF_LOG_ERROR("too many flash operations in flight");
+        gds_stats.failures++;
+        gd_metric_inc(GD_METRIC_FLASH_FAILURES);
+        return false;
+    }
+    if (idle && gds_busy_handler != NULL) {
+        gds_busy_handler(true);
+    }
+    return true;
+}
 
-    fds_flash_record_t record;
-    fds_find_token_t ftok;
+/* To be called if the operation could not be queued (right after
+ * gds_op_begin()) */
+static void gds_op_cancel(void) {
+    bool idle;
+    GD_HAL_CRITICAL_ENTER();
+    gds_ops_begun--;
+    idle = gds_ops_begun == gds_ops_done;
+    gd_metric_set(GD_METRIC_FLASH_PENDING, gds_ops_begun - gds_ops_done);
+    GD_HAL_CRITICAL_EXIT();
+    gds_stats.failures++;
+    gd_metric_inc(GD_METRIC_FLASH_FAILURES);
+    if (idle && gds_busy_handler != NULL) {
+        gds_busy_handler(false);
+    }
+}
 
-    memset(&ftok, 0x00, sizeof(fds_find_token_t));
-    while (fds_record_find(GDS_TXINFO_FILE_ID, GDS_TXREC_KEY,
-                           record_desc, &ftok) == NRF_SUCCESS) {
-        if (fds_record_open(record_desc, &record) != NRF_SUCCESS) {
-            NRF_LOG_ERROR("could not open FDS record");
-            continue;
+/* To be called when a flash operation is completed */
+static void gds_op_end(bool ok) {
+    bool idle;
+    uint32_t latency;
+    GD_HAL_CRITICAL_ENTER();
+    latency = GD_TIME_TICKS_TO_US(gd_time_ticks() - gds_op_start[gds_ops_done % GDS_MAX_OPS]);
+    gds_op_ok[gds_ops_done % GDS_MAX_OPS] = ok;
+    gds_ops_done++;
+    idle = gds_ops_begun == gds_ops_done;
+    gd_metric_set(GD_METRIC_FLASH_PENDING, gds_ops_begun - gds_ops_done);
+    if (ok) {
+        gds_stats.ops++;
+        gds_stats.latency_sum_us += latency;
+        if (latency > gds_stats.latency_max_us) {
+            gds_stats.latency_max_us = latency;
         }
-        gds_transmitter_record_t *tx = (gds_transmitter_record_t *)record.p_data;
-        if (memcmp(uuid, &tx->uuid, sizeof(ble_uuid128_t)) == 0) {
-            APP_ERROR_CHECK(fds_record_close(record_desc));
-            return true;
+    } else {
+        gds_stats.failures++;
+    }
+    GD_HAL_CRITICAL_EXIT();
+    gd_metric_inc(ok ? GD_METRIC_FLASH_OPS : GD_METRIC_FLASH_FAILURES);
+    gd_metric_observe(GD_METRIC_FLASH_LATENCY_MS, latency / 1000);
+    NRF_LOG_DEBUG("flash operation done: ok = %d, latency = %u us, retries = %u",
+                  ok, latency, gds_stats.retries);
+    if (idle && gds_busy_handler != NULL) {
+        gds_busy_handler(false);
+    }
+}
+
+/* Wait for the completion of an operation and return its result. Pending
+ * events of higher priority classes are handled meanwhile (not during
+ * initialization, see gd_sched_yield()). The handlers run there may wait for
+ * operations of their own, so the nesting depth is limited by the number of
+ * classes. */
+static bool gds_op_wait(uint32_t ticket) {
+    GD_STALL_SECTION(GD_STALL_SITE_FLASH_WAIT);
+    while ((int32_t)(gds_ops_done - ticket) <= 0) {
+        if (!gd_sched_yield()) {
+            gd_hal_sleep();
         }
-        APP_ERROR_CHECK(fds_record_close(record_desc));
     }
-    return false;
+    return gds_op_ok[ticket % GDS_MAX_OPS];
 }
 
-/* Get record ID of a transmitter record specified by an UUID
- * Returns true if transmitter exists and *id is set accordingly
- */
-static bool gds_get_tx_recid(const ble_uuid128_t *uuid, uint32_t *id) {
-    fds_record_desc_t record_desc;
-    if (gds_get_tx_rec(uuid, &record_desc)) {
-        APP_ERROR_CHECK(fds_record_id_from_desc(&record_desc, id));
-        return true;
-    } else {
-        return false;
+static uint32_t gds_tx_rec_outputs(const fds_flash_record_t *record) {
+    if (record->p_header->length_words <= GDS_LEGACY_TX_REC_WORDS) {
+        return GDS_LEGACY_TX_OUTPUTS;
     }
+    return ((const gds_transmitter_record_t *)record->p_data)->outputs;
 }
 
-/* create a new TX record if it does not exist.
- * returns true on success (i.e. record exists or was successfully created)
+static uint32_t gds_tx_rec_base_seq_no(const fds_flash_record_t *record) {
+    if (record->p_header->length_words < sizeof(gds_transmitter_record_t) / sizeof(uint32_t)) {
+        return 0;
+    }
+    return ((const gds_transmitter_record_t *)record->p_data)->base_seq_no;
+}
+
+static gds_tx_cache_t *gds_find_cached_tx(const ble_uuid128_t *uuid) {
+    for (size_t i = 0; i < GDS_TX_CACHE_SIZE; i++) {
+        gds_tx_cache_t *c = &gds_tx_cache[i];
+        if (c->valid && memcmp(&c->uuid, uuid, sizeof(ble_uuid128_t)) == 0) {
+            c->last_use = ++gds_tx_cache_uses;
+            return c;
+        }
+    }
+    return NULL;
+}
+
+/* add a transmitter record, replacing the least recently used one */
+static gds_tx_cache_t *gds_cache_tx(const ble_uuid128_t *uuid,
+                                    const fds_record_desc_t *desc,
+                                    const fds_flash_record_t *record) {
+    gds_tx_cache_t *c = &gds_tx_cache[0];
+    for (size_t i = 0; i < GDS_TX_CACHE_SIZE && c->valid; i++) {
+        if (!gds_tx_cache[i].valid ||
+            (int32_t)(gds_tx_cache[i].last_use - c->last_use) < 0) {
+            c = &gds_tx_cache[i];
+        }
+    }
+    c->uuid = *uuid;
+    c->desc = *desc;
+    c->outputs = gds_tx_rec_outputs(record);
+    c->base_seq_no = gds_tx_rec_base_seq_no(record);
+    c->last_use = ++gds_tx_cache_uses;
+    c->seq_no_valid = false;
+    c->valid = true;
+    return c;
+}
+
+/* Get the cache entry of a transmitter record specified by an UUID
+ * Returns NULL if the transmitter does not exist
  */
-bool gds_create_tx_record(const ble_uuid128_t *uuid) {
+static gds_tx_cache_t *gds_get_tx(const ble_uuid128_t *uuid) {
+    GD_PROF_SCOPE(GD_PROF_TX_REC);
+
     fds_record_desc_t record_desc;
-    if (gds_get_tx_rec(uuid, &record_desc)) {
-        return true;
-    } else {
-        gds_transmitter_record_t recdata;
-        memcpy(recdata.uuid.uuid128, uuid, sizeof(ble_uuid128_t));
-        fds_record_t record = {
-            .file_id = GDS_TXINFO_FILE_ID,
-            .key = GDS_TXREC_KEY,
-            .data = {
-                .p_data = &recdata,
-                .length_words = sizeof(recdata) / sizeof(uint32_t)}};
-        gds_flash_access_done = false;
-        ret_code_t r = fds_record_write(&record_desc, &record);
-        if (r != NRF_SUCCESS) {
-            NRF_LOG_ERROR("could not write TX record, result = %08x", r);
-            return false;
+    fds_flash_record_t record;
+    fds_find_token_t ftok;
+
+    if (gds_clearing) {
+        return NULL;
+    }
+    gds_tx_cache_t *c = gds_find_cached_tx(uuid);
+    if (c != NULL) {
+        return c;
+    }
+    memset(&ftok, 0x00, sizeof(fds_find_token_t));
+    while (fds_record_find(GDS_TXINFO_FILE_ID, GDS_TXREC_KEY,
+                           &record_desc, &ftok) == NRF_SUCCESS) {
+        if (fds_record_open(&record_desc, &record) != NRF_SUCCESS) {
+            NRF_LOG_ERROR("could not open FDS record");
+            continue;
         }
-        /* wait for completion. We cannot return from the function earlier
-         * because the data is stack allocated */
-        NRF_LOG_DEBUG("waiting for write completion");
-        while (!gds_flash_access_done) {}
-        return true;
+        gds_transmitter_record_t *tx = (gds_transmitter_record_t *)record.p_data;
+        if (memcmp(uuid, &tx->uuid, sizeof(ble_uuid128_t)) == 0) {
+            c = gds_cache_tx(uuid, &record_desc, &record);
+            APP_ERROR_CHECK(fds_record_close(&record_desc));
+            return c;
+        }
+        APP_ERROR_CHECK(fds_record_close(&record_desc));
     }
+    return NULL;
 }
 
 static bool gds_find_seq_no_record(uint32_t txrecid, fds_record_desc_t *record_desc) {
@@ -117,35 +291,136 @@ static bool gds_find_seq_no_record(uint32_t txrecid, fds_record_desc_t *record_d
     return false;
 }
 
+/* Write (record_desc == NULL) or update a record and wait for completion.
+ * The data must remain valid until then. */
+static bool gds_write_record(fds_record_desc_t *record_desc, uint16_t key,
+                             const void *data, size_t size) {
+    fds_record_t record = {
+        .file_id = GDS_TXINFO_FILE_ID,
+        .key = key,
+        .data = {
+            .p_data = data,
+            .length_words = size / sizeof(uint32_t)}};
+    fds_record_desc_t desc;
+    uint32_t ticket;
+    if (!gds_op_begin(&ticket)) {
+        return false;
+    }
+    ret_code_t r = record_desc != NULL ? fds_record_update(record_desc, &record)
+                                       : fds_record_write(&desc, &record);
+    if (r != NRF_SUCCESS) {
+        NRF_LOG_ERROR("could not write record %04x, result = %08x", key, r);
+        gds_op_cancel();
+        return false;
+    }
+    NRF_LOG_DEBUG("waiting for write completion");
+    return gds_op_wait(ticket);
+}
+
+/* Delete a record and wait for completion */
+static bool gds_delete_record(fds_record_desc_t *record_desc) {
+    uint32_t ticket;
+    if (!gds_op_begin(&ticket)) {
+        return false;
+    }
+    if (fds_record_delete(record_desc) != NRF_SUCCESS) {
+        NRF_LOG_ERROR("could not delete record");
+        gds_op_cancel();
+        return false;
+    }
+    return gds_op_wait(ticket);
+}
+
+/* Add output permissions to an existing TX record. The update assigns a new
+ * record ID; the stored sequence number moves into the updated record and
+ * the seq_no record of the old ID is deleted. */
+static bool gds_add_tx_outputs(const ble_uuid128_t *uuid, gds_tx_cache_t *c,
+                               uint32_t outputs) {
+    gds_transmitter_record_t recdata;
+    fds_record_desc_t record_desc = c->desc;
+    fds_record_desc_t sn_desc;
+    uint32_t old_id;
+    if ((c->outputs | outputs) == c->outputs) {
+        return true;
+    }
+    memcpy(&recdata.uuid, uuid, sizeof(ble_uuid128_t));
+    recdata.outputs = c->outputs | outputs;
+    if (!gds_get_seq_no(uuid, &recdata.base_seq_no)) {
+        return false;
+    }
+    APP_ERROR_CHECK(fds_record_id_from_desc(&record_desc, &old_id));
+    NRF_LOG_INFO("permitting outputs %02x", recdata.outputs);
+    c->valid = false;
+    if (!gds_write_record(&record_desc, GDS_TXREC_KEY, &recdata, sizeof(recdata))) {
+        return false;
+    }
+    if (gds_find_seq_no_record(old_id, &sn_desc)) {
+        gds_delete_record(&sn_desc);
+    }
+    return true;
+}
+
+/* create a new TX record if it does not exist or add output permissions to
+ * an existing one.
+ * returns true on success (i.e. record exists or was successfully created)
+ */
+bool gds_create_tx_record(const ble_uuid128_t *uuid, uint32_t outputs) {
+    if (gds_clearing) {
+        return false;
+    }
+    gds_tx_cache_t *c = gds_get_tx(uuid);
+    if (c != NULL) {
+        return gds_add_tx_outputs(uuid, c, outputs);
+    } else {
+        gds_transmitter_record_t recdata;
+        memcpy(recdata.uuid.uuid128, uuid, sizeof(ble_uuid128_t));
+        recdata.outputs = outputs;
+        recdata.base_seq_no = 0;
+        /* we cannot return from the function before completion because the
+         * data is stack allocated */
+        return gds_write_record(NULL, GDS_TXREC_KEY, &recdata, sizeof(recdata));
+    }
+}
+
+bool gds_get_tx_outputs(const ble_uuid128_t *uuid, uint32_t *outputs) {
+    gds_tx_cache_t *c = gds_get_tx(uuid);
+    if (c == NULL) {
+        return false;
+    }
+    *outputs = c->outputs;
+    return true;
+}
+
 /** Get stored sequence number of a specific transmitter
  * Sets *seq_no to zero if no sequence number record exists.
  * Returns false if transmitter is unknown
  */
 bool gds_get_seq_no(const ble_uuid128_t *uuid, uint32_t *seq_no) {
     *seq_no = 0; /* default seq_no */
-    uint32_t txrecid;
-    if (!gds_get_tx_recid(uuid, &txrecid)) {
+    gds_tx_cache_t *tc = gds_get_tx(uuid);
+    if (tc == NULL) {
         return false;
     }
+    if (tc->seq_no_valid) {
+        *seq_no = tc->seq_no;
+        return true;
+    }
+    uint32_t txrecid;
+    APP_ERROR_CHECK(fds_record_id_from_desc(&tc->desc, &txrecid));
     fds_flash_record_t record;
     fds_record_desc_t record_desc;
-    fds_find_token_t ftok;
-    memset(&ftok, 0x00, sizeof(fds_find_token_t));
-    while (fds_record_find(GDS_TXINFO_FILE_ID, GDS_SEQNOREC_KEY,
-                           &record_desc, &ftok) == NRF_SUCCESS) {
-        if (fds_record_open(&record_desc, &record) != NRF_SUCCESS) {
-            NRF_LOG_ERROR("could not open FDS seq_no record");
-            continue;
-        }
-        gds_seq_no_record_t *sn = (gds_seq_no_record_t *)record.p_data;
-        if (sn->txrecid == txrecid) {
-            *seq_no = sn->seq_no;
-            APP_ERROR_CHECK(fds_record_close(&record_desc));
-            break;
-        } else {
-            APP_ERROR_CHECK(fds_record_close(&record_desc));
-        }
+    if (gds_find_seq_no_record(txrecid, &record_desc) &&
+        fds_record_open(&record_desc, &record) == NRF_SUCCESS) {
+        *seq_no = ((const gds_seq_no_record_t *)record.p_data)->seq_no;
+        APP_ERROR_CHECK(fds_record_close(&record_desc));
+    }
+    /* sequence numbers only grow, the record may still be missing after
+     * adding outputs */
+    if (*seq_no < tc->base_seq_no) {
+        *seq_no = tc->base_seq_no;
     }
+    tc->seq_no = *seq_no;
+    tc->seq_no_valid = true;
     return true;
 }
 
@@ -153,10 +428,17 @@ bool gds_get_seq_no(const ble_uuid128_t *uuid, uint32_t *seq_no) {
  * returns false if transmitter is unknown
  */
 bool gds_set_seq_no(const ble_uuid128_t *uuid, uint32_t seq_no) {
-    uint32_t txrecid;
-    if (!gds_get_tx_recid(uuid, &txrecid)) {
+    GD_PROF_SCOPE(GD_PROF_SET_SEQ_NO);
+    gds_tx_cache_t *c = gds_get_tx(uuid);
+    if (c == NULL) {
         return false;
     }
+    uint32_t txrecid;
+    APP_ERROR_CHECK(fds_record_id_from_desc(&c->desc, &txrecid));
+    /* a failed write is not retried, so an accepted number must not be
+     * accepted again from the cache either */
+    c->seq_no = seq_no;
+    c->seq_no_valid = true;
     gds_seq_no_record_t recdata = {.txrecid = txrecid, .seq_no = seq_no};
     fds_record_t record = {
         .file_id = GDS_TXINFO_FILE_ID,
@@ -166,7 +448,10 @@ bool gds_set_seq_no(const ble_uuid128_t *uuid, uint32_t seq_no) {
             .length_words = sizeof(recdata) / sizeof(uint32_t)}};
     fds_record_desc_t record_desc;
     ret_code_t r;
-    gds_flash_access_done = false;
+    uint32_t ticket;
+    if (!gds_op_begin(&ticket)) {
+        return false;
+    }
     if (gds_find_seq_no_record(txrecid, &record_desc)) {
         NRF_LOG_DEBUG("updating seq_no for record %08x to %u", txrecid, seq_no);
         r = fds_record_update(&record_desc, &record);
@@ -177,11 +462,15 @@ bool gds_set_seq_no(const ble_uuid128_t *uuid, uint32_t seq_no) {
     }
     if (r != NRF_SUCCESS) {
         NRF_LOG_ERROR("could not update/write seq_no record, result = %08x", r);
-        gds_flash_access_done = true;
+        gds_op_cancel();
+        return false;
     }
     /* wait for completion. We cannot return from the function before
-        * because the data is stack allocated */
-    while (!gds_flash_access_done) {}
+     * because the data is stack allocated */
+    if (!gds_op_wait(ticket)) {
+        NRF_LOG_ERROR("seq_no record not written");
+        return false;
+    }
     return true;
 }
 
@@ -197,30 +486,51 @@ static void gds_callback(fds_evt_t const *p_evt) {
         case FDS_EVT_WRITE:
         case FDS_EVT_UPDATE:
             if (p_evt->write.file_id == GDS_TXINFO_FILE_ID) {
-                gds_flash_access_done = true;
+                gds_op_end(p_evt->result == NRF_SUCCESS);
             }
             break;
         case FDS_EVT_DEL_RECORD:
         case FDS_EVT_DEL_FILE:
             if (p_evt->del.file_id == GDS_TXINFO_FILE_ID) {
-                gds_flash_access_done = true;
+                gds_op_end(p_evt->result == NRF_SUCCESS);
             }
             break;
         case FDS_EVT_GC:
-            gds_flash_access_done = true;
+            NRF_LOG_INFO("garbage collection completed");
+            gds_gc_running = false;
+            gds_op_end(p_evt->result == NRF_SUCCESS);
             break;
     }
 }
 
+#if defined(SOFTDEVICE_PRESENT)
+/* Each failed SoftDevice flash operation is retried by the flash backend, so
+ * counting the errors gives the number of retries (including final failures).
+ */
+static void gds_soc_evt_handler(uint32_t evt_id, void *p_context) {
+    if (evt_id == NRF_EVT_FLASH_OPERATION_ERROR) {
+        gds_stats.retries++;
+    }
+}
+
+NRF_SDH_SOC_OBSERVER(gds_soc_observer, GDS_SOC_OBSERVER_PRIO, gds_soc_evt_handler, NULL);
+#endif
+
 void gds_clear(void) {
+    GD_STALL_SECTION(GD_STALL_SITE_CLEAR);
     NRF_LOG_INFO("Clearing all transmitter related information");
-    gds_flash_access_done = false;
-    if (fds_file_delete(GDS_TXINFO_FILE_ID) == NRF_SUCCESS) {
-        /* wait for completion */
-        while (!gds_flash_access_done) {}
+    gds_clearing = true;
+    memset(gds_tx_cache, 0, sizeof(gds_tx_cache));
+    uint32_t ticket;
+    if (!gds_op_begin(&ticket)) {
+        NRF_LOG_ERROR("Could not clear transmitter related information");
+    } else if (fds_file_delete(GDS_TXINFO_FILE_ID) == NRF_SUCCESS) {
+        gds_op_wait(ticket);
     } else {
         NRF_LOG_ERROR("Could not clear transmitter related information");
+        gds_op_cancel();
     }
+    gds_clearing = false;
 }
 
 #if FDS_VIRTUAL_PAGES < 3
@@ -229,18 +539,27 @@ void gds_clear(void) {
 
 #define GDS_GC_THRESHOLD ((FDS_VIRTUAL_PAGES - 2) * FDS_VIRTUAL_PAGE_SIZE)
 
+/* Garbage collection is not waited for; FDS executes further operations
+ * after it. */
 void gds_tasks(void) {
     fds_stat_t stat;
+    if (gds_gc_running) {
+        return;
+    }
     if (fds_stat(&stat) == NRF_SUCCESS) {
         if (stat.freeable_words > GDS_GC_THRESHOLD) {
             NRF_LOG_INFO("performing FDS garbage collection");
-            gds_flash_access_done = false;
+            uint32_t ticket;
+            if (!gds_op_begin(&ticket)) {
+                return;
+            }
+            gds_gc_running = true;
             if (fds_gc() != NRF_SUCCESS) {
                 NRF_LOG_ERROR("Could not start garbage collection");
+                gds_gc_running = false;
+                gds_op_cancel();
             } else {
-                /* wait for completion */
-                while (!gds_flash_access_done) {}
-                NRF_LOG_INFO("garbage collection completed");
+                gd_metric_inc(GD_METRIC_GC_RUNS);
             }
         }
     }
@@ -260,6 +579,26 @@ ret_code_t gds_init(void) {
     return NRF_SUCCESS;
 }
 
+void gds_set_busy_handler(gds_busy_handler_t handler) {
+    gds_busy_handler = handler;
+}
+
+void gds_get_stats(gds_stats_t *stats) {
+    GD_HAL_CRITICAL_ENTER();
+    *stats = gds_stats;
+    GD_HAL_CRITICAL_EXIT();
+}
+
+bool gds_get_free_words(uint32_t *words) {
+    fds_stat_t stat;
+    if (fds_stat(&stat) != NRF_SUCCESS) {
+        return false;
+    }
+    uint32_t used = stat.words_used + stat.words_reserved;
+    *words = used < GDS_CAPACITY_WORDS ? GDS_CAPACITY_WORDS - used : 0;
+    return true;
+}
+
 void gds_dump_to_log(void) {
     fds_flash_record_t record;
     fds_record_desc_t record_desc;
@@ -279,6 +618,32 @@ void gds_dump_to_log(void) {
         NRF_LOG_DEBUG("freeable_words:  %u", stat.freeable_words);
         NRF_LOG_DEBUG("corruption:      %u", stat.corruption);
     }
+    NRF_LOG_DEBUG("flash ops:       %u", gds_stats.ops);
+    NRF_LOG_DEBUG("flash failures:  %u", gds_stats.failures);
+    NRF_LOG_DEBUG("flash retries:   %u", gds_stats.retries);
+    NRF_LOG_DEBUG("max. latency:    %u us", gds_stats.latency_max_us);
+    NRF_LOG_DEBUG("avg. latency:    %u us",
+                  gds_stats.ops ? (uint32_t)(gds_stats.latency_sum_us / gds_stats.ops) : 0);
+    gds_flash_stats_t flash_stats;
+    gds_flash_get_stats(&flash_stats);
+    NRF_LOG_DEBUG("pages erased:    %u", flash_stats.pages);
+    NRF_LOG_DEBUG("erase slices:    %u", flash_stats.slices);
+    NRF_LOG_DEBUG("slots blocked:   %u", flash_stats.blocked);
+    NRF_LOG_DEBUG("max. stall:      %u us", flash_stats.stall_max_us);
+    for (unsigned i = 0; i < GDS_STALL_HIST_BINS; i++) {
+        NRF_LOG_DEBUG("stall %s%3u ms: %u",
+                      i < GDS_STALL_HIST_BINS - 1 ? "< " : ">=",
+                      i < GDS_STALL_HIST_BINS - 1 ? 1U << i : 1U << (i - 1),
+                      flash_stats.stall_hist[i]);
+    }
+    NRF_LOG_DEBUG("actuations during erase: %u, max. latency %u us",
+                  flash_stats.act_count, flash_stats.act_max_us);
+    for (unsigned i = 0; i < GDS_STALL_HIST_BINS; i++) {
+        NRF_LOG_DEBUG("latency %s%3u ms: %u",
+                      i < GDS_STALL_HIST_BINS - 1 ? "< " : ">=",
+                      i < GDS_STALL_HIST_BINS - 1 ? 1U << i : 1U << (i - 1),
+                      flash_stats.act_hist[i]);
+    }
     NRF_LOG_DEBUG("=== GD Storage dump BEGIN ===");
     memset(&ftok, 0x00, sizeof(fds_find_token_t));
     while (fds_record_find_in_file(GDS_TXINFO_FILE_ID,
@@ -0,0 +1,62 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * System time based on the low frequency counter of the HAL (the RTC used by
+ * app_timer on the nRF52)
+ *
+ * The RTC counter has 24 bits only and overflows every 1024 s at 16384 Hz. It
+ * is extended to 64 bits in software, which requires that the counter is read
+ * at least once per overflow period. A slow timer takes care of that.
+ */
+
+#include <systime.h>
+
+#include <hal.h>
+#include <ramfunc.h>
+
+#include <app_util.h>
+
+#define GD_TIME_HOUSEKEEPING_MS   (200 * 1000)
+
+STATIC_ASSERT(GD_TIME_HOUSEKEEPING_MS <
+              (GD_HAL_COUNTER_MASK + 1ULL) * 1000 / GD_HAL_COUNTER_FREQ);
+
+static gd_hal_timer_t gd_time_timer;
+static uint32_t gd_time_last_cnt;
+static uint64_t gd_time_high;
+
+GD_RAMFUNC uint64_t gd_time_ticks_locked(void) {
+    uint32_t cnt = gd_hal_counter();
+    if (cnt < gd_time_last_cnt) {
+        gd_time_high += GD_HAL_COUNTER_MASK + 1;
+    }
+    gd_time_last_cnt = cnt;
+    return gd_time_high + cnt;
+}
+
+GD_RAMFUNC uint64_t gd_time_ticks(void) {
+    uint64_t now;
+    GD_HAL_CRITICAL_ENTER();
+    now = gd_time_ticks_locked();
+    GD_HAL_CRITICAL_EXIT();
+    return now;
+}
+
+GD_RAMFUNC uint32_t gd_time_ms(void) {
+    return (uint32_t)GD_TIME_TICKS_TO_MS(gd_time_ticks());
+}
+
+static void gd_time_housekeeping(void *dummy) {
+    (void)gd_time_ticks();
+}
+
+void gd_time_init(void) {
+    gd_time_last_cnt = gd_hal_counter();
+    gd_time_high = 0;
+    gd_hal_timer_create(&gd_time_timer, true, gd_time_housekeeping);
+    gd_hal_timer_start(gd_time_timer, GD_TIME_HOUSEKEEPING_MS, NULL);
+}
@@ -0,0 +1,142 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * End-to-end command latency tracing
+ */
+
+#include <trace.h>
+#include <hal.h>
+#include <pack.h>
+#include <ramfunc.h>
+#include <systime.h>
+
+#if GD_TRACE_ENABLED
+
+#include <nrf_log.h>
+#include <string.h>
+
+/* 4 bins per octave from 1 us to 2^GD_TRACE_OCTAVES us; the last bin
+ * counts all longer latencies */
+#define GD_TRACE_OCTAVES 20
+#define GD_TRACE_SUB_BITS 2
+#define GD_TRACE_BINS (GD_TRACE_OCTAVES << GD_TRACE_SUB_BITS)
+
+typedef struct {
+    uint16_t bins[GD_TRACE_BINS]; /* saturating */
+    uint32_t count;
+    uint32_t max_us;
+} gd_trace_hist_t;
+
+static gd_trace_hist_t gd_trace_hist[GD_TRACE_STAGES];
+
+static const char *const gd_trace_stage_names[GD_TRACE_STAGES] = {
+    "enqueue", "dequeue", "verified", "seq_no", "actuate", "persist"};
+
+GD_RAMFUNC static unsigned gd_trace_bin(uint32_t us) {
+    if (us < (1U << GD_TRACE_SUB_BITS)) {
+        return us;
+    }
+    unsigned msb = 31 - __builtin_clz(us);
+    unsigned sub = (us >> (msb - GD_TRACE_SUB_BITS)) & ((1U << GD_TRACE_SUB_BITS) - 1);
+    unsigned bin = ((msb - GD_TRACE_SUB_BITS + 1) << GD_TRACE_SUB_BITS) + sub;
+    return bin < GD_TRACE_BINS ? bin : GD_TRACE_BINS - 1;
+}
+
+/* upper bound of a bin */
+static uint32_t gd_trace_bin_limit(unsigned bin) {
+    if (bin < (1U << GD_TRACE_SUB_BITS)) {
+        return bin + 1;
+    }
+    unsigned msb = (bin >> GD_TRACE_SUB_BITS) + GD_TRACE_SUB_BITS - 1;
+    unsigned sub = bin & ((1U << GD_TRACE_SUB_BITS) - 1);
+    return ((1U << GD_TRACE_SUB_BITS) + sub + 1) << (msb - GD_TRACE_SUB_BITS);
+}
+
+void gd_trace_init(void) {
+    memset(gd_trace_hist, 0, sizeof(gd_trace_hist));
+}
+
+GD_RAMFUNC void gd_trace_mark(gd_trace_stage_t stage, uint32_t origin) {
+    uint32_t ticks = (gd_hal_counter() - origin) & GD_HAL_COUNTER_MASK;
+    uint32_t us = GD_TIME_TICKS_TO_US(ticks);
+    gd_trace_hist_t *h = &gd_trace_hist[stage];
+    unsigned bin = gd_trace_bin(us);
+    GD_HAL_CRITICAL_ENTER();
+    if (h->bins[bin] < UINT16_MAX) {
+        h->bins[bin]++;
+    }
+    h->count++;
+    if (us > h->max_us) {
+        h->max_us = us;
+    }
+    GD_HAL_CRITICAL_EXIT();
+}
+
+static uint32_t gd_trace_percentile(const gd_trace_hist_t *h, uint32_t total, unsigned pct) {
+    uint32_t rank = (total * pct + 99) / 100;
+    uint32_t n = 0;
+    for (unsigned bin = 0; bin < GD_TRACE_BINS; bin++) {
+        n += h->bins[bin];
+        if (n >= rank) {
+            uint32_t limit = gd_trace_bin_limit(bin);
+            return limit < h->max_us ? limit : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+void gd_trace_get_summary(gd_trace_stage_t stage, gd_trace_summary_t *summary) {
+    gd_trace_hist_t h;
+    GD_HAL_CRITICAL_ENTER();
+    h = gd_trace_hist[stage];
+    GD_HAL_CRITICAL_EXIT();
+    /* the bins saturate, so percentiles are based on their sum */
+    uint32_t total = 0;
+    for (unsigned bin = 0; bin < GD_TRACE_BINS; bin++) {
+        total += h.bins[bin];
+    }
+    summary->count = h.count;
+    summary->p50_us = total ? gd_trace_percentile(&h, total, 50) : 0;
+    summary->p99_us = total ? gd_trace_percentile(&h, total, 99) : 0;
+    summary->max_us = h.max_us;
+}
+
+const char *gd_trace_stage_name(gd_trace_stage_t stage) {
+    return gd_trace_stage_names[stage];
+}
+
+size_t gd_trace_encode(uint8_t *buf, size_t size) {
+    if (size < GD_TRACE_RECORD_SIZE) {
+        return 0;
+    }
+    uint8_t *p = buf;
+    *p++ = GD_TRACE_RECORD_TYPE;
+    *p++ = GD_TRACE_STAGES;
+    for (unsigned stage = 0; stage < GD_TRACE_STAGES; stage++) {
+        gd_trace_summary_t s;
+        gd_trace_get_summary(stage, &s);
+        p = gd_put_u32(p, s.count);
+        p = gd_put_u32(p, s.p50_us);
+        p = gd_put_u32(p, s.p99_us);
+        p = gd_put_u32(p, s.max_us);
+    }
+    return p - buf;
+}
+
+void gd_trace_log(void) {
+    for (unsigned stage = 0; stage < GD_TRACE_STAGES; stage++) {
+        gd_trace_summary_t s;
+        gd_trace_get_summary(stage, &s);
+        NRF_LOG_INFO("trace %s: n = %u, p50 = %u us, p99 = %u us, max = %u us",
+                     gd_trace_stage_name(stage), s.count, s.p50_us, s.p99_us, s.max_us);
+    }
+    static uint8_t record[GD_TRACE_RECORD_SIZE];
+    size_t len = gd_trace_encode(record, sizeof(record));
+    NRF_LOG_HEXDUMP_INFO(record, len);
+}
+
+#endif
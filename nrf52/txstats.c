@@ -0,0 +1,137 @@
+/*
+ * BLE garage door opener remote control
+ *
+ * Copyright (C) 2020, Stephan <kiffie@mailbox.org>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *
+ * Per-transmitter activity statistics
+ */
+
+#include <txstats.h>
+#include <systime.h>
+
+#include <nrf_log.h>
+#include <string.h>
+
+typedef struct {
+    gd_txs_entry_t e;
+    bool used;
+} gd_txs_slot_t;
+
+static gd_txs_slot_t gd_txs_table[GD_TXS_TABLE_SIZE];
+static gd_txs_stats_t gd_txs_stats;
+
+static gd_txs_entry_t *gd_txs_find(const ble_uuid128_t *uuid) {
+    for (int i = 0; i < GD_TXS_TABLE_SIZE; i++) {
+        gd_txs_slot_t *s = &gd_txs_table[i];
+        if (s->used && memcmp(&s->e.uuid, uuid, sizeof(ble_uuid128_t)) == 0) {
+            return &s->e;
+        }
+    }
+    return NULL;
+}
+
+/* Get a free entry or replace the one seen least recently */
+static gd_txs_entry_t *gd_txs_alloc(const ble_uuid128_t *uuid, int8_t rssi) {
+    gd_txs_slot_t *victim = NULL;
+    for (int i = 0; i < GD_TXS_TABLE_SIZE; i++) {
+        gd_txs_slot_t *s = &gd_txs_table[i];
+        if (!s->used) {
+            victim = s;
+            gd_txs_stats.entries++;
+            break;
+        }
+        if (victim == NULL || (int32_t)(s->e.last_seen - victim->e.last_seen) < 0) {
+            victim = s;
+        }
+    }
+    if (victim->used) {
+        gd_txs_stats.evictions++;
+    }
+    memset(victim, 0, sizeof(*victim));
+    victim->used = true;
+    victim->e.uuid = *uuid;
+    victim->e.rssi_avg = rssi * 16;
+    return &victim->e;
+}
+
+void gd_txs_init(void) {
+    memset(gd_txs_table, 0, sizeof(gd_txs_table));
+    memset(&gd_txs_stats, 0, sizeof(gd_txs_stats));
+}
+
+void gd_txs_update(const ble_uuid128_t *uuid, gd_txs_outcome_t outcome, int8_t rssi,
+                   uint32_t seq_gap, uint32_t now_ms) {
+    gd_txs_entry_t *e = gd_txs_find(uuid);
+    if (e == NULL) {
+        if (outcome == GD_TXS_DROPPED || outcome == GD_TXS_DIGEST_FAILURE) {
+            /* not known to be enrolled */
+            return;
+        }
+        e = gd_txs_alloc(uuid, rssi);
+    }
+    e->packets++;
+    e->last_seen = now_ms;
+    e->rssi = rssi;
+    e->rssi_avg += (rssi * 16 - e->rssi_avg) >> GD_TXS_EWMA_SHIFT;
+    switch (outcome) {
+        case GD_TXS_DIGEST_FAILURE:
+            e->digest_failures++;
+            break;
+        case GD_TXS_ACCEPTED:
+            e->accepted++;
+            e->last_gap = seq_gap;
+            break;
+        case GD_TXS_DUPLICATE:
+            e->duplicates++;
+            break;
+        case GD_TXS_REPLAY:
+            e->replays++;
+            break;
+        case GD_TXS_REJECTED:
+            e->rejected++;
+            break;
+        default:
+            break;
+    }
+}
+
+void gd_txs_clear(void) {
+    memset(gd_txs_table, 0, sizeof(gd_txs_table));
+    gd_txs_stats.entries = 0;
+}
+
+bool gd_txs_get(unsigned index, gd_txs_entry_t *entry) {
+    if (index >= GD_TXS_TABLE_SIZE || !gd_txs_table[index].used) {
+        return false;
+    }
+    *entry = gd_txs_table[index].e;
+    return true;
+}
+
+void gd_txs_get_stats(gd_txs_stats_t *stats) {
+    *stats = gd_txs_stats;
+}
+
+void gd_txs_log(void) {
+    uint32_t now = gd_time_ms();
+    NRF_LOG_INFO("transmitters: %u entries, %u evictions",
+                 gd_txs_stats.entries, gd_txs_stats.evictions);
+    for (int i = 0; i < GD_TXS_TABLE_SIZE; i++) {
+        const gd_txs_entry_t *e = &gd_txs_table[i].e;
+        if (!gd_txs_table[i].used) {
+            continue;
+        }
+        /* transmitters are identified by the first four bytes of the UUID
+         * as displayed (most significant bytes) */
+        const uint8_t *u = e->uuid.uuid128;
+        uint32_t id = (u[15] << 24) | (u[14] << 16) | (u[13] << 8) | u[12];
+        NRF_LOG_INFO("tx %08x: pkts %u, acc %u, dup %u, replay %u, digest %u",
+                     id, e->packets, e->accepted, e->duplicates, e->replays,
+                     e->digest_failures);
+        NRF_LOG_INFO("tx %08x: rej %u, rssi %d (avg %d), gap %u, seen %u s ago",
+                     id, e->rejected, e->rssi, e->rssi_avg / 16, e->last_gap,
+                     (now - e->last_seen) / 1000);
+    }
+}